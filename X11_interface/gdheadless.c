@@ -0,0 +1,469 @@
+/* gdheadless.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+/* implementation without a display */
+/*  of functions declared in gdisplay.h */
+/*  images are converted as for X11, into a framebuffer in memory, */
+/*  and keys come from the -keys script instead of the user, so the */
+/*  whole load, process and display path runs without an X server */
+
+/* system */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h> /* memcpy, strlen */
+#include <stdint.h> /* for uint32_t */
+#include <poll.h>   /* poll, as a sleep while a sheet fills in */
+
+/* code base */
+#include "gdisplay.h"
+#include "gdpixels.h"  /* gdpixels */
+
+#include "../gimage.h" /* gImage */
+#include "../options.h" /* getOption, KEYS */
+#include "../transforms/gamma.h" /* gammaTable8, gammaTable16 */
+#include "../profile.h" /* profileBegin, profileEnd */
+
+
+/* INTERNAL */
+/* defines */
+
+/* screen size when -display does not give one as WxH */
+#define HEADLESS_WIDTH  (1920)
+#define HEADLESS_HEIGHT (1080)
+
+/* milliseconds between asking a sheet if it is complete */
+#define HEADLESS_SHEETMS (10)
+
+/* structures */
+struct gdisplay_struct {
+ unsigned int   width;     /* screen size */
+ unsigned int   height;
+ float          xgamma;    /* gamma adjustment while drawing, 1.0 for none */
+ unsigned char *fbP;       /* width x height, 4 bytes per pixel, as for X11 */
+ char          *keysP;     /* key script, NULL until the first image */
+ size_t         nextkey;   /* next key in keysP */
+ int          (*changed)(void *); /* sheet filling in, NULL for an image */
+ void          *changedctx;
+ unsigned int   clickx;    /* from the last c key */
+ unsigned int   clicky;
+};
+
+
+/* static internal functions */
+
+/*****************/
+/* headlessRGB() */
+/*****************/
+/* 4 byte pixel of a bitmap color, only "#rrggbb" is understood */
+/*  without a display to look up names, others are inDefault */
+static uint32_t
+headlessRGB(
+ const char *inColor,
+ uint32_t inDefault)
+{
+uint32_t rgb = inDefault;
+unsigned int v;
+
+  if (inColor[0] == '#' && strlen(inColor) == 7 &&
+      sscanf(inColor + 1, "%6x", &v) == 1) {
+    rgb = v;
+  }
+  return(rgb);
+}
+
+
+/***********************/
+/* headlessBitmapRow() */
+/***********************/
+/* one row of a bitmap, set bits foreground, as X11 draws XYBitmap */
+static void
+headlessBitmapRow(
+ unsigned char *outP,
+ const unsigned char *inRowP,
+ unsigned int inW,
+ uint32_t inFg,
+ uint32_t inBg)
+{
+uint32_t rgb;
+unsigned int x;
+
+  for (x = 0; x < inW; x++) {
+    rgb = ((inRowP[x / 8] >> (x % 8)) & 0x01 ? inFg : inBg);
+    *outP++ = rgb & 0xff;         /* blue */
+    *outP++ = (rgb >> 8) & 0xff;  /* green */
+    *outP++ = (rgb >> 16) & 0xff; /* red */
+    *outP++ = 0;                  /* pad */
+  }
+}
+
+
+/******************/
+/* headlessDraw() */
+/******************/
+/* the top left inW x inH of the image into the framebuffer */
+/*  returns -1 on failure */
+static int
+headlessDraw(
+ gdisplay ingdP,
+ gImage *ingiP,
+ const unsigned char *ingamma8P,
+ const uint16_t *ingamma16P,
+ unsigned int inW,
+ unsigned int inH)
+{
+unsigned char *pixP = NULL;
+size_t rowbytes;
+size_t fbrowbytes;
+uint32_t fg;
+uint32_t bg;
+unsigned int y;
+int status = 0;
+ProfileSpan span;
+
+  profileBegin(&span);
+  rowbytes = (size_t)4 * inW;
+  fbrowbytes = (size_t)4 * ingdP->width;
+
+  if (BITMAPP(ingiP)) {
+    fg = headlessRGB(ingiP->foreground, 0x000000);
+    bg = headlessRGB(ingiP->background, 0xffffff);
+    for (y = 0; y < inH; y++) {
+      headlessBitmapRow(ingdP->fbP + y * fbrowbytes,
+        ingiP->data + y * imageRowBytes(IBITMAP, ingiP->width), inW, fg, bg);
+    }
+  } else {
+    pixP = gdpixels(ingiP, ingamma8P, ingamma16P, 0, 0, inW, inH);
+    if (pixP == NULL) {
+      status = -1;
+    } else {
+      for (y = 0; y < inH; y++) {
+        memcpy(ingdP->fbP + y * fbrowbytes, pixP + y * rowbytes, rowbytes);
+      }
+      free(pixP);
+    }
+  }
+  profileEnd(&span, "convert", ingiP->title);
+  return(status);
+}
+
+
+/**********************/
+/* headlessChecksum() */
+/**********************/
+/* FNV-1a of the inW x inH drawn, to compare runs */
+static uint32_t
+headlessChecksum(
+ gdisplay ingdP,
+ unsigned int inW,
+ unsigned int inH)
+{
+uint32_t h = 2166136261u;
+const unsigned char *rowP = NULL;
+size_t i;
+unsigned int y;
+
+  for (y = 0; y < inH; y++) {
+    rowP = ingdP->fbP + (size_t)y * 4 * ingdP->width;
+    for (i = 0; i < (size_t)4 * inW; i++) {
+      h = (h ^ rowP[i]) * 16777619u;
+    }
+  }
+  return(h);
+}
+
+
+/**********************/
+/* headlessLoadKeys() */
+/**********************/
+/* the -keys script: a file if one is named, else the keys given */
+/*  no -keys is an empty script, so the first image quits */
+static void
+headlessLoadKeys(
+ gdisplay ingdP,
+ OptionSet *global_options)
+{
+Option *opt = NULL;
+FILE *fP = NULL;
+long len = 0;
+
+  opt = getOption(global_options, KEYS);
+  if (opt != NULL) {
+    fP = fopen(opt->info.keys, "r");
+  }
+  if (fP != NULL) {
+    if (fseek(fP, 0, SEEK_END) == 0) {
+      len = ftell(fP);
+      fseek(fP, 0, SEEK_SET);
+    }
+    if (len >= 0) {
+      ingdP->keysP = malloc((size_t)len + 1);
+    }
+    if (ingdP->keysP != NULL) {
+      len = fread(ingdP->keysP, 1, (size_t)len, fP);
+      ingdP->keysP[len] = '\0';
+    }
+    fclose(fP);
+  } else if (opt != NULL) {
+    ingdP->keysP = malloc(strlen(opt->info.keys) + 1);
+    if (ingdP->keysP != NULL) {
+      strcpy(ingdP->keysP, opt->info.keys);
+    }
+  } else {
+    ingdP->keysP = calloc(1, 1);
+  }
+  if (ingdP->keysP == NULL) {
+    fprintf(stderr, "headless: cannot read the -keys script\n");
+  }
+  ingdP->nextkey = 0;
+}
+
+
+/*****************/
+/* headlessKey() */
+/*****************/
+/* next command from the key script, 'q' once it is used up */
+/*  line breaks and tabs are skipped, so a file may be laid out */
+/*  one key per line */
+/*  on a sheet, cX,Y clicks at image coordinates X,Y */
+static char
+headlessKey(
+ gdisplay ingdP)
+{
+char r = '\0';
+char c;
+int n = 0;
+
+  while (r == '\0') {
+    c = (ingdP->keysP != NULL ? ingdP->keysP[ingdP->nextkey] : '\0');
+    if (c == '\0') {
+      r = 'q';
+      break;
+    }
+    ingdP->nextkey++;
+    if (c == 'q' || c == 'Q') {
+      r = 'q';
+    } else if (c == ' ' || c == 'n' || c == 'N') {
+      r = 'n';
+    } else if (c == 'p' || c == 'P') {
+      r = 'p';
+    } else if (c == '>' || c == '<') {
+      r = c;
+    } else if (c == 'c' && ingdP->changed != NULL &&
+               sscanf(ingdP->keysP + ingdP->nextkey, "%u,%u%n",
+                 &ingdP->clickx, &ingdP->clicky, &n) == 2) {
+      ingdP->nextkey += n;
+      r = 'c';
+    } else if (c != '\n' && c != '\r' && c != '\t') {
+      fprintf(stderr, "headless: key '%c' ignored\n", c);
+    }
+  }
+  return(r);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/************/
+/* gdinit() */
+/************/
+/* inStr, from -display, is the screen size as WxH, or NULL */
+gdisplay
+gdinit(
+ const char* inStr)
+{
+gdisplay rgdP = NULL;
+unsigned int w = HEADLESS_WIDTH;
+unsigned int h = HEADLESS_HEIGHT;
+
+  if (inStr != NULL &&
+      (sscanf(inStr, "%ux%u", &w, &h) != 2 || w == 0 || h == 0)) {
+    fprintf(stderr, "headless: display %s is not WxH\n", inStr);
+  } else {
+    rgdP = calloc(1, sizeof(struct gdisplay_struct));
+  }
+  if (rgdP != NULL) {
+    rgdP->width = w;
+    rgdP->height = h;
+    rgdP->xgamma = 1.0;
+    rgdP->fbP = calloc((size_t)w * h, 4);
+    if (rgdP->fbP == NULL) {
+      fprintf(stderr, "gdinit: calloc() fail\n");
+      free(rgdP);
+      rgdP = NULL;
+    }
+  }
+
+  return(rgdP);
+}
+
+
+/*************/
+/* gdwidth() */
+/*************/
+unsigned int
+gdwidth(
+ gdisplay ingdP)
+{
+  return(ingdP != NULL ? ingdP->width : 0);
+}
+
+
+/**************/
+/* gdheight() */
+/**************/
+unsigned int
+gdheight(
+ gdisplay ingdP)
+{
+  return(ingdP != NULL ? ingdP->height : 0);
+}
+
+
+/****************/
+/* gdsetgamma() */
+/****************/
+void
+gdsetgamma(
+ gdisplay ingdP,
+ float inGamma)
+{
+  if (ingdP != NULL) {
+    ingdP->xgamma = (inGamma > 0.0 ? inGamma : 1.0);
+  }
+}
+
+
+/****************/
+/* gdsetsheet() */
+/****************/
+void
+gdsetsheet(
+ gdisplay ingdP,
+ int (*inChanged)(void *),
+ void *inCtxP)
+{
+  if (ingdP != NULL) {
+    ingdP->changed = inChanged;
+    ingdP->changedctx = inCtxP;
+  }
+}
+
+
+/*************/
+/* gdclick() */
+/*************/
+void
+gdclick(
+ gdisplay ingdP,
+ unsigned int *outX,
+ unsigned int *outY)
+{
+  *outX = ingdP->clickx;
+  *outY = ingdP->clicky;
+}
+
+
+/********************/
+/* gdbyteorderLSB() */
+/********************/
+/* framebuffer pixels are blue, green, red, pad */
+int
+gdbyteorderLSB(
+ gdisplay ingdP)
+{
+  (void)ingdP;
+  return(-1);
+}
+
+
+/*******************/
+/* gdbitorderLSB() */
+/*******************/
+int
+gdbitorderLSB(
+ gdisplay ingdP)
+{
+  (void)ingdP;
+  return(-1);
+}
+
+
+/**************/
+/* gdfinish() */
+/**************/
+void
+gdfinish(
+ gdisplay ingdP)
+{
+  free(ingdP->fbP);
+  free(ingdP->keysP);
+  free(ingdP);
+}
+
+
+/*********************/
+/* gdImageInWindow() */
+/*********************/
+/* the window is the top left of the image, no larger than the screen */
+/*  it is drawn once, then the next key of the script is returned */
+char
+gdImageInWindow(
+ gdisplay      ingdP,
+ gImage       *ingiP,
+ OptionSet    *global_options,
+ OptionSet    *image_options,
+ int           argc,
+ char         *argv[],
+ unsigned int  verbose)
+{
+const unsigned char *gamma8P = NULL;
+const uint16_t *gamma16P = NULL;
+unsigned int w;
+unsigned int h;
+char r;
+
+  (void)image_options;
+  (void)argc;
+  (void)argv;
+
+  if (ingdP->keysP == NULL) {
+    headlessLoadKeys(ingdP, global_options);
+  }
+
+  /* gamma is folded into the conversion, as for X11 */
+  if (ingdP->xgamma != 1.0) {
+    if (RGB24P(ingiP) || RGBF32P(ingiP)) {
+      gamma8P = gammaTable8(ingiP->gamma, ingiP->gamma * ingdP->xgamma);
+    } else if (RGB48P(ingiP)) {
+      gamma16P = gammaTable16(ingiP->gamma, ingiP->gamma * ingdP->xgamma);
+    }
+  }
+
+  /* a sheet is drawn once it is complete, so runs compare */
+  if (ingdP->changed != NULL) {
+    while (ingdP->changed(ingdP->changedctx) >= 0) {
+      poll(NULL, 0, HEADLESS_SHEETMS);
+    }
+  }
+
+  w = (ingiP->width < ingdP->width ? ingiP->width : ingdP->width);
+  h = (ingiP->height < ingdP->height ? ingiP->height : ingdP->height);
+  if (headlessDraw(ingdP, ingiP, gamma8P, gamma16P, w, h) != 0) {
+    r = '\0';
+  } else {
+    if (verbose) {
+      printf(" headless: shown %u x %u, checksum %08lx\n", w, h,
+        (unsigned long)headlessChecksum(ingdP, w, h));
+    }
+    r = headlessKey(ingdP);
+  }
+
+  return(r);
+}
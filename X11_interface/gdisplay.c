@@ -14,20 +14,54 @@
 /* system */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h> /* memcpy */
 #include <stdint.h> /* for uint16_t */
+#include <poll.h>   /* poll, waiting for a sheet to change */
 
 /* X11 */
 #include <X11/Xlib.h>
 #include <X11/Xutil.h> /* XVisualInfo */
+#include <X11/keysym.h> /* XK_Left */
 
 /* code base */
 #include "gdisplay.h"
+#include "gdpixels.h"  /* gdpixels */
 
 #include "../gimage.h" /* gImage */
+#include "../transforms/gamma.h" /* gammaTable8, gammaTable16 */
+#include "../profile.h" /* profileBegin, profileEnd */
 
 
 /* INTERNAL */
+/* defines */
+
+/* upper limit of data per XPutImage band */
+/*  small enough that events are looked at often on slow links */
+#define BANDBYTES (256 * 1024)
+
+/* how often, in milliseconds, a sheet is asked if it has changed */
+/*  while there are no events, see gdsetsheet() */
+#define SHEETPOLLMS (100)
+
 /* structures */
+/* part of the image shown in the window */
+/*  the XImage is only of this rectangle, rebuilt when it moves */
+struct view_struct {
+ unsigned int x;       /* image coordinates of top left of window */
+ unsigned int y;
+ unsigned int w;       /* window size, never larger than image */
+ unsigned int h;
+ XImage      *xiP;     /* converted rectangle, NULL if none */
+ unsigned int xix;     /* rectangle in xiP */
+ unsigned int xiy;
+ unsigned int xiw;
+ unsigned int xih;
+ unsigned int next;    /* next row of xiP to send, h when all sent */
+ const unsigned char *gamma8;  /* IRGB24, IRGBF32 gamma table, NULL if none */
+ const uint16_t      *gamma16; /* IRGB48 gamma table, NULL if none */
+};
+
+
 struct gdisplay_struct {
  Display* xdisplayP;
  int      xbyteLSB; /* 0=false=MSBFirst, -1=true=LSBFirst */
@@ -37,160 +71,276 @@ struct gdisplay_struct {
  int      xscrnheight;
  Window   ximgwin;
  GC       xgc;
+ size_t   xbandbytes; /* largest XPutImage data to send at once */
+ float    xgamma;     /* gamma adjustment while drawing, 1.0 for none */
+ int    (*changed)(void *); /* sheet filling in, NULL for an image */
+ void    *changedctx;
+ unsigned int clickx; /* image coordinates of the last click */
+ unsigned int clicky;
 };
 
 
 /* static internal functions */
 
-/***************/
-/* gi4bitmap() */
-/***************/
-static XImage*
-gi4bitmap(
+/********************/
+/* gcBitmapColors() */
+/********************/
+/* modify GC (ingdP->xgc) to set background, foreground */
+/*  GC was created in gdinit */
+/*  once per image, colors are allocated */
+static void
+gcBitmapColors(
  gImage *ingiP,
  gdisplay ingdP)
 {
 /* X11 types */
-XImage *xiP = NULL;
 Colormap xdefcmap;
 XColor xc_exact;
 XColor xc_screen;
 XGCValues xgcv;
 unsigned long xgcmask;
+
+  if (ingiP->background[0] != '\0' || ingiP->foreground[0] != '\0') {
+    xdefcmap = DefaultColormap(ingdP->xdisplayP, ingdP->xscrnum);
+    xgcmask = 0;
+    if (ingiP->background[0] != '\0') {
+      XAllocNamedColor(ingdP->xdisplayP, xdefcmap, ingiP->background, &xc_exact, &xc_screen);
+      xgcv.background = xc_screen.pixel;
+      xgcmask |= GCBackground;
+    }
+    if (ingiP->foreground[0] != '\0') {
+      XAllocNamedColor(ingdP->xdisplayP, xdefcmap, ingiP->foreground, &xc_exact, &xc_screen);
+      xgcv.foreground = xc_screen.pixel;
+      xgcmask |= GCForeground;
+    }
+    XChangeGC(ingdP->xdisplayP, ingdP->xgc, xgcmask, &xgcv);
+  }
+}
+
+
+/***************/
+/* gi4bitmap() */
+/***************/
+/* XImage of the inW x inH rectangle at inX, inY */
+/*  rows are copied from the byte holding pixel inX, */
+/*  XImage offset skips the bits left of inX */
+static XImage*
+gi4bitmap(
+ gImage *ingiP,
+ gdisplay ingdP,
+ unsigned int inX,
+ unsigned int inY,
+ unsigned int inW,
+ unsigned int inH)
+{
+/* X11 types */
+XImage *xiP = NULL;
 /* standard types */
 unsigned char *xidataP = NULL;
-unsigned int rowbytes;
+unsigned char *srcP = NULL;
+size_t srcrowbytes;
 unsigned int depth = 1;
+unsigned int offset;
 int pad = 8;
-int bytes_per_line = 0; /* if 0, XCreateImage will then figure it out in created structure */
-int i;
+int bytes_per_line;
+unsigned int y;
+
+  offset = inX % 8;
+  bytes_per_line = (offset + inW + 7) / 8;
+  srcrowbytes = imageRowBytes(IBITMAP, ingiP->width);
 
-  rowbytes = (ingiP->width + 7) / 8;
-  xidataP = malloc(rowbytes * ingiP->height);
+  xidataP = malloc((size_t)bytes_per_line * inH);
   if (xidataP == NULL) {
     fprintf(stderr, "gi4bitmap malloc error\n");
     xiP = NULL;
   } else {
-
-    /* modify GC (ingdP->xgc) to set background, foreground */
-    /*  GC was created in gdinit */
-    if (ingiP->background[0] != '\0' || ingiP->foreground[0] != '\0') {
-      xdefcmap = DefaultColormap(ingdP->xdisplayP, ingdP->xscrnum);
-      xgcmask = 0;
-      if (ingiP->background[0] != '\0') {
-        XAllocNamedColor(ingdP->xdisplayP, xdefcmap, ingiP->background, &xc_exact, &xc_screen);
-        xgcv.background = xc_screen.pixel;
-        xgcmask |= GCBackground;
-      }
-      if (ingiP->foreground[0] != '\0') {
-        XAllocNamedColor(ingdP->xdisplayP, xdefcmap, ingiP->foreground, &xc_exact, &xc_screen);
-        xgcv.foreground = xc_screen.pixel;
-        xgcmask |= GCForeground;
-      }
-      XChangeGC(ingdP->xdisplayP, ingdP->xgc, xgcmask, &xgcv);
-    }
-
-    for (i = 0; i < rowbytes * ingiP->height; i++) {
-      xidataP[i] = ingiP->data[i];
+    srcP = ingiP->data + (size_t)inY * srcrowbytes + inX / 8;
+    for (y = 0; y < inH; y++) {
+      memcpy(xidataP + (size_t)y * bytes_per_line, srcP, bytes_per_line);
+      srcP += srcrowbytes;
     }
-    xiP = XCreateImage(ingdP->xdisplayP, ingdP->xvisP, depth, XYBitmap, 0,
-            xidataP, ingiP->width, ingiP->height, pad, bytes_per_line);
+    xiP = XCreateImage(ingdP->xdisplayP, ingdP->xvisP, depth, XYBitmap, offset,
+            xidataP, inW, inH, pad, bytes_per_line);
   }
 
   return(xiP);
 }
 
 
-/**************/
-/* gi4rgb24() */
-/**************/
+/************/
+/* gi4rgb() */
+/************/
+/* XImage of the inW x inH rectangle at inX, inY of a color image */
+/*  through the view's gamma table if not NULL */
 static XImage*
-gi4rgb24(
+gi4rgb(
  gImage *ingiP,
- gdisplay ingdP)
+ gdisplay ingdP,
+ const struct view_struct *inViewP,
+ unsigned int inX,
+ unsigned int inY,
+ unsigned int inW,
+ unsigned int inH)
 {
 XImage *rxiP = NULL;
 unsigned char *xidataP = NULL;
-unsigned char *gP = NULL;
-unsigned char *xP = NULL;
-unsigned int w;
-unsigned int h;
-unsigned int x;
-unsigned int y;
-
-  w = ingiP->width;
-  h = ingiP->height;
-
-  xidataP = malloc(4 * h * w);
-  if (xidataP == NULL) {
-    fprintf(stderr, "gi4rgb24 malloc fail\n");
-    rxiP = NULL;
-  } else {
-    gP = ingiP->data;
-    xP = xidataP;
-    for (y = 0; y < h; y++) {
-      for (x = 0; x < w; x++) {
-        /* X11 order by 'mask' red is byte 2, green byte 1, blue byte 0 */
-        *xP++ = *(gP+2); /* blue */
-        *xP++ = *(gP+1); /* green */
-        *xP++ = *gP;     /* red */
-        *xP++ = 0;       /* pad */
-        gP+= 3;
-      }
-    }
 
+  xidataP = gdpixels(ingiP, inViewP->gamma8, inViewP->gamma16,
+    inX, inY, inW, inH);
+  if (xidataP != NULL) {
     rxiP = XCreateImage(ingdP->xdisplayP, ingdP->xvisP, 24, ZPixmap, 0,
-             xidataP, w, h, 8, 0);
+             (char *)xidataP, inW, inH, 8, 0);
+    if (rxiP == NULL) {
+      free(xidataP);
+    }
   }
 
   return(rxiP);
 }
 
 
-/**************/
-/* gi4rgb48() */
-/**************/
-static XImage*
-gi4rgb48(
+
+/***************/
+/* viewClamp() */
+/***************/
+/* keep the view inside the image */
+/*  inDx, inDy is a requested move in pixels */
+/*  returns -1 (true) if the view moved */
+static int
+viewClamp(
+ struct view_struct *ioViewP,
  gImage *ingiP,
- gdisplay ingdP)
+ long inDx,
+ long inDy)
 {
-XImage *rxiP = NULL;
-unsigned char *xidataP = NULL;
-unsigned char *xP = NULL;
-uint16_t *gP = NULL;
-unsigned int w;
-unsigned int h;
-unsigned int ix;
-unsigned int iy;
+long x;
+long y;
+int moved = 0;
 
-  w = ingiP->width;
-  h = ingiP->height;
+  if (ioViewP->w > ingiP->width) {
+    ioViewP->w = ingiP->width;
+  }
+  if (ioViewP->h > ingiP->height) {
+    ioViewP->h = ingiP->height;
+  }
 
-  xidataP = malloc(4 * h * w);
-  if (xidataP == NULL) {
-    fprintf(stderr, "gi4rgb48 malloc fail\n");
-    rxiP = NULL;
+  x = (long)ioViewP->x + inDx;
+  y = (long)ioViewP->y + inDy;
+  if (x > (long)(ingiP->width - ioViewP->w)) {
+    x = ingiP->width - ioViewP->w;
+  }
+  if (y > (long)(ingiP->height - ioViewP->h)) {
+    y = ingiP->height - ioViewP->h;
+  }
+  if (x < 0) x = 0;
+  if (y < 0) y = 0;
+
+  if ((unsigned int)x != ioViewP->x || (unsigned int)y != ioViewP->y) {
+    ioViewP->x = x;
+    ioViewP->y = y;
+    moved = -1;
+  }
+  return(moved);
+}
+
+
+/***************/
+/* viewBands() */
+/***************/
+/* send the view's XImage as bands of rows, from row ioViewP->next */
+/*  each band fits in one X request, see gdinit() */
+/*  stops early if events are waiting, gdImageInWindow() */
+/*  handles them and calls again to finish when the queue is empty */
+/*  when profiling, the server is waited for after the last band */
+static void
+viewBands(
+ gdisplay ingdP,
+ struct view_struct *ioViewP)
+{
+unsigned int band;
+unsigned int n;
+int pending;
+ProfileSpan span;
+
+  if (ioViewP->xiP == NULL) {
+    ioViewP->next = ioViewP->h;
   } else {
-    gP = (uint16_t *)ingiP->data;
-    xP = xidataP;
-    for (iy = 0; iy < ingiP->height; iy++) {
-      for (ix = 0; ix < ingiP->width; ix++) {
-        *xP++ = *(gP+2) / 256; /* blue */
-        *xP++ = *(gP+1) / 256; /* green */
-        *xP++ = *gP / 256;     /* red */
-        *xP++ = 0;             /* pad */
-        gP += 3;
+    band = ingdP->xbandbytes / ioViewP->xiP->bytes_per_line;
+    if (band == 0) {
+      band = 1;
+    }
+    while (ioViewP->next < ioViewP->h) {
+      n = ioViewP->h - ioViewP->next;
+      if (n > band) {
+        n = band;
+      }
+      profileBegin(&span);
+      XPutImage(ingdP->xdisplayP, ingdP->ximgwin, ingdP->xgc, ioViewP->xiP,
+        0, ioViewP->next, 0, ioViewP->next, ioViewP->w, n);
+      ioViewP->next += n;
+      /* XPending flushes, so this band goes out now */
+      pending = XPending(ingdP->xdisplayP);
+      profileEnd(&span, "putimage", NULL);
+      if (pending != 0) {
+        break;
+      }
+      if (ioViewP->next == ioViewP->h && profileOn()) {
+        profileBegin(&span);
+        XSync(ingdP->xdisplayP, False);
+        profileEnd(&span, "roundtrip", NULL);
       }
     }
+  }
+}
 
-    rxiP = XCreateImage(ingdP->xdisplayP, ingdP->xvisP, 24, ZPixmap, 0,
-           xidataP, w, h, 8, 0);
+
+/**************/
+/* viewShow() */
+/**************/
+/* draw the view in the window */
+/*  only the visible rectangle is converted and sent */
+/*  the converted XImage is kept for Expose until the view moves */
+static void
+viewShow(
+ gdisplay ingdP,
+ gImage *ingiP,
+ struct view_struct *ioViewP)
+{
+ProfileSpan span;
+
+  if (ioViewP->xiP != NULL &&
+      (ioViewP->xix != ioViewP->x || ioViewP->xiy != ioViewP->y ||
+       ioViewP->xiw != ioViewP->w || ioViewP->xih != ioViewP->h)) {
+    XDestroyImage(ioViewP->xiP);
+    ioViewP->xiP = NULL;
   }
 
-  return(rxiP);
-}
+  if (ioViewP->xiP == NULL) {
+    profileBegin(&span);
+    switch(ingiP->gitype) {
+     case IBITMAP:
+      ioViewP->xiP = gi4bitmap(ingiP, ingdP,
+        ioViewP->x, ioViewP->y, ioViewP->w, ioViewP->h);
+      break;
+     case IRGB24:
+     case IRGB48:
+     case IRGBF32:
+      ioViewP->xiP = gi4rgb(ingiP, ingdP, ioViewP,
+        ioViewP->x, ioViewP->y, ioViewP->w, ioViewP->h);
+      break;
+     default: fprintf(stderr, "?invalid gimage type\n");
+    }
+    profileEnd(&span, "convert", ingiP->title);
+    ioViewP->xix = ioViewP->x;
+    ioViewP->xiy = ioViewP->y;
+    ioViewP->xiw = ioViewP->w;
+    ioViewP->xih = ioViewP->h;
+  }
 
+  /* (re)start sending from the top */
+  ioViewP->next = 0;
+  viewBands(ingdP, ioViewP);
+}
 
 
 /******************/
@@ -229,6 +379,7 @@ gdisplay     rgdP = NULL;
 XVisualInfo  xvi;
 unsigned long xpxl_white;
 XGCValues xgcvals;
+long reqsize;
 int backing;
 int xret = 0;
 
@@ -286,11 +437,28 @@ int xret = 0;
       128, 128, 128, 128, 0, xpxl_white, xpxl_white);
     /* check if error ? */
     xret = XSelectInput(rgdP->xdisplayP, rgdP->ximgwin,
-      ExposureMask | KeyPressMask | StructureNotifyMask);
+      ExposureMask | KeyPressMask | StructureNotifyMask |
+      ButtonPressMask | ButtonReleaseMask | Button1MotionMask);
     if (xret != 1) {
       fprintf(stderr, "XSelectInput error %d\n", xret);
     }
 
+    /* max request size is in 4 byte units, 0 if no BIG-REQUESTS */
+    /*  leave room for the PutImage request header */
+    reqsize = XExtendedMaxRequestSize(rgdP->xdisplayP);
+    if (reqsize == 0) {
+      reqsize = XMaxRequestSize(rgdP->xdisplayP);
+    }
+    rgdP->xgamma = 1.0;
+    rgdP->changed = NULL;
+    rgdP->changedctx = NULL;
+    rgdP->clickx = 0;
+    rgdP->clicky = 0;
+    rgdP->xbandbytes = (size_t)reqsize * 4 - 64;
+    if (rgdP->xbandbytes > BANDBYTES) {
+      rgdP->xbandbytes = BANDBYTES;
+    }
+
     xgcvals.foreground = BlackPixel(rgdP->xdisplayP, rgdP->xscrnum);
     xgcvals.background = xpxl_white;
     rgdP->xgc = XCreateGC(rgdP->xdisplayP, rgdP->ximgwin,
@@ -338,6 +506,50 @@ unsigned int h;
 }
 
 
+/****************/
+/* gdsetgamma() */
+/****************/
+void
+gdsetgamma(
+ gdisplay ingdP,
+ float inGamma)
+{
+  if (ingdP != NULL) {
+    ingdP->xgamma = (inGamma > 0.0 ? inGamma : 1.0);
+  }
+}
+
+
+/****************/
+/* gdsetsheet() */
+/****************/
+void
+gdsetsheet(
+ gdisplay ingdP,
+ int (*inChanged)(void *),
+ void *inCtxP)
+{
+  if (ingdP != NULL) {
+    ingdP->changed = inChanged;
+    ingdP->changedctx = inCtxP;
+  }
+}
+
+
+/*************/
+/* gdclick() */
+/*************/
+void
+gdclick(
+ gdisplay ingdP,
+ unsigned int *outX,
+ unsigned int *outY)
+{
+  *outX = ingdP->clickx;
+  *outY = ingdP->clicky;
+}
+
+
 /********************/
 /* gdbyteorderLSB() */
 /********************/
@@ -385,6 +597,9 @@ gdfinish(
 /*********************/
 /* gdImageInWindow() */
 /*********************/
+/* window is no larger than the screen */
+/*  images larger than that are panned with the arrow keys */
+/*  (shift for a whole window) or by dragging with button 1 */
 char
 gdImageInWindow(
  gdisplay      ingdP,
@@ -395,33 +610,85 @@ gdImageInWindow(
  char         *argv[],
  unsigned int  verbose)
 {
-XImage *xiP = NULL;
+struct view_struct view;
 XEvent xevt;
 KeySym xkeysym;
 XComposeStatus xcompst;
 int keycnt = 0;
 int xret = 0;
 int status = 0;
+int dragging = 0;
+int dragx = 0;
+int dragy = 0;
+int dragged = 0;
+int filling = 0;
+int changed;
+struct pollfd xpoll;
+long stepx;
+long stepy;
+long dx;
+long dy;
 char buf[16];
 char r;
 
-  /* create the XImage */
-  switch(ingiP->gitype) {
-   case IBITMAP: xiP = gi4bitmap(ingiP, ingdP); break;
-   case IRGB24:  xiP = gi4rgb24(ingiP, ingdP); break;
-   case IRGB48:  xiP = gi4rgb48(ingiP, ingdP); break;
-   default: fprintf(stderr, "?invalid gimage type\n");
+  view.x = 0;
+  view.y = 0;
+  view.w = ingdP->xscrnwidth;
+  view.h = ingdP->xscrnheight;
+  view.xiP = NULL;
+  view.gamma8 = NULL;
+  view.gamma16 = NULL;
+  /* gamma is folded into the conversion to XImage, no extra pass */
+  if (ingdP->xgamma != 1.0) {
+    if (RGB24P(ingiP) || RGBF32P(ingiP)) {
+      view.gamma8 = gammaTable8(ingiP->gamma, ingiP->gamma * ingdP->xgamma);
+    } else if (RGB48P(ingiP)) {
+      view.gamma16 = gammaTable16(ingiP->gamma, ingiP->gamma * ingdP->xgamma);
+    }
   }
+  viewClamp(&view, ingiP, 0, 0);
+  view.next = view.h; /* nothing to send until the first Expose */
 
-  XResizeWindow(ingdP->xdisplayP, ingdP->ximgwin, ingiP->width, ingiP->height);
+  if (ingiP->gitype == IBITMAP) {
+    gcBitmapColors(ingiP, ingdP);
+  }
+
+  XResizeWindow(ingdP->xdisplayP, ingdP->ximgwin, view.w, view.h);
 
   xret = XMapWindow(ingdP->xdisplayP, ingdP->ximgwin);
   if (xret != 1) {
     fprintf(stderr, "XMapWindow error %d\n", xret);
   }
 
+  /* a sheet is redrawn as it fills in */
+  filling = (ingdP->changed != NULL);
+  xpoll.fd = ConnectionNumber(ingdP->xdisplayP);
+  xpoll.events = POLLIN;
+
   do {
 
+    /* finish drawing when there is nothing else to do */
+    if (view.next < view.h && XPending(ingdP->xdisplayP) == 0) {
+      viewBands(ingdP, &view);
+      continue;
+    }
+
+    /* no events for a while: has the sheet changed */
+    if (filling && XPending(ingdP->xdisplayP) == 0 &&
+        poll(&xpoll, 1, SHEETPOLLMS) == 0) {
+      changed = ingdP->changed(ingdP->changedctx);
+      if (changed < 0) {
+        filling = 0;
+      }
+      /* before the first Expose there is nothing to redraw */
+      if (changed != 0 && view.xiP != NULL) {
+        XDestroyImage(view.xiP);
+        view.xiP = NULL;
+        viewShow(ingdP, ingiP, &view);
+      }
+      continue;
+    }
+
     xret = XNextEvent(ingdP->xdisplayP, &xevt);
     if (xret != 0) {
       fprintf(stderr, "XNextEvent error %d\n", xret);
@@ -433,13 +700,91 @@ char r;
       if (xevt.xexpose.count != 0) {
         break;
       }
-      xret = XPutImage(ingdP->xdisplayP, ingdP->ximgwin, ingdP->xgc,
-        xiP, 0, 0, 0, 0, ingiP->width, ingiP->height);
+      viewShow(ingdP, ingiP, &view);
+      break;
+
+     case ConfigureNotify:
+      /* window resized, by us or the window manager */
+      if ((unsigned int)xevt.xconfigure.width != view.w ||
+          (unsigned int)xevt.xconfigure.height != view.h) {
+        view.w = xevt.xconfigure.width;
+        view.h = xevt.xconfigure.height;
+        viewClamp(&view, ingiP, 0, 0);
+        if (view.xiP != NULL) {
+          /* redraw with an XImage of the new size */
+          viewShow(ingdP, ingiP, &view);
+        }
+      }
+      break;
+
+     case ButtonPress:
+      if (xevt.xbutton.button == Button1) {
+        dragging = 1;
+        dragged = 0;
+        dragx = xevt.xbutton.x;
+        dragy = xevt.xbutton.y;
+      }
+      break;
+
+     case ButtonRelease:
+      if (xevt.xbutton.button == Button1) {
+        dragging = 0;
+        /* on a sheet, a click without a drag picks a place */
+        if (ingdP->changed != NULL && !dragged) {
+          ingdP->clickx = view.x + xevt.xbutton.x;
+          ingdP->clicky = view.y + xevt.xbutton.y;
+          status = 1;
+          r = 'c';
+        }
+      }
+      break;
+
+     case MotionNotify:
+      /* only the latest position matters */
+      while (XCheckTypedWindowEvent(ingdP->xdisplayP, ingdP->ximgwin,
+               MotionNotify, &xevt)) {
+        /* EMPTY */
+        ;
+      }
+      if (dragging) {
+        /* image follows the pointer */
+        if (viewClamp(&view, ingiP, dragx - xevt.xmotion.x,
+              dragy - xevt.xmotion.y)) {
+          viewShow(ingdP, ingiP, &view);
+        }
+        if (dragx != xevt.xmotion.x || dragy != xevt.xmotion.y) {
+          dragged = 1;
+        }
+        dragx = xevt.xmotion.x;
+        dragy = xevt.xmotion.y;
+      }
       break;
 
      case KeyPress:
       keycnt = XLookupString((XKeyEvent*)&xevt, buf, 8, &xkeysym, &xcompst);
-      if (buf[0] == 'q' || buf[0] == 'Q') {
+      if (xevt.xkey.state & ShiftMask) {
+        stepx = view.w;
+        stepy = view.h;
+      } else {
+        stepx = view.w / 8 + 1;
+        stepy = view.h / 8 + 1;
+      }
+      dx = 0;
+      dy = 0;
+      switch(xkeysym) {
+       case XK_Left:  dx = -stepx; break;
+       case XK_Right: dx =  stepx; break;
+       case XK_Up:    dy = -stepy; break;
+       case XK_Down:  dy =  stepy; break;
+      }
+      if (dx != 0 || dy != 0) {
+        if (viewClamp(&view, ingiP, dx, dy)) {
+          viewShow(ingdP, ingiP, &view);
+        }
+      } else if (keycnt == 0) {
+        /* other key without a string, shift etc */
+        break;
+      } else if (buf[0] == 'q' || buf[0] == 'Q') {
         status = 1;
         r = 'q';
       } else if (buf[0] == ' ' || buf[0] == 'n' || buf[0] == 'N') {
@@ -463,9 +808,10 @@ char r;
 
   XUnmapWindow(ingdP->xdisplayP, ingdP->ximgwin);
 
-  XDestroyImage(xiP);
-  xiP = NULL;
+  if (view.xiP != NULL) {
+    XDestroyImage(view.xiP);
+    view.xiP = NULL;
+  }
 
   return(r);
 }
-
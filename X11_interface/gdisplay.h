@@ -55,6 +55,44 @@ int gdbyteorderLSB(gdisplay gd);
 int gdbitorderLSB(gdisplay gd);
 
 
+/** gdsetgamma
+ * @ingroup gdisplay
+ * @param[in] gd
+ * @param[in] gamma adjustment applied while drawing, 1.0 for none
+ *
+ * same result as gammacorrect(), folded into the conversion for
+ * the window, so the image itself is unchanged
+ */
+void gdsetgamma(gdisplay gd, float gamma);
+
+
+/** gdsetsheet
+ * @ingroup gdisplay
+ * @param[in] gd
+ * @param[in] changed asked while nothing else is happening:
+ *  1 if the image shown has changed since it was last asked,
+ *  0 if not, -1 if it has changed for the last time.
+ *  NULL for an ordinary image.
+ * @param[in] ctx passed to changed
+ *
+ * for an image that fills in while it is shown, such as a contact
+ * sheet.  while set, a click with button 1 returns 'c' from
+ * gdImageInWindow(), see gdclick()
+ */
+void gdsetsheet(gdisplay gd, int (*changed)(void *ctx), void *ctx);
+
+
+/** gdclick
+ * @ingroup gdisplay
+ * @param[in] gd
+ * @param[out] x
+ * @param[out] y
+ *
+ * image coordinates of the click when gdImageInWindow() returned 'c'
+ */
+void gdclick(gdisplay gd, unsigned int *x, unsigned int *y);
+
+
 /** gdImageInWindow
  * @ingroup gdisplay
  */
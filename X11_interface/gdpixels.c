@@ -0,0 +1,214 @@
+/* gdpixels.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */ 
+
+/* conversion of gImage pixels to 32 bit display pixels */
+/*  the same for X11 and for the headless display */
+
+/* system */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h> /* memset */
+#include <stdint.h> /* for uint16_t, SIZE_MAX */
+
+/* code base */
+#include "gdpixels.h"
+
+#include "../gimage.h" /* gImage */
+#include "../transforms/colorspace.h" /* csEncodeTable8, CS_ENCSIZE */
+
+
+/* static internal functions */
+
+/**************/
+/* px4rgb24() */
+/**************/
+/* one row, through ingammaP if not NULL */
+static void
+px4rgb24(
+ unsigned char *outP,
+ const unsigned char *gP,
+ const unsigned char *ingammaP,
+ unsigned int inW)
+{
+unsigned char *xP = outP;
+unsigned int x;
+
+  if (ingammaP != NULL) {
+    for (x = 0; x < inW; x++) {
+      *xP++ = ingammaP[*(gP+2)]; /* blue */
+      *xP++ = ingammaP[*(gP+1)]; /* green */
+      *xP++ = ingammaP[*gP];     /* red */
+      *xP++ = 0;                 /* pad */
+      gP+= 3;
+    }
+  } else {
+    for (x = 0; x < inW; x++) {
+      /* X11 order by 'mask' red is byte 2, green byte 1, blue byte 0 */
+      *xP++ = *(gP+2); /* blue */
+      *xP++ = *(gP+1); /* green */
+      *xP++ = *gP;     /* red */
+      *xP++ = 0;       /* pad */
+      gP+= 3;
+    }
+  }
+}
+
+
+/**************/
+/* px4rgb48() */
+/**************/
+/* one row, through ingammaP if not NULL */
+static void
+px4rgb48(
+ unsigned char *outP,
+ const uint16_t *gP,
+ const uint16_t *ingammaP,
+ unsigned int inW)
+{
+unsigned char *xP = outP;
+unsigned int x;
+
+  if (ingammaP != NULL) {
+    for (x = 0; x < inW; x++) {
+      *xP++ = ingammaP[*(gP+2)] / 256; /* blue */
+      *xP++ = ingammaP[*(gP+1)] / 256; /* green */
+      *xP++ = ingammaP[*gP] / 256;     /* red */
+      *xP++ = 0;                       /* pad */
+      gP += 3;
+    }
+  } else {
+    for (x = 0; x < inW; x++) {
+      *xP++ = *(gP+2) / 256; /* blue */
+      *xP++ = *(gP+1) / 256; /* green */
+      *xP++ = *gP / 256;     /* red */
+      *xP++ = 0;             /* pad */
+      gP += 3;
+    }
+  }
+}
+
+
+/***************/
+/* px4rgbf32() */
+/***************/
+/* one row, linear light is encoded to 8 bit sRGB here, the only */
+/*  rounding, then through ingammaP if not NULL */
+static void
+px4rgbf32(
+ unsigned char *outP,
+ const float *gP,
+ const unsigned char *inencP,
+ const unsigned char *ingammaP,
+ unsigned int inW)
+{
+unsigned char *xP = outP;
+unsigned char rgb[3];
+float v;
+unsigned int x;
+unsigned int c;
+
+  for (x = 0; x < inW; x++) {
+    for (c = 0; c < 3; c++) {
+      v = gP[c];
+      if (!(v > 0.0f)) {
+        v = 0.0f; /* and NaN */
+      } else if (v > 1.0f) {
+        v = 1.0f;
+      }
+      rgb[c] = inencP[(size_t)(v * (CS_ENCSIZE - 1) + 0.5f)];
+      if (ingammaP != NULL) {
+        rgb[c] = ingammaP[rgb[c]];
+      }
+    }
+    *xP++ = rgb[2]; /* blue */
+    *xP++ = rgb[1]; /* green */
+    *xP++ = rgb[0]; /* red */
+    *xP++ = 0;      /* pad */
+    gP += 3;
+  }
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/**************/
+/* gdpixels() */
+/**************/
+unsigned char*
+gdpixels(
+ gImage *ingiP,
+ const unsigned char *ingamma8P,
+ const uint16_t *ingamma16P,
+ unsigned int inX,
+ unsigned int inY,
+ unsigned int inW,
+ unsigned int inH)
+{
+unsigned char *pixP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *gP = NULL;
+const unsigned char *encP = NULL;
+size_t rowbytes;
+size_t nbytes = 0;
+size_t scratchbytes;
+unsigned int y;
+
+  /* 4 bytes a pixel, checked as imageRowBytes() and imageDataBytes() do */
+  rowbytes = (size_t)inW * 4;
+  if (rowbytes / 4 != inW) {
+    /* size_t overflow */
+    rowbytes = 0;
+  }
+  if (rowbytes != 0 && inH <= SIZE_MAX / rowbytes) {
+    nbytes = rowbytes * inH;
+  }
+  scratchbytes = imageRowBytes(ingiP->gitype, inW);
+
+  if (RGBF32P(ingiP)) {
+    encP = csEncodeTable8();
+  }
+  if (nbytes == 0 || scratchbytes == 0) {
+    fprintf(stderr, "gdpixels %u x %u too large\n", inW, inH);
+  } else if (RGB24P(ingiP) || RGB48P(ingiP) ||
+             (RGBF32P(ingiP) && encP != NULL)) {
+    pixP = malloc(nbytes);
+    scratchP = malloc(scratchbytes);
+    if (pixP == NULL || scratchP == NULL) {
+      fprintf(stderr, "gdpixels malloc fail\n");
+    }
+  }
+  if (pixP == NULL || scratchP == NULL) {
+    free(pixP);
+    pixP = NULL;
+  } else {
+    for (y = 0; y < inH; y++) {
+      /* row from data, or from tiles if the image is tiled */
+      gP = imageRowP(ingiP, inX, inY + y, inW, scratchP);
+      if (gP == NULL) {
+        /* unreadable tile, show black */
+        memset(scratchP, 0, scratchbytes);
+        gP = scratchP;
+      }
+      switch(ingiP->gitype) {
+       case IRGB24:
+        px4rgb24(pixP + y * rowbytes, gP, ingamma8P, inW);
+        break;
+       case IRGB48:
+        px4rgb48(pixP + y * rowbytes, (uint16_t *)gP, ingamma16P, inW);
+        break;
+       default:
+        px4rgbf32(pixP + y * rowbytes, (float *)gP, encP, ingamma8P, inW);
+      }
+    }
+  }
+  free(scratchP);
+
+  return(pixP);
+}
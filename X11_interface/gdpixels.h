@@ -0,0 +1,46 @@
+/* gdpixels.h */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */ 
+
+#ifndef gdpixels_h
+#define gdpixels_h
+
+/**
+ * @defgroup gdpixels  pixel conversion for display
+ * color gImage rectangles to 32 bit display pixels, shared by
+ * every gdisplay.h implementation
+ *
+ * \#include "gdpixels.h"
+ */
+
+#include <stdint.h>     /* uint16_t */
+
+#include "../gimage.h"  /* 'gImage' struct */
+
+
+/** gdpixels
+ * @ingroup gdpixels
+ * @param[in] gimageP IRGB24, IRGB48 or IRGBF32
+ * @param[in] gamma8 IRGB24 and IRGBF32 gamma table, NULL if none
+ * @param[in] gamma16 IRGB48 gamma table, NULL if none
+ * @param[in] x left of the rectangle
+ * @param[in] y top of the rectangle
+ * @param[in] w width of the rectangle
+ * @param[in] h height of the rectangle
+ * @return w x h pixels of 4 bytes: blue, green, red, pad (0),
+ *  malloc'd, caller frees; NULL if out of memory, too large
+ *  or not a color type
+ *
+ * unreadable rows of tiled images are black
+ */
+unsigned char* gdpixels(gImage *gimageP, const unsigned char *gamma8,
+ const uint16_t *gamma16, unsigned int x, unsigned int y,
+ unsigned int w, unsigned int h);
+
+#endif
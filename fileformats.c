@@ -10,13 +10,15 @@
 
 /* Standard C library */
 #include <stdlib.h>
-#include <stdio.h>     /* fprintf, perror */
-#include <string.h>    /* strlen, strncmp */
+#include <stdio.h>     /* fprintf, perror, rename */
+#include <string.h>    /* strlen, strncmp, strcmp */
 #include <errno.h>     /* errno */
+#include <stdatomic.h> /* atomic_uint, temporary file names */
 
 /* POSIX Issue 1 */
 #include <sys/stat.h>  /* stat, struct stat, S_IFMT, S_IFDIR */
-#include <unistd.h>    /* access, R_OK */
+#include <unistd.h>    /* access, R_OK, getpid, close, unlink */
+#include <fcntl.h>     /* open, O_EXCL */
 
 
 /* code base */
@@ -33,16 +35,29 @@
 #include "formats/png_fmt.h"
 #include "formats/webp_fmt.h"
 
+#include "transforms/colorspace.h" /* csEncodeImage */
+#include "transforms/zoom.h"       /* zoom */
+
+#include "thumbcache.h" /* cacheLoad, cacheStore, cacheKeyFree */
+#include "profile.h"    /* profileBegin, profileEnd */
+
 
 /* INTERNAL */
 
 struct fileformats FileFormats[] = {
- { tiffLoad,    "tiff",      "TIFF"},
- { jpegLoad,    "jpeg",      "JPEG"},
- { pngLoad,     "png",       "PNG"},
- { webpLoad,    "webp",      "WebP"},
- { pbmLoad,     "pbm",       "NetPBM pbm,pgm,ppm"},
- { xbitmapLoad, "xbm",       "XBitMap xbm"},
+ { tiffLoad,    "tiff",      "TIFF",               tiffLoadScaled},
+ { jpegLoad,    "jpeg",      "JPEG",               jpegLoadScaled},
+ { pngLoad,     "png",       "PNG",                NULL},
+ { webpLoad,    "webp",      "WebP",               webpLoadScaled},
+ { pbmLoad,     "pbm",       "NetPBM pbm,pgm,ppm", NULL},
+ { xbitmapLoad, "xbm",       "XBitMap xbm",        NULL},
+ { NULL,         NULL,        NULL,                NULL}
+};
+
+struct fileformat_writers FileWriters[] = {
+ { pbmWrite,    "ppm",       "ppm"},
+ { pngWrite,    "png",       "png"},
+ { jpegWrite,   "jpeg",      "jpg"},
  { NULL,         NULL,        NULL}
 };
 
@@ -83,17 +98,44 @@ struct stat filestat;
 }
 
 
-/* PUBLIC FUNCTIONS */
+/****************/
+/* formatLoad() */
+/****************/
+/* load with one format, at reduced size if maxdim is not 0 */
+/*  and the format can */
+/*  a loader that turns the file down is timed as sniffing */
+static gImage*
+formatLoad(
+ int i,
+ const char *filepath,
+ unsigned int maxdim,
+ unsigned int verbose)
+{
+gImage *gimageP = NULL;
+ProfileSpan span;
 
-/***************/
-/* loadImage() */
-/***************/
+  profileBegin(&span);
+  if (maxdim != 0 && FileFormats[i].scaledloader != NULL) {
+    gimageP = FileFormats[i].scaledloader(filepath, maxdim, verbose);
+  } else {
+    gimageP = FileFormats[i].loader(filepath, verbose);
+  }
+  profileEnd(&span, (gimageP != NULL ? "decode" : "sniff"), filepath);
+  return(gimageP);
+}
+
+
+/****************/
+/* loadScaled() */
+/****************/
 /* load a file into gImage (generic image) */
-gImage*
-loadImage(
+/*  maxdim 0 for full size, see formatLoad() */
+static gImage*
+loadScaled(
  OptionSet *globalopts,
  OptionSet *options,
  const char *filepath,
+ unsigned int maxdim,
  unsigned int verbose)
 {
 Option *opt = NULL;
@@ -124,7 +166,7 @@ int     formatmatched = 0;
         if (!strncmp(FileFormats[i].format_id, opt->info.format_id, strlen(opt->info.format_id))) {
           /* specified format_id matched, so try to use that loader */
           formatmatched = -1;
-          gimageP = FileFormats[i].loader(filepath, verbose);
+          gimageP = formatLoad(i, filepath, maxdim, verbose);
           if (gimageP == NULL) {
             fprintf(stderr, "%s does not look like a \"%s\" format.\n",
               filepath, opt->info.format_id); 
@@ -145,7 +187,7 @@ int     formatmatched = 0;
     if (gimageP == NULL) {
       /* try each format in order of FileFormats array */
       for (i = 0; FileFormats[i].loader != NULL; i++) {
-        gimageP = FileFormats[i].loader(filepath, verbose);
+        gimageP = formatLoad(i, filepath, maxdim, verbose);
         if (gimageP != NULL) {
           break;
         }
@@ -161,6 +203,88 @@ int     formatmatched = 0;
 }
 
 
+/* PUBLIC FUNCTIONS */
+
+/***************/
+/* loadImage() */
+/***************/
+/* load a file into gImage (generic image) */
+gImage*
+loadImage(
+ OptionSet *globalopts,
+ OptionSet *options,
+ const char *filepath,
+ unsigned int verbose)
+{
+  return(loadScaled(globalopts, options, filepath, 0, verbose));
+}
+
+
+/*******************/
+/* loadThumbnail() */
+/*******************/
+/* load a file no larger than maxdim x maxdim */
+/*  from the thumbnail cache if it is there, else */
+/*  the decoder does what it can, zoom() the rest */
+gImage*
+loadThumbnail(
+ OptionSet *globalopts,
+ OptionSet *options,
+ const char *filepath,
+ unsigned int maxdim,
+ unsigned int verbose)
+{
+gImage *gimageP = NULL;
+gImage *zgimageP = NULL;
+unsigned int big;
+unsigned int percent;
+unsigned int xpercent;
+unsigned int ypercent;
+CacheKey key;
+ProfileSpan span;
+
+  profileBegin(&span);
+  /* the key is taken before decoding, see cacheStore() */
+  gimageP = cacheLoad(filepath, maxdim, &key, verbose);
+  profileEnd(&span, "cache", filepath);
+  if (gimageP == NULL) {
+    gimageP = loadScaled(globalopts, options, filepath, maxdim, verbose);
+    /* zoom() takes whole percents, rounded down so never over maxdim; */
+    /*  past 100 x maxdim even 1% is too big, and another pass is made. */
+    /*  a side that would go to 0 pixels is kept at 1 */
+    while (gimageP != NULL && maxdim > 0 &&
+           (gimageP->width > maxdim || gimageP->height > maxdim)) {
+      big = (gimageP->width > gimageP->height ? gimageP->width : gimageP->height);
+      percent = (unsigned int)(((unsigned long long)maxdim * 100) / big);
+      if (percent < 1) {
+        percent = 1;
+      }
+      xpercent = percent;
+      if ((unsigned long long)gimageP->width * percent < 100) {
+        xpercent = (100 + gimageP->width - 1) / gimageP->width;
+      }
+      ypercent = percent;
+      if ((unsigned long long)gimageP->height * percent < 100) {
+        ypercent = (100 + gimageP->height - 1) / gimageP->height;
+      }
+      profileBegin(&span);
+      zgimageP = zoom(gimageP, xpercent, ypercent, verbose);
+      profileEnd(&span, "zoom", filepath);
+      /* NULL if zoom() ran out of memory, no thumbnail then */
+      if (zgimageP != gimageP) {
+        freeImage(gimageP);
+        gimageP = zgimageP;
+      }
+    }
+    if (gimageP != NULL) {
+      cacheStore(&key, gimageP, verbose);
+    }
+  }
+  cacheKeyFree(&key);
+  return(gimageP);
+}
+
+
 /**********************/
 /* supportedFormats() */
 /**********************/
@@ -177,3 +301,124 @@ int i = 0;
   }
 }
 
+
+
+/*********************/
+/* outputExtension() */
+/*********************/
+const char*
+outputExtension(
+ const char *format_id)
+{
+const char *ext = NULL;
+int i;
+
+  for (i = 0; FileWriters[i].writer != NULL; i++) {
+    if (strcmp(FileWriters[i].format_id, format_id) == 0) {
+      ext = FileWriters[i].extension;
+      break;
+    }
+  }
+  return(ext);
+}
+
+
+/**************/
+/* saveTemp() */
+/**************/
+/* a new empty file next to inFilepath, for an image to be written */
+/*  to and renamed, so a failed write leaves any old file as it was */
+/*  made with open(), not mkstemp(), so the umask gives its mode */
+/*  returns the malloc'd name, NULL on error */
+static char*
+saveTemp(
+ const char *inFilepath)
+{
+static atomic_uint serial = 0;
+char *rpathP = NULL;
+size_t len;
+int fd = -1;
+int tries;
+
+  len = strlen(inFilepath) + 48;
+  rpathP = malloc(len);
+  for (tries = 0; rpathP != NULL && fd < 0 && tries < 100; tries++) {
+    snprintf(rpathP, len, "%s.%ld.%u.tmp", inFilepath, (long)getpid(),
+      atomic_fetch_add(&serial, 1));
+    fd = open(rpathP, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0 && errno != EEXIST) {
+      break;
+    }
+  }
+  if (fd < 0) {
+    perror(inFilepath);
+    free(rpathP);
+    rpathP = NULL;
+  } else {
+    close(fd);
+  }
+  return(rpathP);
+}
+
+
+/***************/
+/* saveImage() */
+/***************/
+/* write gImage (generic image) to a file */
+/*  ppm is written as pbm for bitmaps */
+/*  written to a temporary name and renamed, see saveTemp() */
+int
+saveImage(
+ gImage *gimageP,
+ const char *filepath,
+ const char *format_id,
+ unsigned int verbose)
+{
+gImage *encodedP = NULL;
+char *tmpP = NULL;
+int i;
+int status = (-1);
+ProfileSpan span;
+
+  for (i = 0; FileWriters[i].writer != NULL; i++) {
+    if (strcmp(FileWriters[i].format_id, format_id) == 0) {
+      break;
+    }
+  }
+
+  if (FileWriters[i].writer == NULL) {
+    fprintf(stderr, "\"%s\" is not a supported output format\n", format_id);
+  } else {
+    if (RGBF32P(gimageP)) {
+      encodedP = csEncodeImage(gimageP, IRGB48);
+      if (encodedP == NULL) {
+        fprintf(stderr, "%s: cannot encode linear image\n", filepath);
+      }
+    }
+    if (!RGBF32P(gimageP) || encodedP != NULL) {
+      tmpP = saveTemp(filepath);
+    }
+    if (tmpP != NULL) {
+      profileBegin(&span);
+      status = FileWriters[i].writer(encodedP != NULL ? encodedP : gimageP,
+        tmpP);
+      profileEnd(&span, "write", filepath);
+      if (status == 0 && rename(tmpP, filepath) != 0) {
+        perror(filepath);
+        status = (-1);
+      }
+      if (status != 0) {
+        unlink(tmpP);
+      }
+      free(tmpP);
+    }
+    if (encodedP != NULL) {
+      freeImage(encodedP);
+    }
+    if (verbose && status == 0) {
+      printf("  wrote %s (%s)\n", filepath, format_id);
+    }
+  }
+
+  return(status);
+}
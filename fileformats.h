@@ -26,6 +26,14 @@ struct fileformats {
   gImage* (*loader)(const char *, unsigned int);
   char*   format_id;
   char*   description;
+  /* reduced size decoding, NULL if the format has none */
+  gImage* (*scaledloader)(const char *, unsigned int, unsigned int);
+};
+
+struct fileformat_writers {
+  int   (*writer)(gImage *, const char *);
+  char*   format_id;
+  char*   extension;
 };
 
 
@@ -49,5 +57,43 @@ void supportedFormats(void);
 gImage* loadImage(OptionSet *globalopts, OptionSet *options, const char *filename, unsigned int verbose);
 
 
+/** loadThumbnail
+ * @ingroup fileformats
+ * @param[in] globalopts
+ * @param[in] options
+ * @param[in] filename
+ * @param[in] maxdim longest side of the result, in pixels
+ * @param[in] verbose
+ * @return gImage no larger than maxdim x maxdim, NULL if error
+ *
+ * as loadImage(), decoded at reduced size where the format can,
+ * then zoomed to fit
+ */
+gImage* loadThumbnail(OptionSet *globalopts, OptionSet *options, const char *filename, unsigned int maxdim, unsigned int verbose);
+
+
+/** saveImage
+ * @ingroup fileformats
+ * @param[in] gimageP
+ * @param[in] filename
+ * @param[in] format_id "ppm", "png" or "jpeg", as for -outformat
+ * @param[in] verbose
+ * @return 0, or -1 if error
+ *
+ * write a gImage in the given format, linear images are encoded
+ * to 16 bit sRGB first
+ */
+int saveImage(gImage *gimageP, const char *filename, const char *format_id, unsigned int verbose);
+
+
+/** outputExtension
+ * @ingroup fileformats
+ * @param[in] format_id as for saveImage
+ * @return file name extension for format_id, or NULL if there is
+ *  no writer for it
+ */
+const char* outputExtension(const char *format_id);
+
+
 #endif
 
@@ -0,0 +1,240 @@
+/* exif.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */ 
+
+/* EXIF is a small TIFF file: header, then IFDs of 12 byte entries */
+/*  every offset is from the start of the TIFF header */
+/*  and every read is bounds checked, the data is untrusted */
+
+/* C System */
+#include <stdlib.h>
+#include <string.h>    /* memcmp */
+
+/* code base */
+#include "exif.h"      /* enforce declarations */
+
+
+/* internal defines */
+#define EXIF_HEADER_LEN (6)      /* "Exif\0\0" */
+#define EXIF_TAG_ORIENTATION (0x0112)
+#define EXIF_TAG_JPEGOFFSET (0x0201) /* JPEGInterchangeFormat */
+#define EXIF_TAG_JPEGLENGTH (0x0202) /* JPEGInterchangeFormatLength */
+#define EXIF_TYPE_SHORT (3)
+#define EXIF_TYPE_LONG (4)
+
+
+/* internal structures */
+
+/* TIFF data inside an EXIF block */
+struct exiftiff_struct {
+ const unsigned char *tiffP;
+ size_t               len;
+ int                  bigendian; /* -1 (true) if "MM" */
+};
+
+
+/* internal static functions */
+
+/************/
+/* exif16() */
+/************/
+/* 16 bit value at inOffset, 0 if out of range */
+static unsigned int
+exif16(
+ const struct exiftiff_struct *inExifP,
+ size_t inOffset)
+{
+unsigned int v = 0;
+const unsigned char *p = NULL;
+
+  if (inOffset <= inExifP->len && inExifP->len - inOffset >= 2) {
+    p = inExifP->tiffP + inOffset;
+    if (inExifP->bigendian) {
+      v = (unsigned int)p[0] << 8 | p[1];
+    } else {
+      v = (unsigned int)p[1] << 8 | p[0];
+    }
+  }
+  return(v);
+}
+
+
+/************/
+/* exif32() */
+/************/
+/* 32 bit value at inOffset, 0 if out of range */
+static unsigned long
+exif32(
+ const struct exiftiff_struct *inExifP,
+ size_t inOffset)
+{
+unsigned long v = 0;
+
+  if (inOffset <= inExifP->len && inExifP->len - inOffset >= 4) {
+    if (inExifP->bigendian) {
+      v = (unsigned long)exif16(inExifP, inOffset) << 16 |
+          exif16(inExifP, inOffset + 2);
+    } else {
+      v = (unsigned long)exif16(inExifP, inOffset + 2) << 16 |
+          exif16(inExifP, inOffset);
+    }
+  }
+  return(v);
+}
+
+
+/**************/
+/* exifOpen() */
+/**************/
+/* check the header and byte order */
+/*  returns offset of IFD0, 0 if not EXIF */
+static unsigned long
+exifOpen(
+ struct exiftiff_struct *outExifP,
+ const unsigned char *inExifP,
+ size_t inLen)
+{
+unsigned long ifd = 0;
+
+  if (inLen >= EXIF_HEADER_LEN + 8 &&
+      memcmp(inExifP, "Exif\0\0", EXIF_HEADER_LEN) == 0) {
+    outExifP->tiffP = inExifP + EXIF_HEADER_LEN;
+    outExifP->len = inLen - EXIF_HEADER_LEN;
+    if (memcmp(outExifP->tiffP, "MM", 2) == 0) {
+      outExifP->bigendian = -1;
+    } else if (memcmp(outExifP->tiffP, "II", 2) == 0) {
+      outExifP->bigendian = 0;
+    } else {
+      outExifP->len = 0;
+    }
+    if (exif16(outExifP, 2) == 42) {
+      ifd = exif32(outExifP, 4);
+    }
+  }
+  return(ifd);
+}
+
+
+/*****************/
+/* exifIFDFind() */
+/*****************/
+/* offset of the entry for inTag in the IFD at inIFD, 0 if none */
+static size_t
+exifIFDFind(
+ const struct exiftiff_struct *inExifP,
+ unsigned long inIFD,
+ unsigned int inTag)
+{
+size_t entry = 0;
+size_t e;
+unsigned int n;
+unsigned int i;
+
+  n = exif16(inExifP, inIFD);
+  for (i = 0; i < n; i++) {
+    e = inIFD + 2 + (size_t)i * 12;
+    if (e > inExifP->len || inExifP->len - e < 12) {
+      break;
+    }
+    if (exif16(inExifP, e) == inTag) {
+      entry = e;
+      break;
+    }
+  }
+  return(entry);
+}
+
+
+/*****************/
+/* exifIFDLong() */
+/*****************/
+/* single LONG value of inTag in the IFD at inIFD, 0 if none */
+static unsigned long
+exifIFDLong(
+ const struct exiftiff_struct *inExifP,
+ unsigned long inIFD,
+ unsigned int inTag)
+{
+size_t entry;
+unsigned long v = 0;
+
+  entry = exifIFDFind(inExifP, inIFD, inTag);
+  if (entry != 0 && exif16(inExifP, entry + 2) == EXIF_TYPE_LONG &&
+      exif32(inExifP, entry + 4) == 1) {
+    v = exif32(inExifP, entry + 8);
+  }
+  return(v);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/*********************/
+/* exifOrientation() */
+/*********************/
+unsigned int
+exifOrientation(
+ const unsigned char *inExifP,
+ size_t inLen)
+{
+struct exiftiff_struct exif;
+unsigned long ifd0;
+size_t entry = 0;
+unsigned int orientation = 1;
+unsigned int v;
+
+  ifd0 = exifOpen(&exif, inExifP, inLen);
+  if (ifd0 != 0) {
+    entry = exifIFDFind(&exif, ifd0, EXIF_TAG_ORIENTATION);
+  }
+  if (entry != 0 && exif16(&exif, entry + 2) == EXIF_TYPE_SHORT) {
+    /* a single SHORT is stored in the first bytes of the value field */
+    v = exif16(&exif, entry + 8);
+    if (v >= 1 && v <= 8) {
+      orientation = v;
+    }
+  }
+  return(orientation);
+}
+
+
+/*******************/
+/* exifThumbnail() */
+/*******************/
+/* IFD1, after the entries of IFD0, describes the thumbnail */
+const unsigned char*
+exifThumbnail(
+ const unsigned char *inExifP,
+ size_t inLen,
+ size_t *outLen)
+{
+struct exiftiff_struct exif;
+const unsigned char *thumbP = NULL;
+unsigned long ifd0;
+unsigned long ifd1 = 0;
+unsigned long offset = 0;
+unsigned long len = 0;
+
+  *outLen = 0;
+  ifd0 = exifOpen(&exif, inExifP, inLen);
+  if (ifd0 != 0) {
+    ifd1 = exif32(&exif, ifd0 + 2 + (size_t)exif16(&exif, ifd0) * 12);
+  }
+  if (ifd1 != 0 && ifd1 != ifd0) {
+    offset = exifIFDLong(&exif, ifd1, EXIF_TAG_JPEGOFFSET);
+    len = exifIFDLong(&exif, ifd1, EXIF_TAG_JPEGLENGTH);
+  }
+  if (offset != 0 && len >= 2 && offset <= exif.len &&
+      exif.len - offset >= len &&
+      exif.tiffP[offset] == 0xFF && exif.tiffP[offset + 1] == 0xD8) {
+    thumbP = exif.tiffP + offset;
+    *outLen = len;
+  }
+  return(thumbP);
+}
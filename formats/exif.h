@@ -0,0 +1,47 @@
+/* exif.h */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */ 
+
+#ifndef exif_h
+#define exif_h
+
+/**
+ * @defgroup exif EXIF routines
+ * functions to read EXIF metadata embedded in other formats
+ *
+ * \#include "exif.h"
+ */
+
+#include <stddef.h> /* size_t */
+
+
+/** exifOrientation
+ * @ingroup exif
+ * @param[in] exifP EXIF block, starting with "Exif\0\0" (JPEG APP1 payload)
+ * @param[in] len bytes at exifP
+ * @return Orientation tag, 1 to 8, or 1 if absent or unreadable
+ *
+ * see rotate.h for the meaning of the values
+ */
+unsigned int exifOrientation(const unsigned char *exifP, size_t len);
+
+
+/** exifThumbnail
+ * @ingroup exif
+ * @param[in] exifP EXIF block, starting with "Exif\0\0" (JPEG APP1 payload)
+ * @param[in] len bytes at exifP
+ * @param[out] outLen bytes of the thumbnail
+ * @return the embedded JPEG thumbnail, within exifP, or NULL if none
+ *
+ * the thumbnail is stored in the orientation of the main image
+ */
+const unsigned char* exifThumbnail(const unsigned char *exifP, size_t len, size_t *outLen);
+
+
+#endif
@@ -11,26 +11,299 @@
 /* C System */
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>     /* strncpy */
+#include <string.h>     /* strncpy, memcmp, memset, memcpy */
+#include <stdint.h>     /* uint16_t */
 
 /* libJPEG  Independent JPEG Group IJG, preference version 6b */
 #include "jpeglib.h"
+#include "jerror.h"   /* WARNMS, for the memory source */
 /* or if part of system */
 /* #include <jpeglib.h> */
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
+#include "../transforms/rotate.h" /* orientPutRows */
+#include "../transforms/icc.h" /* iccLut, iccApply8 */
+#include "exif.h"      /* exifOrientation, exifThumbnail */
 
 #include "jpeg_fmt.h"  /* enforce declarations */
 
-/* PUBLIC FUNCTIONS */
 
-/**************/
-/* jpegLoad() */
-/**************/
-gImage*
-jpegLoad(
+/* internal static functions */
+
+/*********************/
+/* jpegOrientation() */
+/*********************/
+/* Orientation from a saved EXIF APP1 marker, 1 if none */
+static unsigned int
+jpegOrientation(
+ struct jpeg_decompress_struct *inDinfoP)
+{
+jpeg_saved_marker_ptr markerP = NULL;
+unsigned int orientation = 1;
+
+  for (markerP = inDinfoP->marker_list; markerP != NULL; markerP = markerP->next) {
+    if (markerP->marker == JPEG_APP0 + 1 && markerP->data_length >= 6 &&
+        memcmp(markerP->data, "Exif\0\0", 6) == 0) {
+      orientation = exifOrientation(markerP->data, markerP->data_length);
+      break;
+    }
+  }
+  return(orientation);
+}
+
+
+/*****************/
+/* jpegICCPart() */
+/*****************/
+/* part number of an APP2 ICC profile marker, from 1, 0 if not one */
+static unsigned int
+jpegICCPart(
+ jpeg_saved_marker_ptr inMarkerP)
+{
+unsigned int part = 0;
+
+  if (inMarkerP->marker == JPEG_APP0 + 2 && inMarkerP->data_length > 14 &&
+      memcmp(inMarkerP->data, "ICC_PROFILE", 12) == 0) {
+    part = inMarkerP->data[12];
+  }
+  return(part);
+}
+
+
+/*************/
+/* jpegICC() */
+/*************/
+/* ICC profile from saved APP2 markers, NULL if none or incomplete */
+/*  a profile over 64K is split across markers, each starting */
+/*  "ICC_PROFILE\0", then its part number and the count of parts */
+/*  returned profile is malloc'd, caller frees */
+static unsigned char*
+jpegICC(
+ struct jpeg_decompress_struct *inDinfoP,
+ size_t *outLen)
+{
+jpeg_saved_marker_ptr markerP = NULL;
+unsigned char *iccP = NULL;
+size_t len = 0;
+unsigned int count = 0;
+unsigned int nparts = 0;
+unsigned int part;
+
+  for (markerP = inDinfoP->marker_list; markerP != NULL; markerP = markerP->next) {
+    if (jpegICCPart(markerP) != 0) {
+      count = markerP->data[13];
+      nparts++;
+      len += markerP->data_length - 14;
+    }
+  }
+  if (nparts != 0 && nparts == count) {
+    iccP = malloc(len);
+  }
+  /* parts in order, a missing one drops the profile */
+  *outLen = 0;
+  for (part = 1; iccP != NULL && part <= count; part++) {
+    for (markerP = inDinfoP->marker_list; markerP != NULL; markerP = markerP->next) {
+      if (jpegICCPart(markerP) == part) {
+        memcpy(iccP + *outLen, markerP->data + 14, markerP->data_length - 14);
+        *outLen += markerP->data_length - 14;
+        break;
+      }
+    }
+    if (markerP == NULL) {
+      free(iccP);
+      iccP = NULL;
+    }
+  }
+  return(iccP);
+}
+
+
+/*****************/
+/* jpegSOFSize() */
+/*****************/
+/* width and height from the frame header of a JPEG in memory */
+/*  returns -1 (true) if found before the first scan */
+static int
+jpegSOFSize(
+ const unsigned char *inP,
+ size_t inLen,
+ unsigned int *outW,
+ unsigned int *outH)
+{
+size_t pos = 2; /* after SOI */
+size_t seglen;
+unsigned int marker;
+int found = 0;
+
+  while (!found && pos + 4 <= inLen && inP[pos] == 0xFF) {
+    marker = inP[pos + 1];
+    if (marker == 0xFF) {
+      /* fill byte */
+      pos++;
+      continue;
+    }
+    if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      /* no length */
+      pos += 2;
+      continue;
+    }
+    if (marker == 0xDA || marker == 0xD9) {
+      break;
+    }
+    seglen = (size_t)inP[pos + 2] << 8 | inP[pos + 3];
+    if (marker >= 0xC0 && marker <= 0xCF &&
+        marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      /* SOFn: length, precision, height, width */
+      if (seglen >= 7 && inLen - pos >= 2 + 7) {
+        *outH = (unsigned int)inP[pos + 5] << 8 | inP[pos + 6];
+        *outW = (unsigned int)inP[pos + 7] << 8 | inP[pos + 8];
+        found = -1;
+      }
+      break;
+    }
+    pos += 2 + seglen;
+  }
+  return(found);
+}
+
+
+/*****************/
+/* jpegMemNone() */
+/*****************/
+/* jpeg_source_mgr callbacks for a buffer in memory, see jpegMemSrc() */
+/*  nothing to set up or release */
+static void
+jpegMemNone(
+ j_decompress_ptr inDinfoP)
+{
+  (void)inDinfoP;
+}
+
+
+/*****************/
+/* jpegMemFill() */
+/*****************/
+/* the whole buffer was given at the start, so this is past its end: */
+/*  an EOI marker, as libJPEG's own sources do for a truncated file */
+static boolean
+jpegMemFill(
+ j_decompress_ptr inDinfoP)
+{
+static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+
+  WARNMS(inDinfoP, JWRN_JPEG_EOF);
+  inDinfoP->src->next_input_byte = eoi;
+  inDinfoP->src->bytes_in_buffer = 2;
+  return(TRUE);
+}
+
+
+/*****************/
+/* jpegMemSkip() */
+/*****************/
+static void
+jpegMemSkip(
+ j_decompress_ptr inDinfoP,
+ long inCount)
+{
+struct jpeg_source_mgr *srcP = inDinfoP->src;
+
+  if (inCount > 0) {
+    if ((size_t)inCount > srcP->bytes_in_buffer) {
+      jpegMemFill(inDinfoP);
+    } else {
+      srcP->next_input_byte += inCount;
+      srcP->bytes_in_buffer -= inCount;
+    }
+  }
+}
+
+
+/****************/
+/* jpegMemSrc() */
+/****************/
+/* read from a buffer in memory, which must outlive the decode */
+/*  jpeg_mem_src() does this, but only from libJPEG 8 */
+static void
+jpegMemSrc(
+ j_decompress_ptr inDinfoP,
+ const unsigned char *inBufP,
+ size_t inLen)
+{
+struct jpeg_source_mgr *srcP = NULL;
+
+  srcP = (*inDinfoP->mem->alloc_small)((j_common_ptr)inDinfoP,
+    JPOOL_PERMANENT, sizeof(struct jpeg_source_mgr));
+  srcP->init_source = jpegMemNone;
+  srcP->fill_input_buffer = jpegMemFill;
+  srcP->skip_input_data = jpegMemSkip;
+  srcP->resync_to_restart = jpeg_resync_to_restart;
+  srcP->term_source = jpegMemNone;
+  srcP->next_input_byte = inBufP;
+  srcP->bytes_in_buffer = inLen;
+  inDinfoP->src = srcP;
+}
+
+
+/*******************/
+/* jpegThumbnail() */
+/*******************/
+/* copy of the EXIF thumbnail, if it is at least inMaxdim on the */
+/*  longer side and has the shape of the main image, else NULL */
+/*  cameras often pad 3:2 images into a 4:3 thumbnail, so the */
+/*  shape is checked, to a pixel of the thumbnail either way */
+/*  returned thumbnail is malloc'd, caller frees */
+static unsigned char*
+jpegThumbnail(
+ struct jpeg_decompress_struct *inDinfoP,
+ unsigned int inMaxdim,
+ size_t *outLen)
+{
+jpeg_saved_marker_ptr markerP = NULL;
+const unsigned char *thumbP = NULL;
+unsigned char *rthumbP = NULL;
+size_t len = 0;
+unsigned int w = 0;
+unsigned int h = 0;
+double d;
+
+  for (markerP = inDinfoP->marker_list; markerP != NULL; markerP = markerP->next) {
+    if (markerP->marker == JPEG_APP0 + 1 && markerP->data_length >= 6 &&
+        memcmp(markerP->data, "Exif\0\0", 6) == 0) {
+      thumbP = exifThumbnail(markerP->data, markerP->data_length, &len);
+      break;
+    }
+  }
+  if (thumbP != NULL && jpegSOFSize(thumbP, len, &w, &h)) {
+    d = (double)w * inDinfoP->image_height - (double)h * inDinfoP->image_width;
+    if (d < 0) {
+      d = -d;
+    }
+    if ((w > h ? w : h) >= inMaxdim && w != 0 && h != 0 &&
+        w < inDinfoP->image_width && h < inDinfoP->image_height &&
+        d <= (double)inDinfoP->image_width + inDinfoP->image_height) {
+      rthumbP = malloc(len);
+    }
+  }
+  if (rthumbP != NULL) {
+    memcpy(rthumbP, thumbP, len);
+    *outLen = len;
+  }
+  return(rthumbP);
+}
+
+
+/****************/
+/* jpegDecode() */
+/****************/
+/* inMaxdim 0 for full size, else the EXIF thumbnail if it is big */
+/*  enough, or the smallest DCT scaling, 1/2, 1/4 or 1/8, still at */
+/*  least inMaxdim on the longer side */
+static gImage*
+jpegDecode(
  const char *inFilepath,
+ unsigned int inMaxdim,
  unsigned int inVerbose)
 {
 int status = 0;
@@ -43,9 +316,23 @@ int jpeg_ret = 0;
 unsigned int jpeg_w;
 unsigned int jpeg_h;
 unsigned int jpeg_comps;
+unsigned int jpeg_big;
 int jpeg_rowstride = 0;
 unsigned char *rowP = NULL;
 int i;
+/* not upright: rows are gathered in blockP, then put in place */
+unsigned int orientation = 1;
+unsigned char *blockP = NULL;
+unsigned char *blkrowP[ORIENT_ROWS];
+unsigned int nblk = 0;
+size_t rowbytes;
+/* embedded profile: each row is converted as it is read */
+unsigned char *iccP = NULL;
+size_t icclen = 0;
+icclut lut = NULL;
+/* EXIF thumbnail, decoded instead of the main image */
+unsigned char *thumbP = NULL;
+size_t thumblen = 0;
 /* JPEG specific */
 struct jpeg_error_mgr jerr;
 struct jpeg_decompress_struct dinfo;
@@ -73,17 +360,66 @@ JSAMPARRAY buffer = NULL;
     dinfo.err = jpeg_std_error(&jerr);
     jpeg_create_decompress(&dinfo);
     jpeg_stdio_src(&dinfo, fP);
+    /* keep APP1 for the EXIF Orientation */
+    jpeg_save_markers(&dinfo, JPEG_APP0 + 1, 0xffff);
+    /* and APP2 for the ICC profile */
+    jpeg_save_markers(&dinfo, JPEG_APP0 + 2, 0xffff);
     jpeg_ret = jpeg_read_header(&dinfo, TRUE);
     if (jpeg_ret != JPEG_HEADER_OK) {
       fprintf(stderr, "JPEG error jpeg_read_header returned %d\n", jpeg_ret);
     }
+    orientation = jpegOrientation(&dinfo);
+    /* the saved markers do not outlive a switch to the thumbnail */
+    iccP = jpegICC(&dinfo, &icclen);
+    if (inMaxdim != 0) {
+      thumbP = jpegThumbnail(&dinfo, inMaxdim, &thumblen);
+    }
+    if (thumbP != NULL) {
+      /* a new object, libJPEG will not change the kind of source */
+      jpeg_destroy_decompress(&dinfo);
+      dinfo.err = jpeg_std_error(&jerr);
+      jpeg_create_decompress(&dinfo);
+      jpegMemSrc(&dinfo, thumbP, thumblen);
+      jpeg_ret = jpeg_read_header(&dinfo, TRUE);
+      if (jpeg_ret != JPEG_HEADER_OK) {
+        fprintf(stderr, "JPEG error jpeg_read_header returned %d\n", jpeg_ret);
+      }
+    }
+    if (inMaxdim != 0) {
+      jpeg_big = (dinfo.image_width > dinfo.image_height ?
+                  dinfo.image_width : dinfo.image_height);
+      dinfo.scale_num = 1;
+      dinfo.scale_denom = 1;
+      while (dinfo.scale_denom < 8 &&
+             (jpeg_big + dinfo.scale_denom * 2 - 1) / (dinfo.scale_denom * 2)
+               >= inMaxdim) {
+        dinfo.scale_denom *= 2;
+      }
+      /* a preview, speed over the last bit of quality */
+      dinfo.dct_method = JDCT_IFAST;
+      dinfo.do_fancy_upsampling = FALSE;
+    }
     jpeg_start_decompress(&dinfo);
 
     jpeg_w = dinfo.output_width;
     jpeg_h = dinfo.output_height;
     jpeg_comps = dinfo.output_components;
+    rowbytes = imageRowBytes(IRGB24, jpeg_w);
 
-    rgiP = newRGB24Image(jpeg_w, jpeg_h);
+    if (orientation != 1) {
+      /* scanlines are written straight to their upright place */
+      rgiP = newOrientedImage(IRGB24, jpeg_w, jpeg_h, orientation);
+      blockP = malloc(rowbytes * ORIENT_ROWS);
+      if (blockP == NULL) {
+        freeImage(rgiP);
+        rgiP = NULL;
+      }
+    } else if (jpeg_comps == 3 || jpeg_comps == 1) {
+      /* every scanline is written below, zero fill not needed */
+      rgiP = newRGB24ImageUninit(jpeg_w, jpeg_h);
+    } else {
+      rgiP = newRGB24Image(jpeg_w, jpeg_h);
+    }
     if (rgiP == NULL) {
       fprintf(stderr, "JPEG error newRGB24Image\n");
     } else {
@@ -91,6 +427,19 @@ JSAMPARRAY buffer = NULL;
       if (inVerbose) {
         printf("%s, JPEG, %d components, size: %d x %d\n",
           inFilepath, jpeg_comps, jpeg_w, jpeg_h); 
+        if (thumbP != NULL) {
+          printf(" EXIF thumbnail\n");
+        }
+        if (dinfo.scale_denom > 1) {
+          printf(" decoded at 1/%u\n", dinfo.scale_denom);
+        }
+        if (orientation != 1) {
+          printf(" EXIF orientation %u\n", orientation);
+        }
+      }
+
+      if (iccP != NULL && jpeg_comps == 3) {
+        lut = iccLut(iccP, icclen, inVerbose);
       }
 
       rgiP->gamma = 2.2; /* check for this ? */
@@ -106,6 +455,10 @@ JSAMPARRAY buffer = NULL;
 
       while (dinfo.output_scanline < dinfo.output_height) {
 
+        if (blockP != NULL) {
+          blkrowP[nblk] = blockP + nblk * rowbytes;
+          gP = blkrowP[nblk];
+        }
         jpeg_read_scanlines(&dinfo, buffer, 1);
         rowP = buffer[0];
         if (jpeg_comps == 3) {
@@ -121,12 +474,29 @@ JSAMPARRAY buffer = NULL;
             *gP++ = *rowP;
             rowP++;
           } 
+        } else if (blockP != NULL) {
+          memset(gP, 0, rowbytes);
+        }
+        if (lut != NULL) {
+          iccApply8(lut, gP - rowbytes, jpeg_w);
+        }
+
+        if (blockP != NULL) {
+          nblk++;
+          if (nblk == ORIENT_ROWS || dinfo.output_scanline == dinfo.output_height) {
+            orientPutRows(rgiP, orientation, jpeg_w, jpeg_h,
+              dinfo.output_scanline - nblk, nblk, blkrowP);
+            nblk = 0;
+          }
         }
       }
 
     }
     jpeg_finish_decompress(&dinfo);
     jpeg_destroy_decompress(&dinfo);
+    free(blockP);
+    free(iccP);
+    free(thumbP);
 
     fclose(fP);
 
@@ -135,3 +505,133 @@ JSAMPARRAY buffer = NULL;
   return(rgiP);
 }
 
+
+
+/* PUBLIC FUNCTIONS */
+
+/**************/
+/* jpegLoad() */
+/**************/
+gImage*
+jpegLoad(
+ const char *inFilepath,
+ unsigned int inVerbose)
+{
+  return(jpegDecode(inFilepath, 0, inVerbose));
+}
+
+
+/********************/
+/* jpegLoadScaled() */
+/********************/
+gImage*
+jpegLoadScaled(
+ const char *inFilepath,
+ unsigned int inMaxdim,
+ unsigned int inVerbose)
+{
+  return(jpegDecode(inFilepath, inMaxdim, inVerbose));
+}
+
+
+/***************/
+/* jpegWrite() */
+/***************/
+/* libJPEG errors exit, as when loading */
+int
+jpegWrite(
+ gImage *ingimageP,
+ const char *inFilepath)
+{
+FILE *fP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *outP = NULL;
+unsigned char *rowP = NULL;
+uint16_t *u16P = NULL;
+size_t i;
+unsigned int x;
+int status = 0;
+/* JPEG specific */
+struct jpeg_error_mgr jerr;
+struct jpeg_compress_struct cinfo;
+JSAMPROW row[1];
+
+  if (!BITMAPP(ingimageP) && !RGB24P(ingimageP) && !RGB48P(ingimageP)) {
+    fprintf(stderr, "JPEG write: invalid image type\n");
+    status = (-1);
+  }
+
+  if (status == 0) {
+    scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+    outP = malloc(imageRowBytes(IRGB24, ingimageP->width));
+    if (scratchP == NULL || outP == NULL) {
+      fprintf(stderr, "JPEG write: malloc error\n");
+      status = (-1);
+    }
+  }
+
+  if (status == 0) {
+    fP = fopen(inFilepath, "wb");
+    if (fP == NULL) {
+      perror(inFilepath);
+      status = (-1);
+    }
+  }
+
+  if (status == 0) {
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, fP);
+    cinfo.image_width = ingimageP->width;
+    cinfo.image_height = ingimageP->height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    row[0] = outP;
+    while (status == 0 && cinfo.next_scanline < cinfo.image_height) {
+      rowP = imageRowP(ingimageP, 0, cinfo.next_scanline, ingimageP->width,
+        scratchP);
+      if (rowP == NULL) {
+        fprintf(stderr, "%s: row %u unreadable\n", inFilepath,
+          cinfo.next_scanline);
+        status = (-1);
+        break;
+      }
+      if (BITMAPP(ingimageP)) {
+        /* set bits are black */
+        for (x = 0; x < ingimageP->width; x++) {
+          outP[x * 3] = (rowP[x / 8] & (0x01 << (x % 8)) ? 0 : 255);
+          outP[x * 3 + 1] = outP[x * 3];
+          outP[x * 3 + 2] = outP[x * 3];
+        }
+      } else if (RGB48P(ingimageP)) {
+        u16P = (uint16_t *)rowP;
+        for (i = 0; i < (size_t)ingimageP->width * 3; i++) {
+          outP[i] = u16P[i] / 256;
+        }
+      } else {
+        memcpy(outP, rowP, imageRowBytes(IRGB24, ingimageP->width));
+      }
+      jpeg_write_scanlines(&cinfo, row, 1);
+    }
+
+    if (status == 0) {
+      jpeg_finish_compress(&cinfo);
+    } else {
+      jpeg_abort_compress(&cinfo);
+    }
+    jpeg_destroy_compress(&cinfo);
+    if (fclose(fP) != 0 && status == 0) {
+      perror(inFilepath);
+      status = (-1);
+    }
+  }
+  free(scratchP);
+  free(outP);
+
+  return(status);
+}
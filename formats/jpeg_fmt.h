@@ -20,6 +20,9 @@
 
 #include "../gimage.h" /* 'gImage' struct */
 
+/* quality of written JPEGs, 0 to 100 */
+#define JPEG_QUALITY (90)
+
 
 /** jpegload
  * @ingroup jpeg
@@ -32,5 +35,30 @@
 gImage* jpegLoad(const char *filename, unsigned int verbose);
 
 
+/** jpegLoadScaled
+ * @ingroup jpeg
+ * @param[in] filename filename
+ * @param[in] maxdim size wanted, in pixels, of the longer side
+ * @param[in] verbose flag for verbose output
+ * @return gImage, NULL if not a JPEG
+ *
+ * the EXIF thumbnail, if it is at least maxdim on the longer side
+ * and the shape of the image, else decoded with DCT scaling, at
+ * 1/2, 1/4 or 1/8 size, the smallest still at least maxdim
+ */
+gImage* jpegLoadScaled(const char *filename, unsigned int maxdim, unsigned int verbose);
+
+
+/** jpegWrite
+ * @ingroup jpeg
+ * @param[in] gimageP IBITMAP, IRGB24 or IRGB48
+ * @param[in] filename filename
+ * @return 0, or -1 if error
+ *
+ * write a gImage as an 8 bit RGB JPEG, quality JPEG_QUALITY
+ */
+int jpegWrite(gImage *gimageP, const char *filename);
+
+
 #endif
 
@@ -8,10 +8,16 @@
 /* xopenimage project under the "ISC license" */
 /*  see LICENSE.txt */ 
 
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
 /* C standard library */
 #include <stdlib.h>
 #include <stdio.h>  /* printf, fprintf, fopen, fclose, fread, fgetc */
-#include <string.h> /* strncpy */
+#include <string.h> /* strncpy, memcpy, memset */
+#include <stdint.h> /* uint16_t */
+
+/* POSIX */
+#include <pthread.h> /* pthread_once */
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
@@ -40,7 +46,8 @@
 #define PPMRAWBITS (7) /* ppm raw bits type file */
 
 /* Internal (static) memory allocations */
-static int Initialized = 0;
+/*  IntTable is built once, images may be loaded from several threads */
+static pthread_once_t Initialized = PTHREAD_ONCE_INIT;
 static int IntTable[256];
 
 /* Internal (static) non-public functions */
@@ -73,8 +80,6 @@ int i = 0;
   IntTable['7'] = 7;
   IntTable['8'] = 8;
   IntTable['9'] = 9;
-
-  Initialized = (-1);
 }
 
 /*****************/
@@ -158,9 +163,7 @@ int w;
 int h;
 int max;
 
-  if (Initialized == 0) {
-    initializeTable();
-  }
+  pthread_once(&Initialized, initializeTable);
 
   if (fread(buf, 1, 2, inFileP) != 2) {
     return(NOTPBM);
@@ -322,7 +325,7 @@ unsigned int height;
 unsigned int maxval;
 unsigned int linelen;
 unsigned int x;
-unsigned int y;
+size_t y;
 size_t size;
 
   fileP = fopen(inFilepath, "r");
@@ -341,6 +344,10 @@ size_t size;
      case PBMNORMAL:
       /* P1, bitmap, ASCII */
       gimageP = newBitImage(width, height);
+      if (gimageP == NULL) {
+        fclose(fileP);
+        return (NULL);
+      }
       linelen = (width + 7) / 8;
       /* assumes gimageP->data has been zero'd, calloc() */
       dstlineP = gimageP->data;
@@ -395,6 +402,10 @@ size_t size;
       /* src will go from 0x80 down to 0x01 */
       /* dst will go from 0x01 up to 0x80 */
       gimageP = newBitImage(width, height);
+      if (gimageP == NULL) {
+        fclose(fileP);
+        return (NULL);
+      }
       dstlineP = gimageP->data;
       linelen = (width + 7) / 8;
       srcmask = 0;
@@ -433,9 +444,13 @@ size_t size;
         return (NULL);
       }
       gimageP = newRGB24Image(width, height);
+      if (gimageP == NULL) {
+        fclose(fileP);
+        return (NULL);
+      }
       gimageP->gamma = 2.2;
       dstP = gimageP->data;
-      size = height * width;
+      size = (size_t)height * width;
       for (y = 0; y < size; y++) {
         src = pbmReadInt(fileP);
         if (src < 0) {
@@ -455,15 +470,20 @@ size_t size;
      case PGMRAWBITS:
       /* P5, grayscale, binary */
       /*  maxval 255 or 65535 only */
+      /*  short image is freed, so zero fill not needed */
       if (maxval == 0) {
         fprintf(stderr, "NetPBM, maxval 0, trying to divide by zero\n");
         fclose(fileP);
         return (NULL);
       } else if (maxval == 255) {
-        gimageP = newRGB24Image(width, height);
+        gimageP = newRGB24ImageUninit(width, height);
+        if (gimageP == NULL) {
+          fclose(fileP);
+          return (NULL);
+        }
         gimageP->gamma = 2.2;
         dstP = gimageP->data;
-        size = height * width;
+        size = (size_t)height * width;
         for (y = 0; y < size; y++) {
           src = fgetc(fileP);
           if (src == EOF) {
@@ -477,9 +497,13 @@ size_t size;
           *(dstP++) = src; /* blue */
         }
       } else if (maxval == 65535) {
-        gimageP = newRGB48Image(width, height);
+        gimageP = newRGB48ImageUninit(width, height);
+        if (gimageP == NULL) {
+          fclose(fileP);
+          return (NULL);
+        }
         dstP = gimageP->data;
-        size = height * width;
+        size = (size_t)height * width;
         for (y = 0; y < size; y++) {
           bhi = fgetc(fileP);
           blo = fgetc(fileP);
@@ -509,9 +533,13 @@ size_t size;
         return (NULL);
       }
       gimageP = newRGB24Image(width, height);
+      if (gimageP == NULL) {
+        fclose(fileP);
+        return (NULL);
+      }
       gimageP->gamma = 2.2;
       dstP = gimageP->data;
-      size = height * width;
+      size = (size_t)height * width;
       for (y = 0; y < size; y++) {
         if (((red = pbmReadInt(fileP)) == EOF) ||
             ((grn = pbmReadInt(fileP)) == EOF) ||
@@ -530,14 +558,19 @@ size_t size;
 
      case PPMRAWBITS:
       /* P6, color RGB, binary */
+      /*  short image is freed, so zero fill not needed */
       if (maxval == 0) {
         fprintf(stderr, "NetPBM, maxval 0, trying to divide by zero\n");
         fclose(fileP);
         return (NULL);
       } else if (maxval == 255) {
-        gimageP = newRGB24Image(width, height);
+        gimageP = newRGB24ImageUninit(width, height);
+        if (gimageP == NULL) {
+          fclose(fileP);
+          return (NULL);
+        }
         gimageP->gamma = 2.2;
-        size = height * width * 3;
+        size = (size_t)height * width * 3;
         if (fread(gimageP->data, 1, size, fileP) != size) {
           fprintf(stderr, "%s: Short image\n", inFilepath);
           fclose(fileP);
@@ -545,9 +578,13 @@ size_t size;
           return (NULL);
         }
       } else if (maxval == 65535) {
-        gimageP = newRGB48Image(width, height);
+        gimageP = newRGB48ImageUninit(width, height);
+        if (gimageP == NULL) {
+          fclose(fileP);
+          return (NULL);
+        }
         gimageP->gamma = 2.2;
-        size = height * width * 3 * 2;
+        size = (size_t)height * width * 3 * 2;
         if (fread(gimageP->data, 1, size, fileP) != size) {
           fprintf(stderr, "%s: Short image\n", inFilepath);
           fclose(fileP);
@@ -575,3 +612,96 @@ size_t size;
   return (gimageP);
 }
 
+
+
+/**************/
+/* pbmWrite() */
+/**************/
+int
+pbmWrite(
+ gImage *ingimageP,
+ const char *inFilepath)
+{
+FILE *fileP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *outP = NULL;
+unsigned char *rowP = NULL;
+uint16_t *u16P = NULL;
+size_t rowbytes = 0;
+size_t outbytes = 0;
+size_t i;
+unsigned int x;
+unsigned int y;
+int status = 0;
+
+  if (BITMAPP(ingimageP)) {
+    outbytes = (ingimageP->width + 7) / 8;
+  } else if (RGB24P(ingimageP) || RGB48P(ingimageP)) {
+    outbytes = imageRowBytes(ingimageP->gitype, ingimageP->width);
+  } else {
+    fprintf(stderr, "NetPBM write: invalid image type\n");
+    status = (-1);
+  }
+
+  if (status == 0) {
+    rowbytes = imageRowBytes(ingimageP->gitype, ingimageP->width);
+    scratchP = malloc(rowbytes);
+    outP = malloc(outbytes);
+    fileP = fopen(inFilepath, "wb");
+    if (scratchP == NULL || outP == NULL) {
+      fprintf(stderr, "NetPBM write: malloc error\n");
+      status = (-1);
+    } else if (fileP == NULL) {
+      perror(inFilepath);
+      status = (-1);
+    }
+  }
+
+  if (status == 0) {
+    if (BITMAPP(ingimageP)) {
+      fprintf(fileP, "P4\n%u %u\n", ingimageP->width, ingimageP->height);
+    } else {
+      fprintf(fileP, "P6\n%u %u\n%u\n", ingimageP->width, ingimageP->height,
+        (RGB24P(ingimageP) ? 255 : 65535));
+    }
+    for (y = 0; status == 0 && y < ingimageP->height; y++) {
+      rowP = imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+      if (rowP == NULL) {
+        fprintf(stderr, "%s: row %u unreadable\n", inFilepath, y);
+        status = (-1);
+        break;
+      }
+      if (BITMAPP(ingimageP)) {
+        /* gImage is LSB first, NetPBM left-to-right from most sig bit */
+        memset(outP, 0, outbytes);
+        for (x = 0; x < ingimageP->width; x++) {
+          if (rowP[x / 8] & (0x01 << (x % 8))) {
+            outP[x / 8] |= 0x80 >> (x % 8);
+          }
+        }
+      } else if (RGB24P(ingimageP)) {
+        memcpy(outP, rowP, outbytes);
+      } else {
+        /* NetPBM file format is big-endian */
+        u16P = (uint16_t *)rowP;
+        for (i = 0; i < outbytes / 2; i++) {
+          outP[i * 2] = u16P[i] >> 8;
+          outP[i * 2 + 1] = u16P[i] & 0xff;
+        }
+      }
+      if (fwrite(outP, 1, outbytes, fileP) != outbytes) {
+        perror(inFilepath);
+        status = (-1);
+      }
+    }
+  }
+
+  if (fileP != NULL && fclose(fileP) != 0 && status == 0) {
+    perror(inFilepath);
+    status = (-1);
+  }
+  free(scratchP);
+  free(outP);
+
+  return(status);
+}
@@ -32,5 +32,17 @@
 gImage* pbmLoad(const char *filename, unsigned int verbose);
 
 
+/** pbmWrite
+ * @ingroup netpbm
+ * @param[in] gimageP IBITMAP, IRGB24 or IRGB48
+ * @param[in] filename filename
+ * @return 0, or -1 if error
+ *
+ * write a gImage as a raw NetPBM file: P4 for bitmaps, P6 with
+ * maxval 255 or 65535 for color
+ */
+int pbmWrite(gImage *gimageP, const char *filename);
+
+
 #endif
 
@@ -53,7 +53,7 @@ multiple samples of a single pixel are never packed into one byte. All
 /* System */
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>  /* strncpy */
+#include <string.h>  /* strncpy, memcpy */
 #include <stdint.h>  /* for uint16_t */
 
 /* libPNG   www.libPNG.org */
@@ -63,6 +63,7 @@ multiple samples of a single pixel are never packed into one byte. All
 
 /* code base */
 #include "../gimage.h"  /* 'gImage' struct */
+#include "../transforms/icc.h" /* iccLut, iccConvertImage */
 
 #include "png_fmt.h" /* enforce declarations */
 
@@ -144,7 +145,8 @@ png_byte *p_byteP = NULL;
     png_read_image(in_p_imgP, row_pointers);
 
     /* copy the image from PNG to gImage */
-    rgiP = newBitImage(p_w, p_h);
+    /*  every row is copied, so zero fill not needed */
+    rgiP = newBitImageUninit(p_w, p_h);
     if (rgiP == NULL) {
       fprintf(stderr, "PNG error newBitImage\n");
       status = (-1);
@@ -177,6 +179,65 @@ png_byte *p_byteP = NULL;
 }
 
 
+/*************/
+/* pngRows() */
+/*************/
+/* read a non-interlaced PNG a row at a time into a new gImage */
+/*  conversions must already be set up and rowbytes computed after them */
+/*  gImage may be tiled if large, see newLargeImage() */
+static gImage*
+pngRows(
+ png_structp in_p_imgP,
+ unsigned int inType,
+ int in_p_w,
+ int in_p_h,
+ int in_p_rowbytes)
+{
+gImage *rgiP = NULL;
+png_byte *p_rowP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *gP = NULL;
+uint16_t *u16P = NULL;
+int y;
+int x;
+
+  rgiP = newLargeImage(inType, in_p_w, in_p_h);
+  p_rowP = malloc(in_p_rowbytes);
+  scratchP = malloc(imageRowBytes(inType, in_p_w));
+  if (rgiP == NULL || p_rowP == NULL || scratchP == NULL) {
+    fprintf(stderr, "PNG error malloc\n");
+    freeImage(rgiP);
+    rgiP = NULL;
+  } else {
+    for (y = 0; y < in_p_h; y++) {
+      /* tiled rows are built in scratch, then stored */
+      if (TILEDP(rgiP)) {
+        gP = scratchP;
+      } else {
+        gP = imageRowP(rgiP, 0, y, in_p_w, scratchP);
+      }
+      if (inType == IRGB24) {
+        /* RGB24 rows are the same bytes as libPNG's */
+        png_read_row(in_p_imgP, gP, NULL);
+      } else {
+        png_read_row(in_p_imgP, p_rowP, NULL);
+        u16P = (uint16_t*) gP;
+        for (x = 0; x < in_p_rowbytes; x += 2) {
+          /* PNG big-endian to native 16bit */
+          *u16P++ = p_rowP[x] * 256 + p_rowP[x+1];
+        }
+      }
+      imagePutRow(rgiP, y, gP);
+    }
+  }
+
+  free(p_rowP);
+  free(scratchP);
+
+  return(rgiP);
+}
+
+
 /**************/
 /* pngRGB24() */
 /**************/
@@ -194,6 +255,7 @@ int p_depth;
 int p_h;
 int p_w;
 int p_rowbytes;
+int p_passes;
 int y;
 int x;
 unsigned char *gP = NULL;
@@ -221,6 +283,9 @@ png_byte *p_byteP = NULL;
     png_set_gray_to_rgb(in_p_imgP);
   }
 
+  /* 1 if not interlaced */
+  p_passes = png_set_interlace_handling(in_p_imgP);
+
   png_read_update_info(in_p_imgP, in_p_infoP);
 
   p_h = png_get_image_height(in_p_imgP, in_p_infoP);
@@ -229,69 +294,85 @@ png_byte *p_byteP = NULL;
   /* note well: get rowbytes after setting all conversions */
   p_rowbytes = png_get_rowbytes(in_p_imgP, in_p_infoP);
 
-  /* malloc for libPNG to read into */
-  row_pointers = malloc(sizeof(png_bytep) * p_h);
-  if (row_pointers == NULL) {
-    fprintf(stderr, "PNG error malloc\n");
-    status = (-1);
-  } else {
-    for (y = 0; y < p_h; y++) {
-      row_pointers[y] = malloc(p_rowbytes);
-      if (row_pointers[y] == NULL) {
-        fprintf(stderr, "PNG error malloc\n");
-        status = (-1);
-        break;
-      }
+  if (p_passes == 1) {
+    /* not interlaced, a row at a time straight into the gImage */
+    rgiP = pngRows(in_p_imgP, IRGB24, p_w, p_h, p_rowbytes);
+    if (rgiP == NULL) {
+      status = (-1);
     }
-  }
-
-  if (status == 0) {
 
-    /* read the PNG */
-    png_read_image(in_p_imgP, row_pointers);
+  } else {
+    /* interlaced, every pass needs every row, so read it all */
 
-    /* copy the image from PNG to gImage */
-    rgiP = newRGB24Image(p_w, p_h);
-    if (rgiP == NULL) {
-      fprintf(stderr, "PNG error newRGB24Image\n");
+    /* malloc for libPNG to read into */
+    row_pointers = malloc(sizeof(png_bytep) * p_h);
+    if (row_pointers == NULL) {
+      fprintf(stderr, "PNG error malloc\n");
       status = (-1);
     } else {
+      for (y = 0; y < p_h; y++) {
+        row_pointers[y] = malloc(p_rowbytes);
+        if (row_pointers[y] == NULL) {
+          fprintf(stderr, "PNG error malloc\n");
+          status = (-1);
+          break;
+        }
+      }
+    }
 
-      rgiP->gamma = 2.2; /* check for this ? */
+    if (status == 0) {
 
-      printf("%s, ", inFilepath);
-      if (inVerbose) {
-        switch(p_type) {
-         case 0:
-          printf("PNG grayscale"); break;
-         case 2:
-          printf("PNG RGB"); break;
-         case 3:
-          printf("PNG palette"); break;
-         case 4:
-          printf("PNG gray+alpha"); break;
-         case 6:
-          printf("PNG RGB+alpha"); break;
+      /* read the PNG */
+      png_read_image(in_p_imgP, row_pointers);
+
+      /* copy the image from PNG to gImage */
+      /*  every row is copied, so zero fill not needed */
+      rgiP = newRGB24ImageUninit(p_w, p_h);
+      if (rgiP == NULL) {
+        fprintf(stderr, "PNG error newRGB24Image\n");
+        status = (-1);
+      } else {
+        gP = rgiP->data;
+        for (y = 0; y < p_h; y++) {
+          p_byteP = row_pointers[y];
+          for (x = 0; x < p_rowbytes; x++) {
+            *gP++ = *p_byteP++;
+          }
         }
-        printf(", depth %d, size: %d x %d\n", p_depth, p_w, p_h);
       }
 
-      gP = rgiP->data;
       for (y = 0; y < p_h; y++) {
-        p_byteP = row_pointers[y];
-        for (x = 0; x < p_rowbytes; x++) {
-          *gP++ = *p_byteP++;
-        }
+        free(row_pointers[y]);
       }
+      free(row_pointers);
     }
+  }
 
-    /* cleanup */
-    png_read_end(in_p_imgP, in_p_infoP);
-    for (y = 0; y < p_h; y++) {
-      free(row_pointers[y]);
+  if (rgiP != NULL) {
+
+    rgiP->gamma = 2.2; /* check for this ? */
+
+    printf("%s, ", inFilepath);
+    if (inVerbose) {
+      switch(p_type) {
+       case 0:
+        printf("PNG grayscale"); break;
+       case 2:
+        printf("PNG RGB"); break;
+       case 3:
+        printf("PNG palette"); break;
+       case 4:
+        printf("PNG gray+alpha"); break;
+       case 6:
+        printf("PNG RGB+alpha"); break;
+      }
+      printf(", depth %d, size: %d x %d\n", p_depth, p_w, p_h);
     }
-    free(row_pointers);
+  }
 
+  if (status == 0) {
+    /* cleanup */
+    png_read_end(in_p_imgP, in_p_infoP);
   }
 
   return(rgiP);
@@ -315,6 +396,7 @@ int p_depth;
 int p_h;
 int p_w;
 int p_rowbytes;
+int p_passes;
 int y;
 int x;
 uint16_t *gP = NULL;
@@ -338,6 +420,9 @@ png_byte *pRGB16 = NULL;
     png_set_gray_to_rgb(in_p_imgP);
   }
 
+  /* 1 if not interlaced */
+  p_passes = png_set_interlace_handling(in_p_imgP);
+
   png_read_update_info(in_p_imgP, in_p_infoP);
 
   p_h = png_get_image_height(in_p_imgP, in_p_infoP);
@@ -346,68 +431,84 @@ png_byte *pRGB16 = NULL;
   /* note well: get rowbytes after setting all conversions */
   p_rowbytes = png_get_rowbytes(in_p_imgP, in_p_infoP);
 
-  /* malloc for libPNG to read into */
-  row_pointers = malloc(sizeof(png_bytep) * p_h);
-  if (row_pointers == NULL) {
-    fprintf(stderr, "PNG error malloc\n");
-    status = (-1);
-  } else {
-    for (y = 0; y < p_h; y++) {
-      row_pointers[y] = malloc(p_rowbytes);
-      if (row_pointers[y] == NULL) {
-        fprintf(stderr, "PNG error malloc\n");
-        status = (-1);
-        break;
-      }
+  if (p_passes == 1) {
+    /* not interlaced, a row at a time straight into the gImage */
+    rgiP = pngRows(in_p_imgP, IRGB48, p_w, p_h, p_rowbytes);
+    if (rgiP == NULL) {
+      status = (-1);
     }
-  }
 
-  if (status == 0) {
-
-    /* read the PNG */
-    png_read_image(in_p_imgP, row_pointers);
+  } else {
+    /* interlaced, every pass needs every row, so read it all */
 
-    /* copy the image from PNG to gImage */
-    rgiP = newRGB48Image(p_w, p_h);
-    if (rgiP == NULL) {
-      fprintf(stderr, "PNG error newRGB48Image\n");
+    /* malloc for libPNG to read into */
+    row_pointers = malloc(sizeof(png_bytep) * p_h);
+    if (row_pointers == NULL) {
+      fprintf(stderr, "PNG error malloc\n");
       status = (-1);
     } else {
+      for (y = 0; y < p_h; y++) {
+        row_pointers[y] = malloc(p_rowbytes);
+        if (row_pointers[y] == NULL) {
+          fprintf(stderr, "PNG error malloc\n");
+          status = (-1);
+          break;
+        }
+      }
+    }
 
-      rgiP->gamma = 2.2; /* check for this ? */
+    if (status == 0) {
 
-      printf("%s, ", inFilepath);
-      if (inVerbose) {
-        switch(p_type) {
-         case 0:
-          printf("PNG grayscale"); break;
-         case 2:
-          printf("PNG RGB"); break;
-         case 4:
-          printf("PNG gray+alpha"); break;
-         case 6:
-          printf("PNG RGB+alpha"); break;
+      /* read the PNG */
+      png_read_image(in_p_imgP, row_pointers);
+
+      /* copy the image from PNG to gImage */
+      /*  every row is copied, so zero fill not needed */
+      rgiP = newRGB48ImageUninit(p_w, p_h);
+      if (rgiP == NULL) {
+        fprintf(stderr, "PNG error newRGB48Image\n");
+        status = (-1);
+      } else {
+        gP = (uint16_t*) rgiP->data;
+        for (y = 0; y < p_h; y++) {
+          pRGB16 = row_pointers[y];
+          for (x = 0; x < p_rowbytes; x += 2) {
+            /* PNG big-endian to native 16bit */
+            *gP++ = pRGB16[x] * 256 + pRGB16[x+1];
+          }
         }
-        printf(", depth %d, size: %d x %d\n", p_depth, p_w, p_h);
       }
 
-      gP = (uint16_t*) rgiP->data;
       for (y = 0; y < p_h; y++) {
-        pRGB16 = row_pointers[y];
-        for (x = 0; x < p_rowbytes; x += 2) {
-          /* PNG big-endian to native 16bit */
-          *gP++ = pRGB16[x] * 256 + pRGB16[x+1];
-        }
+        free(row_pointers[y]);
       }
+      free(row_pointers);
     }
+  }
 
-    /* cleanup */
-    png_read_end(in_p_imgP, in_p_infoP);
-    for (y = 0; y < p_h; y++) {
-      free(row_pointers[y]);
+  if (rgiP != NULL) {
+
+    rgiP->gamma = 2.2; /* check for this ? */
+
+    printf("%s, ", inFilepath);
+    if (inVerbose) {
+      switch(p_type) {
+       case 0:
+        printf("PNG grayscale"); break;
+       case 2:
+        printf("PNG RGB"); break;
+       case 4:
+        printf("PNG gray+alpha"); break;
+       case 6:
+        printf("PNG RGB+alpha"); break;
+      }
+      printf(", depth %d, size: %d x %d\n", p_depth, p_w, p_h);
     }
-    free(row_pointers);
+  }
 
+  if (status == 0) {
+    /* cleanup */
+    png_read_end(in_p_imgP, in_p_infoP);
   }
 
   return(rgiP);
@@ -435,6 +536,10 @@ int p_ret;
 /* libPNG types */
 png_structp  p_imgP = NULL;
 png_infop    p_infoP = NULL;
+png_charp    p_iccname = NULL;
+png_bytep    p_iccP = NULL;
+png_uint_32  p_icclen = 0;
+int          p_icccomp = 0;
 
   /* largely following the recommended sequence of libPNG example.c */
 
@@ -519,6 +624,12 @@ png_infop    p_infoP = NULL;
       rgiP->title[255] = '\0';
     }
 
+    /* embedded ICC profile, converted to sRGB */
+    if (rgiP != NULL && !BITMAPP(rgiP) &&
+        png_get_iCCP(p_imgP, p_infoP, &p_iccname, &p_icccomp, &p_iccP, &p_icclen) != 0) {
+      iccConvertImage(rgiP, iccLut(p_iccP, p_icclen, inVerbose));
+    }
+
   }
 
   /* if p_imgP or p_infoP are NULL, this shouldn't be problem */
@@ -534,3 +645,141 @@ png_infop    p_infoP = NULL;
   return(rgiP);
 }
 
+
+
+/*******************/
+/* pngWriteImage() */
+/*******************/
+/* everything that may longjmp, apart from pngWrite()'s locals */
+/*  none of this function's variables is used after a longjmp */
+/*  returns 0, or -1 if libPNG reported an error */
+static int
+pngWriteImage(
+ png_structp in_p_imgP,
+ png_infop in_p_infoP,
+ FILE *inFP,
+ gImage *ingimageP,
+ int in_p_depth,
+ int in_p_type,
+ unsigned char *scratchP,
+ unsigned char *outP,
+ size_t inOutbytes)
+{
+unsigned char *rowP = NULL;
+uint16_t *u16P = NULL;
+size_t i;
+unsigned int y;
+
+  if (setjmp(png_jmpbuf(in_p_imgP)) != 0) {
+    /* libPNG has reported the error */
+    return(-1);
+  }
+
+  png_init_io(in_p_imgP, inFP);
+  png_set_IHDR(in_p_imgP, in_p_infoP, ingimageP->width, ingimageP->height,
+    in_p_depth, in_p_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+    PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(in_p_imgP, in_p_infoP);
+
+  for (y = 0; y < ingimageP->height; y++) {
+    rowP = imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+    if (rowP == NULL) {
+      /* does not return */
+      png_error(in_p_imgP, "source row unreadable");
+    }
+    if (BITMAPP(ingimageP)) {
+      for (i = 0; i < inOutbytes; i++) {
+        /* PNG bitmap: left is most-sig-bit, reverse, and complement */
+        outP[i] = comprev[rowP[i]];
+      }
+    } else if (RGB48P(ingimageP)) {
+      u16P = (uint16_t *)rowP;
+      for (i = 0; i < inOutbytes / 2; i++) {
+        /* native 16bit to PNG big-endian */
+        outP[i * 2] = u16P[i] >> 8;
+        outP[i * 2 + 1] = u16P[i] & 0xff;
+      }
+    } else {
+      memcpy(outP, rowP, inOutbytes);
+    }
+    png_write_row(in_p_imgP, outP);
+  }
+  png_write_end(in_p_imgP, in_p_infoP);
+
+  return(0);
+}
+
+
+/**************/
+/* pngWrite() */
+/**************/
+int
+pngWrite(
+ gImage *ingimageP,
+ const char *inFilepath)
+{
+FILE *fP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *outP = NULL;
+size_t outbytes = 0;
+int status = 0;
+int p_depth = 8;
+int p_type = PNG_COLOR_TYPE_RGB;
+/* libPNG types */
+png_structp p_imgP = NULL;
+png_infop p_infoP = NULL;
+
+  if (BITMAPP(ingimageP)) {
+    p_depth = 1;
+    p_type = PNG_COLOR_TYPE_GRAY;
+  } else if (RGB48P(ingimageP)) {
+    p_depth = 16;
+  } else if (!RGB24P(ingimageP)) {
+    fprintf(stderr, "PNG write: invalid image type\n");
+    status = (-1);
+  }
+
+  if (status == 0) {
+    outbytes = imageRowBytes(ingimageP->gitype, ingimageP->width);
+    scratchP = malloc(outbytes);
+    outP = malloc(outbytes);
+    if (scratchP == NULL || outP == NULL) {
+      fprintf(stderr, "PNG write: malloc error\n");
+      status = (-1);
+    }
+  }
+
+  if (status == 0) {
+    fP = fopen(inFilepath, "wb");
+    if (fP == NULL) {
+      perror(inFilepath);
+      status = (-1);
+    }
+  }
+
+  if (status == 0) {
+    p_imgP = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (p_imgP != NULL) {
+      p_infoP = png_create_info_struct(p_imgP);
+    }
+    if (p_infoP == NULL) {
+      fprintf(stderr, "PNG error create write struct\n");
+      status = (-1);
+    }
+  }
+
+  if (status == 0) {
+    status = pngWriteImage(p_imgP, p_infoP, fP, ingimageP, p_depth, p_type,
+      scratchP, outP, outbytes);
+  }
+
+  png_destroy_write_struct(&p_imgP, &p_infoP);
+  if (fP != NULL && fclose(fP) != 0 && status == 0) {
+    perror(inFilepath);
+    status = (-1);
+  }
+  free(scratchP);
+  free(outP);
+
+  return(status);
+}
@@ -32,5 +32,16 @@
 gImage* pngLoad(const char *filename, unsigned int verbose);
 
 
+/** pngWrite
+ * @ingroup png
+ * @param[in] gimageP IBITMAP, IRGB24 or IRGB48
+ * @param[in] filename filename
+ * @return 0, or -1 if error
+ *
+ * write a gImage as PNG: 1 bit gray for bitmaps, 8 or 16 bit RGB
+ */
+int pngWrite(gImage *gimageP, const char *filename);
+
+
 #endif
 
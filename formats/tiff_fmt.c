@@ -11,7 +11,8 @@
 /* C System */
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>  /* strncpy */
+#include <string.h>  /* strncpy, memset */
+#include <stdint.h>  /* SIZE_MAX */
 
 /* TIFF */
 #include "tiff.h"
@@ -20,10 +21,22 @@
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
+#include "../transforms/rotate.h" /* orient, orientPutRows */
+#include "../transforms/icc.h" /* iccLut, iccApply8, iccApply16 */
 
 #include "tiff_fmt.h"  /* enforce declarations */
 
 
+/* internal structures */
+
+/* open TIFF and raster for reading tiles on demand */
+struct tifftile_struct {
+ TIFF     *tiffP;
+ uint32_t *rasterP;  /* one TIFF tile of RGBA */
+ icclut    lut;      /* embedded profile, tiles are converted to sRGB */
+};
+
+
 /* internal static variables */
 
 /* bitwise reverse lookup table */
@@ -84,6 +97,27 @@ size_t nread;
   return(valid);
 }
 
+/*************/
+/* tiffICC() */
+/*************/
+/* sRGB transform of the embedded ICC profile, NULL if none needed */
+static icclut
+tiffICC(
+ TIFF *inTiffP,
+ unsigned int inVerbose)
+{
+icclut lut = NULL;
+uint32_t icclen = 0;
+void *iccP = NULL;
+
+  if (TIFFGetField(inTiffP, TIFFTAG_ICCPROFILE, &icclen, &iccP) != 0 &&
+      iccP != NULL) {
+    lut = iccLut(iccP, icclen, inVerbose);
+  }
+  return(lut);
+}
+
+
 /****************/
 /* tiffBitmap() */
 /****************/
@@ -103,10 +137,11 @@ int tstatus = 0;
 int tiff_w;
 int tiff_h;
 unsigned short tiff_photometric;
-unsigned short scanlinesize;
+size_t scanlinesize;
+size_t rowbytes;
 unsigned char *scanlineP = NULL;
 int iy;
-int i;
+size_t i;
 gImage *rgiP = NULL;
 unsigned char *gP = NULL;
 
@@ -118,11 +153,13 @@ unsigned char *gP = NULL;
       fprintf(stderr, "TIFF: width and height must be > 0\n");
     } else {
       scanlinesize = TIFFScanlineSize(inTiffP);
+      rowbytes = imageRowBytes(IBITMAP, tiff_w);
       scanlineP = malloc(scanlinesize);
       if (scanlineP == NULL) {
         fprintf(stderr, "TIFF malloc error\n");
       } else {
-        rgiP = newBitImage(tiff_w, tiff_h);
+        /* every row is written below, zero fill not needed */
+        rgiP = newBitImageUninit(tiff_w, tiff_h);
         if (rgiP == NULL) {
           fprintf(stderr, "TIFF newBitmapImage fail\n");
         } else {
@@ -134,17 +171,23 @@ unsigned char *gP = NULL;
             tstatus = TIFFReadScanline(inTiffP, scanlineP, iy, 0);
             if (tstatus < 0) {
               fprintf(stderr, "TIFF premature end of data\n");
+              /* clear the rows that were not read */
+              memset(gP, 0, (size_t)(tiff_h - iy) * rowbytes);
               break;
             }
+            /* never write past the end of a gImage row */
             if (tiff_photometric == PHOTOMETRIC_MINISWHITE) {
-              for (i = 0; i < scanlinesize; i++) {
+              for (i = 0; i < scanlinesize && i < rowbytes; i++) {
                 *gP++ = reversed[scanlineP[i]];
               }
             } else {
-              for (i = 0; i < scanlinesize; i++) {
+              for (i = 0; i < scanlinesize && i < rowbytes; i++) {
                 *gP++ = ~reversed[scanlineP[i]];
               }
             }
+            for (; i < rowbytes; i++) {
+              *gP++ = 0;
+            }
           }
         }
         free(scanlineP);
@@ -156,6 +199,228 @@ unsigned char *gP = NULL;
 }
 
 
+/******************/
+/* tiffTileRead() */
+/******************/
+/* gImage tileread callback, gImage tiles are the TIFF tiles */
+/* TIFFReadRGBATile raster is bottom-up: tile row r is raster row dim-r-1 */
+static int
+tiffTileRead(
+ gImage *ingiP,
+ unsigned int inTx,
+ unsigned int inTy,
+ unsigned char *outTileP)
+{
+struct tifftile_struct *ttP = ingiP->tilectx;
+unsigned int dim;
+unsigned int r;
+unsigned int x;
+unsigned char *tP = NULL;
+unsigned char *gP = NULL;
+int status = 0;
+
+  dim = ingiP->tiledim;
+  if (TIFFReadRGBATile(ttP->tiffP, inTx * dim, inTy * dim, ttP->rasterP) == 0) {
+    status = -1;
+  } else {
+    gP = outTileP;
+    for (r = 0; r < dim; r++) {
+      tP = (unsigned char *)(ttP->rasterP + (size_t)(dim - r - 1) * dim);
+      for (x = 0; x < dim; x++) {
+        *gP++ = *tP++;  /* red */
+        *gP++ = *tP++;  /* green */
+        *gP++ = *tP++;  /* blue */
+        tP++;           /* alpha */
+      }
+    }
+    if (ttP->lut != NULL) {
+      iccApply8(ttP->lut, outTileP, (size_t)dim * dim);
+    }
+  }
+  return(status);
+}
+
+
+/*******************/
+/* tiffTileClose() */
+/*******************/
+/* gImage tileclose callback */
+static void
+tiffTileClose(
+ void *inCtxP)
+{
+struct tifftile_struct *ttP = inCtxP;
+
+  if (ttP != NULL) {
+    if (ttP->rasterP != NULL) _TIFFfree(ttP->rasterP);
+    if (ttP->tiffP != NULL) TIFFClose(ttP->tiffP);
+    free(ttP);
+  }
+}
+
+
+/*******************/
+/* tiffRGB24Lazy() */
+/*******************/
+/* TIFF with square tiles: gImage tiles match TIFF tiles */
+/*  and are decoded the first time they are looked at */
+/*  the tiles need their own TIFF handle, tiffLoad closes its one, */
+/*  set to the same directory as inTiffP */
+static gImage*
+tiffRGB24Lazy(
+ TIFF *inTiffP,
+ const char *inFilepath,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ unsigned int inTiledim,
+ icclut inLut)
+{
+gImage *rgiP = NULL;
+struct tifftile_struct *ttP = NULL;
+size_t ntiles;
+
+  ttP = calloc(1, sizeof(struct tifftile_struct));
+  if (ttP != NULL) {
+    ttP->tiffP = TIFFOpen(inFilepath, "r");
+    if (ttP->tiffP != NULL &&
+        TIFFSetDirectory(ttP->tiffP, TIFFCurrentDirectory(inTiffP)) == 0) {
+      TIFFClose(ttP->tiffP);
+      ttP->tiffP = NULL;
+    }
+    ttP->rasterP = _TIFFmalloc((size_t)inTiledim * inTiledim * sizeof(uint32_t));
+    ttP->lut = inLut;
+  }
+  if (ttP == NULL || ttP->tiffP == NULL || ttP->rasterP == NULL) {
+    fprintf(stderr, "TIFF tile reader setup error\n");
+  } else {
+    rgiP = newTiledImage(IRGB24, inWidth, inHeight, inTiledim);
+  }
+  if (rgiP != NULL) {
+    ntiles = (size_t)((inWidth - 1) / inTiledim + 1) *
+                     ((inHeight - 1) / inTiledim + 1);
+    rgiP->tilestate = calloc(ntiles, 1);
+    if (rgiP->tilestate == NULL) {
+      fprintf(stderr, "TIFF tile state malloc error\n");
+      freeImage(rgiP);
+      rgiP = NULL;
+    } else {
+      rgiP->tileread = tiffTileRead;
+      rgiP->tileclose = tiffTileClose;
+      rgiP->tilectx = ttP;
+    }
+  }
+  if (rgiP == NULL) {
+    tiffTileClose(ttP);
+  }
+  return(rgiP);
+}
+
+
+/*********************/
+/* tiffRGB24Strips() */
+/*********************/
+/* stripped TIFF too large for memory */
+/*  decode a strip at a time into a tiled gImage */
+/* TIFFReadRGBAStrip raster is bottom-up within the strip */
+static gImage*
+tiffRGB24Strips(
+ TIFF *inTiffP,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ icclut inLut)
+{
+gImage *rgiP = NULL;
+uint32_t *rasterP = NULL;
+unsigned char *rowP = NULL;
+unsigned char *gP = NULL;
+unsigned char *tP = NULL;
+uint32_t rowsperstrip = 0;
+unsigned int row;
+unsigned int nrows;
+unsigned int r;
+unsigned int x;
+
+  TIFFGetFieldDefaulted(inTiffP, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
+  if (rowsperstrip == 0 || rowsperstrip > inHeight) {
+    rowsperstrip = inHeight;
+  }
+
+  rasterP = _TIFFmalloc((size_t)inWidth * rowsperstrip * sizeof(uint32_t));
+  rowP = malloc(imageRowBytes(IRGB24, inWidth));
+  if (rasterP == NULL || rowP == NULL) {
+    fprintf(stderr, "TIFF strip buffer malloc error\n");
+  } else {
+    rgiP = newTiledImage(IRGB24, inWidth, inHeight, 0);
+  }
+
+  for (row = 0; rgiP != NULL && row < inHeight; row += rowsperstrip) {
+    if (TIFFReadRGBAStrip(inTiffP, row, rasterP) == 0) {
+      fprintf(stderr, "TIFFReadRGBAStrip error at row %u\n", row);
+      freeImage(rgiP);
+      rgiP = NULL;
+    } else {
+      nrows = inHeight - row;
+      if (nrows > rowsperstrip) {
+        nrows = rowsperstrip;
+      }
+      for (r = 0; r < nrows; r++) {
+        tP = (unsigned char *)(rasterP + (size_t)(nrows - r - 1) * inWidth);
+        gP = rowP;
+        for (x = 0; x < inWidth; x++) {
+          *gP++ = *tP++;  /* red */
+          *gP++ = *tP++;  /* green */
+          *gP++ = *tP++;  /* blue */
+          tP++;           /* alpha */
+        }
+        if (inLut != NULL) {
+          iccApply8(inLut, rowP, inWidth);
+        }
+        imagePutRow(rgiP, row + r, rowP);
+      }
+    }
+  }
+
+  if (rasterP != NULL) _TIFFfree(rasterP);
+  free(rowP);
+  return(rgiP);
+}
+
+
+/********************/
+/* tiffRGB24Large() */
+/********************/
+/* RGB24 image larger than the memory limit */
+/*  returns NULL (not handled) if not top-left oriented or */
+/*  tiled with tiles unusable as gImage tiles */
+static gImage*
+tiffRGB24Large(
+ TIFF *inTiffP,
+ const char *inFilepath,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ icclut inLut)
+{
+gImage *rgiP = NULL;
+unsigned short orientation = ORIENTATION_TOPLEFT;
+uint32_t tile_w = 0;
+uint32_t tile_h = 0;
+
+  TIFFGetFieldDefaulted(inTiffP, TIFFTAG_ORIENTATION, &orientation);
+  if (orientation == ORIENTATION_TOPLEFT) {
+    if (TIFFIsTiled(inTiffP)) {
+      TIFFGetField(inTiffP, TIFFTAG_TILEWIDTH, &tile_w);
+      TIFFGetField(inTiffP, TIFFTAG_TILELENGTH, &tile_h);
+      if (tile_w == tile_h && tile_w != 0 && tile_w % 8 == 0) {
+        rgiP = tiffRGB24Lazy(inTiffP, inFilepath, inWidth, inHeight, tile_w, inLut);
+      }
+    } else {
+      rgiP = tiffRGB24Strips(inTiffP, inWidth, inHeight, inLut);
+    }
+  }
+  return(rgiP);
+}
+
+
 /***************/
 /* tiffRGB24() */
 /***************/
@@ -170,50 +435,113 @@ int tiff_w;
 int tiff_h;
 int ix;
 int iy;
+size_t npix;
 gImage *rgiP = NULL;
 uint32_t *tiff_RGBA = NULL;
 unsigned char *gP = NULL;
 unsigned char *tP = NULL;
+/* orientations 5 to 8: libtiff only flips, so rows are read as */
+/*  stored, gathered in blockP, then put in place */
+unsigned short orientation = ORIENTATION_TOPLEFT;
+unsigned short readorientation = ORIENTATION_TOPLEFT;
+unsigned char *blockP = NULL;
+unsigned char *blkrowP[ORIENT_ROWS];
+unsigned int nblk = 0;
+size_t rowbytes;
+/* embedded profile: each row is converted as it is unpacked */
+icclut lut = NULL;
 
   if (inTiffP != NULL) {
     TIFFGetField(inTiffP, TIFFTAG_IMAGEWIDTH, &tiff_w);
     TIFFGetField(inTiffP, TIFFTAG_IMAGELENGTH, &tiff_h);
+    lut = tiffICC(inTiffP, 0);
     if (tiff_w <= 0 || tiff_h <= 0) {
       fprintf(stderr, "TIFF: width and height must be > 0\n");
     } else {
-      /* tiff_RGBA = _TIFFCheckMalloc(inTiffP, tiff_w * tiff_h, sizeof(uint32_t), "RGBA buffer"); */
-      tiff_RGBA = _TIFFmalloc(tiff_w * tiff_h * sizeof(uint32_t));
-      if (tiff_RGBA == NULL) {
-        /* fprintf(stderr, "_TIFFCheckMalloc error\n"); */
-        fprintf(stderr, "_TIFFmalloc error\n");
+      if (imageWantsTiles(IRGB24, tiff_w, tiff_h) != 0) {
+        /* too large for memory, read into tiles */
+        rgiP = tiffRGB24Large(inTiffP, inFilepath, tiff_w, tiff_h, lut);
+      }
+      if (rgiP != NULL) {
+        rgiP->gamma = 2.2;
+        if (inVerbose) {
+          printf("%s, TIFF RGB 24bit, size: %d x %d, tiled\n", inFilepath, tiff_w, tiff_h);
+          tiffICC(inTiffP, inVerbose); /* cached, only reports */
+        }
       } else {
-        tstatus = TIFFReadRGBAImageOriented(inTiffP, tiff_w, tiff_h,
-          tiff_RGBA, ORIENTATION_TOPLEFT, 0);
-        if (tstatus == 0) {
-          fprintf(stderr, "TIFFReadRGBAImageOriented error\n");
+        /* tiff_RGBA = _TIFFCheckMalloc(inTiffP, tiff_w * tiff_h, sizeof(uint32_t), "RGBA buffer"); */
+        /* size_t, int tiff_w * tiff_h would overflow */
+        npix = (size_t)tiff_w * (size_t)tiff_h;
+        if (npix / (size_t)tiff_h != (size_t)tiff_w ||
+            npix > SIZE_MAX / sizeof(uint32_t)) {
+          tiff_RGBA = NULL;
         } else {
-          if (inVerbose) {
-            printf("%s, TIFF RGB 24bit, size: %d x %d\n", inFilepath, tiff_w, tiff_h);
+          tiff_RGBA = _TIFFmalloc(npix * sizeof(uint32_t));
+        }
+        TIFFGetFieldDefaulted(inTiffP, TIFFTAG_ORIENTATION, &orientation);
+        if (orientation >= ORIENTATION_LEFTTOP && orientation <= ORIENTATION_LEFTBOT) {
+          readorientation = orientation;
+          rowbytes = imageRowBytes(IRGB24, tiff_w);
+          blockP = malloc(rowbytes * ORIENT_ROWS);
+          if (blockP == NULL) {
+            _TIFFfree(tiff_RGBA);
+            tiff_RGBA = NULL;
           }
-          rgiP = newRGB24Image(tiff_w, tiff_h);
-          if (rgiP == NULL) {
-            fprintf(stderr, "newRGB24Image error\n");
+        }
+        if (tiff_RGBA == NULL) {
+          /* fprintf(stderr, "_TIFFCheckMalloc error\n"); */
+          fprintf(stderr, "_TIFFmalloc error\n");
+        } else {
+          /* orientations 2 to 4 are flipped to top-left by libtiff */
+          tstatus = TIFFReadRGBAImageOriented(inTiffP, tiff_w, tiff_h,
+            tiff_RGBA, readorientation, 0);
+          if (tstatus == 0) {
+            fprintf(stderr, "TIFFReadRGBAImageOriented error\n");
           } else {
-            rgiP->gamma = 2.2;
-            /* convert the TIFF data to gImage data */
-            gP = rgiP->data;
-            tP = (unsigned char *)tiff_RGBA;
-            for (iy = 0; iy < tiff_h; iy++) {
-              for (ix = 0; ix < tiff_w; ix++) {
-                *gP++ = *tP++;  /* red */
-                *gP++ = *tP++;  /* green */
-                *gP++ = *tP++;  /* blue */
-                tP++;           /* alpha */
+            if (inVerbose) {
+              printf("%s, TIFF RGB 24bit, size: %d x %d\n", inFilepath, tiff_w, tiff_h);
+              tiffICC(inTiffP, inVerbose); /* cached, only reports */
+            }
+            if (blockP != NULL) {
+              rgiP = newOrientedImage(IRGB24, tiff_w, tiff_h, orientation);
+            } else {
+              rgiP = newRGB24ImageUninit(tiff_w, tiff_h);
+            }
+            if (rgiP == NULL) {
+              fprintf(stderr, "newRGB24Image error\n");
+            } else {
+              rgiP->gamma = 2.2;
+              /* convert the TIFF data to gImage data */
+              gP = rgiP->data;
+              tP = (unsigned char *)tiff_RGBA;
+              for (iy = 0; iy < tiff_h; iy++) {
+                if (blockP != NULL) {
+                  blkrowP[nblk] = blockP + nblk * rowbytes;
+                  gP = blkrowP[nblk];
+                }
+                for (ix = 0; ix < tiff_w; ix++) {
+                  *gP++ = *tP++;  /* red */
+                  *gP++ = *tP++;  /* green */
+                  *gP++ = *tP++;  /* blue */
+                  tP++;           /* alpha */
+                }
+                if (lut != NULL) {
+                  iccApply8(lut, gP - (size_t)tiff_w * 3, tiff_w);
+                }
+                if (blockP != NULL) {
+                  nblk++;
+                  if (nblk == ORIENT_ROWS || iy == tiff_h - 1) {
+                    orientPutRows(rgiP, orientation, tiff_w, tiff_h,
+                      iy + 1 - nblk, nblk, blkrowP);
+                    nblk = 0;
+                  }
+                }
               }
             }
           }
+          _TIFFfree(tiff_RGBA);
         }
-        _TIFFfree(tiff_RGBA);
+        free(blockP);
       }
     }
   }
@@ -242,14 +570,15 @@ gImage *rgiP = NULL;
 int tstatus;
 int tiff_w;
 int tiff_h;
-int i;
+size_t i;
 int iy;
 unsigned short tiff_photometric;
-unsigned short scanlinesize;
+size_t scanlinesize;
 unsigned char *scanlineP = NULL;
 uint16_t *tP = NULL;
 uint16_t *gP = NULL;
 uint16_t u16;
+icclut lut = NULL;
 
   if (inTiffP != NULL) {
     TIFFGetField(inTiffP, TIFFTAG_IMAGEWIDTH, &tiff_w);
@@ -263,7 +592,14 @@ uint16_t u16;
       if (scanlineP == NULL) {
         fprintf(stderr, "TIFF malloc error\n");
       } else {
-        rgiP = newRGB48Image(tiff_w, tiff_h);
+        if (tiff_photometric == PHOTOMETRIC_RGB ||
+            tiff_photometric == PHOTOMETRIC_MINISBLACK ||
+            tiff_photometric == PHOTOMETRIC_MINISWHITE) {
+          /* every row is written below, zero fill not needed */
+          rgiP = newRGB48ImageUninit(tiff_w, tiff_h);
+        } else {
+          rgiP = newRGB48Image(tiff_w, tiff_h);
+        }
         if (rgiP == NULL) {
           fprintf(stderr, "TIFF newRGB48Image fail\n");
         } else {
@@ -272,6 +608,7 @@ uint16_t u16;
             if (inVerbose) {
               printf("%s, TIFF RGB 48bit, size: %d x %d\n", inFilepath, tiff_w, tiff_h);
             }
+            lut = tiffICC(inTiffP, inVerbose);
             gP = (uint16_t *)rgiP->data;
             for (iy = 0; iy < tiff_h; iy++) {
               tstatus = TIFFReadScanline(inTiffP, scanlineP, iy, 0);
@@ -280,6 +617,9 @@ uint16_t u16;
               for (i = 0; i < scanlinesize; i+=2) {
                 *gP++ = *tP++;
               }
+              if (lut != NULL) {
+                iccApply16(lut, gP - (size_t)tiff_w * 3, tiff_w);
+              }
             }
           } else if (tiff_photometric == PHOTOMETRIC_MINISBLACK ||
                      tiff_photometric == PHOTOMETRIC_MINISWHITE) {
@@ -317,8 +657,91 @@ uint16_t u16;
 }
 
 
-/* PUBLIC FUNCTIONS */
+/****************/
+/* tiffOrient() */
+/****************/
+/* upright copy of an image read with TIFFReadScanline, which */
+/*  ignores the Orientation tag; frees the stored one */
+static gImage*
+tiffOrient(
+ TIFF *inTiffP,
+ gImage *ingiP,
+ unsigned int inVerbose)
+{
+gImage *rgiP = ingiP;
+unsigned short orientation = ORIENTATION_TOPLEFT;
+
+  TIFFGetFieldDefaulted(inTiffP, TIFFTAG_ORIENTATION, &orientation);
+  if (ingiP != NULL && orientation != ORIENTATION_TOPLEFT) {
+    rgiP = orient(ingiP, orientation, inVerbose);
+    if (rgiP != ingiP) {
+      freeImage(ingiP);
+    }
+  }
+  return(rgiP);
+}
+
+
+/*******************/
+/* tiffSameShape() */
+/*******************/
+/* return -1 (true) if inW x inH is a reduction of inFullW x inFullH, */
+/*  each side rounded by up to a pixel */
+static int
+tiffSameShape(
+ uint32_t inFullW,
+ uint32_t inFullH,
+ uint32_t inW,
+ uint32_t inH)
+{
+double d;
+
+  d = (double)inW * inFullH - (double)inFullW * inH;
+  if (d < 0) {
+    d = -d;
+  }
+  return(inW != 0 && inH != 0 && d <= (double)inFullW + inFullH ? -1 : 0);
+}
+
 
+/****************/
+/* tiffDecode() */
+/****************/
+/* the image of the current directory */
+static gImage*
+tiffDecode(
+ TIFF *inTiffP,
+ const char *inFilepath,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+unsigned short tiff_bitspersample;
+
+  TIFFGetField(inTiffP, TIFFTAG_BITSPERSAMPLE, &tiff_bitspersample);
+  if (tiff_bitspersample == 0) {
+    fprintf(stderr, "TIFF error BITSPERSAMPLE of zero\n");
+  } else if (tiff_bitspersample == 1) {
+    rgiP = tiffBitmap(inTiffP, inFilepath, inVerbose);
+    rgiP = tiffOrient(inTiffP, rgiP, inVerbose);
+  } else if (tiff_bitspersample <= 8) {
+    rgiP = tiffRGB24(inTiffP, inFilepath, inVerbose);
+  } else if (tiff_bitspersample <= 16) {
+    rgiP = tiffRGB48(inTiffP, inFilepath, inVerbose);
+    rgiP = tiffOrient(inTiffP, rgiP, inVerbose);
+  } else {
+    fprintf(stderr, "TIFF invalid bits per sample\n");
+  }
+
+  if (rgiP != NULL) {
+    strncpy(rgiP->title, inFilepath, 255);
+    rgiP->title[255] = '\0';
+  }
+
+  return(rgiP);
+}
+
+
+/* PUBLIC FUNCTIONS */
 
 /**************/
 /* tiffLoad() */
@@ -330,35 +753,76 @@ tiffLoad(
 {
 gImage *rgiP = NULL;
 TIFF *tiffP = NULL;
-unsigned short tiff_bitspersample;
 
   if (tiffCheck(inFilepath) != 0) {
 
     tiffP = TIFFOpen(inFilepath, "r");
     if (tiffP != NULL) {
+      rgiP = tiffDecode(tiffP, inFilepath, inVerbose);
+      TIFFClose(tiffP);
+    }
+  }
 
-      TIFFGetField(tiffP, TIFFTAG_BITSPERSAMPLE, &tiff_bitspersample);
-      if (tiff_bitspersample == 0) {
-        fprintf(stderr, "TIFF error BITSPERSAMPLE of zero\n");
-      } else if (tiff_bitspersample == 1) {
-        rgiP = tiffBitmap(tiffP, inFilepath, inVerbose);
-      } else if (tiff_bitspersample <= 8) {
-        rgiP = tiffRGB24(tiffP, inFilepath, inVerbose);
-      } else if (tiff_bitspersample <= 16) {
-        rgiP = tiffRGB48(tiffP, inFilepath, inVerbose);
-      } else {
-        fprintf(stderr, "TIFF invalid bits per sample\n");
+  return(rgiP);
+}
+
+
+/********************/
+/* tiffLoadScaled() */
+/********************/
+/* reduced images are those after the first directory, marked */
+/*  FILETYPE_REDUCEDIMAGE, with the shape of the full size image */
+gImage*
+tiffLoadScaled(
+ const char *inFilepath,
+ unsigned int inMaxdim,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+TIFF *tiffP = NULL;
+uint32_t subfiletype;
+uint32_t full_w = 0;
+uint32_t full_h = 0;
+uint32_t tiff_w;
+uint32_t tiff_h;
+uint32_t big;
+uint32_t bestbig = 0;
+tdir_t dir = 0;
+tdir_t best = 0;
+
+  if (tiffCheck(inFilepath) != 0) {
+
+    tiffP = TIFFOpen(inFilepath, "r");
+    if (tiffP != NULL) {
+      TIFFGetField(tiffP, TIFFTAG_IMAGEWIDTH, &full_w);
+      TIFFGetField(tiffP, TIFFTAG_IMAGELENGTH, &full_h);
+      while (TIFFReadDirectory(tiffP)) {
+        dir++;
+        subfiletype = 0;
+        tiff_w = 0;
+        tiff_h = 0;
+        TIFFGetField(tiffP, TIFFTAG_SUBFILETYPE, &subfiletype);
+        TIFFGetField(tiffP, TIFFTAG_IMAGEWIDTH, &tiff_w);
+        TIFFGetField(tiffP, TIFFTAG_IMAGELENGTH, &tiff_h);
+        big = (tiff_w > tiff_h ? tiff_w : tiff_h);
+        if ((subfiletype & FILETYPE_REDUCEDIMAGE) != 0 && big >= inMaxdim &&
+            (bestbig == 0 || big < bestbig) &&
+            tiffSameShape(full_w, full_h, tiff_w, tiff_h)) {
+          best = dir;
+          bestbig = big;
+        }
       }
 
+      if (TIFFSetDirectory(tiffP, best) != 0) {
+        if (inVerbose && best != 0) {
+          printf("%s, TIFF reduced image, directory %u\n", inFilepath,
+            (unsigned int)best);
+        }
+        rgiP = tiffDecode(tiffP, inFilepath, inVerbose);
+      }
       TIFFClose(tiffP);
     }
   }
 
-  if (rgiP != NULL) {
-    strncpy(rgiP->title, inFilepath, 255);
-    rgiP->title[255] = '\0';
-  }
-
   return(rgiP);
 }
-
@@ -32,5 +32,19 @@
 gImage* tiffLoad(const char *filename, unsigned int verbose);
 
 
+/** tiffLoadScaled
+ * @ingroup tiff
+ * @param[in] filename filename
+ * @param[in] maxdim size wanted, in pixels, of the longer side
+ * @param[in] verbose flag for verbose output
+ * @return gImage, NULL if not a TIFF file
+ *
+ * the smallest reduced resolution image (SUBFILETYPE) in the file
+ * still at least maxdim on the longer side, if there is one,
+ * else the full size image
+ */
+gImage* tiffLoadScaled(const char *filename, unsigned int maxdim, unsigned int verbose);
+
+
 #endif
 
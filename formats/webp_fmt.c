@@ -24,18 +24,54 @@
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
+#include "../transforms/icc.h" /* iccLut, iccConvertImage */
 
 #include "webp_fmt.h"  /* enforce declarations */
 
 
-/* PUBLIC FUNCTIONS */
+/* internal static functions */
 
-/**************/
-/* webpLoad() */
-/**************/
-gImage*
-webpLoad(
+/*************/
+/* webpICC() */
+/*************/
+/* the ICCP chunk of an extended (VP8X) WebP file, NULL if none */
+/*  chunks follow the 12 byte RIFF header: fourcc, little endian */
+/*  size, then data padded to an even length */
+static const unsigned char*
+webpICC(
+ const unsigned char *inP,
+ size_t inSize,
+ size_t *outLen)
+{
+const unsigned char *rP = NULL;
+size_t off = 12;
+size_t len;
+
+  while (rP == NULL && off + 8 <= inSize) {
+    len = inP[off + 4] + inP[off + 5]*256 + inP[off + 6]*65536 +
+          (size_t)inP[off + 7]*16777216;
+    if (len > inSize - off - 8) {
+      break;
+    }
+    if (memcmp(inP + off, "ICCP", 4) == 0) {
+      rP = inP + off + 8;
+      *outLen = len;
+    }
+    off += 8 + len + (len & 1);
+  }
+  return(rP);
+}
+
+
+/****************/
+/* webpDecode() */
+/****************/
+/* inMaxdim 0 for full size, else decoded scaled so the longer */
+/*  side is inMaxdim, libWebP scales while decoding */
+static gImage*
+webpDecode(
  const char *inFilepath,
+ unsigned int inMaxdim,
  unsigned int inVerbose)
 {
 int status = 0;
@@ -48,10 +84,17 @@ unsigned char *w_outP = NULL;
 unsigned char buf12[12];
 size_t nread = 0;
 size_t w_size = 0;
-int g_size = 0;
+size_t g_size = 0;
 int w_width = 0;
 int w_height = 0;
-int i = 0;
+int w_stride = 0;
+int w_big = 0;
+int scaled = 0;
+size_t i = 0;
+int y;
+const unsigned char *iccP = NULL;
+size_t icclen = 0;
+WebPDecoderConfig w_config;
 
   fP = fopen(inFilepath, "r");
   if (fP == NULL) {
@@ -88,44 +131,109 @@ int i = 0;
     fclose(fP);
   }
 
-  if (status == 0) {
+  if (status == 0 && inMaxdim != 0) {
+    if (WebPInitDecoderConfig(&w_config) == 0 ||
+        WebPGetFeatures(w_inP, w_size, &w_config.input) != VP8_STATUS_OK) {
+      fprintf(stderr, "WebP error GetFeatures\n");
+      status = (-1);
+    } else {
+      w_width = w_config.input.width;
+      w_height = w_config.input.height;
+      w_big = (w_width > w_height ? w_width : w_height);
+      if (w_big > (int)inMaxdim) {
+        w_config.options.use_scaling = 1;
+        w_config.options.scaled_width = (w_width * (double)inMaxdim) / w_big + 0.5;
+        w_config.options.scaled_height = (w_height * (double)inMaxdim) / w_big + 0.5;
+        if (w_config.options.scaled_width < 1) w_config.options.scaled_width = 1;
+        if (w_config.options.scaled_height < 1) w_config.options.scaled_height = 1;
+      }
+      w_config.output.colorspace = MODE_RGB;
+      if (WebPDecode(w_inP, w_size, &w_config) != VP8_STATUS_OK) {
+        fprintf(stderr, "WebP error Decode\n");
+        status = (-1);
+      } else {
+        scaled = -1;
+        w_outP = w_config.output.u.RGBA.rgba;
+        w_stride = w_config.output.u.RGBA.stride;
+        w_width = w_config.output.width;
+        w_height = w_config.output.height;
+      }
+    }
+  } else if (status == 0) {
     w_outP = WebPDecodeRGB(w_inP, w_size, &w_width, &w_height);
     if (w_outP == NULL) {
       fprintf(stderr, "WebP error DecodeRGB\n");
       status = (-1);
+    }
+    w_stride = w_width * 3;
+  }
+
+  if (status == 0) {
+    rgiP = newRGB24ImageUninit(w_width, w_height);
+    if (rgiP == NULL) {
+      fprintf(stderr, "WebP error newRGB24Image\n");
+      status = (-1);
     } else {
-      rgiP = newRGB24Image(w_width, w_height);
-      if (rgiP == NULL) {
-        fprintf(stderr, "WebP error newRGB24Image\n");
-        status = (-1);
-      } else {
-        rgiP->gamma = 2.2; /* check for this ? */
-        strncpy(rgiP->title, inFilepath, 255);
-        rgiP->title[255]= '\0';
+      rgiP->gamma = 2.2; /* check for this ? */
+      strncpy(rgiP->title, inFilepath, 255);
+      rgiP->title[255]= '\0';
 
-        if (inVerbose) {
-          /* maybe try to get info whether lossy or lossless ? */
-          printf("%s, WebP, size: %d x %d\n", inFilepath, w_width, w_height);
-        }
+      if (inVerbose) {
+        /* maybe try to get info whether lossy or lossless ? */
+        printf("%s, WebP, size: %d x %d\n", inFilepath, w_width, w_height);
+      }
 
-        g_size = w_height * w_width * 3;
-        /* maybe memcpy() here ? */
-        wP = w_outP;
-        gP = rgiP->data;
+      g_size = (size_t)w_width * 3;
+      gP = rgiP->data;
+      for (y = 0; y < w_height; y++) {
+        wP = w_outP + (size_t)y * w_stride;
         for (i = 0; i < g_size; i++) {
           *gP++ = *wP++;
         }
       }
+
+      iccP = webpICC(w_inP, w_size, &icclen);
+      if (iccP != NULL) {
+        iccConvertImage(rgiP, iccLut(iccP, icclen, inVerbose));
+      }
     }
   }
 
   if (w_inP != NULL) {
     free(w_inP);
   }
-  if (w_outP != NULL) {
+  if (scaled) {
+    WebPFreeDecBuffer(&w_config.output);
+  } else if (w_outP != NULL) {
     WebPFree(w_outP);
   }
 
   return(rgiP);
 }
 
+
+/* PUBLIC FUNCTIONS */
+
+/**************/
+/* webpLoad() */
+/**************/
+gImage*
+webpLoad(
+ const char *inFilepath,
+ unsigned int inVerbose)
+{
+  return(webpDecode(inFilepath, 0, inVerbose));
+}
+
+
+/********************/
+/* webpLoadScaled() */
+/********************/
+gImage*
+webpLoadScaled(
+ const char *inFilepath,
+ unsigned int inMaxdim,
+ unsigned int inVerbose)
+{
+  return(webpDecode(inFilepath, inMaxdim, inVerbose));
+}
@@ -32,5 +32,17 @@
 gImage* webpLoad(const char *filename, unsigned int verbose);
 
 
+/** webpLoadScaled
+ * @ingroup webp
+ * @param[in] filename filename
+ * @param[in] maxdim size wanted, in pixels, of the longer side
+ * @param[in] verbose flag for verbose output
+ * @return gImage, NULL if not a WebP file
+ *
+ * decoded by libWebP straight to the smaller size
+ */
+gImage* webpLoadScaled(const char *filename, unsigned int maxdim, unsigned int verbose);
+
+
 #endif
 
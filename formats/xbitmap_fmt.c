@@ -40,7 +40,7 @@ unsigned int height = 0;
 int xhot = 0;
 int yhot = 0;
 unsigned char *xbm_dataP = NULL;
-unsigned int linebytes = 0;
+size_t linebytes = 0;
 
   xret = XReadBitmapFileData(inFilepath, &width, &height,
     &xbm_dataP, &xhot, &yhot);
@@ -50,19 +50,22 @@ unsigned int linebytes = 0;
 
   } else {
 
-    linebytes = (width + 7) / 8;
+    linebytes = imageRowBytes(IBITMAP, width);
   
-    gimageP = newBitImage(width, height);
+    /* fully overwritten by memcpy, zero fill not needed */
+    gimageP = newBitImageUninit(width, height);
+    if (gimageP != NULL) {
 
-    memcpy(gimageP->data, xbm_dataP, linebytes * height );
+      memcpy(gimageP->data, xbm_dataP, linebytes * height );
 
-    strncpy(gimageP->title, inFilepath, 255);
-    gimageP->title[255]= '\0';
+      strncpy(gimageP->title, inFilepath, 255);
+      gimageP->title[255]= '\0';
 
-    if (inVerbose) {
-      printf("%s, X11 bitmap, size: %d x %d\n",
-        inFilepath, width, height);
-    } 
+      if (inVerbose) {
+        printf("%s, X11 bitmap, size: %d x %d\n",
+          inFilepath, width, height);
+      } 
+    }
 
   }
 
@@ -8,54 +8,365 @@
 /* xopenimage project under the "ISC license" */
 /*  see LICENSE.txt */ 
 
+/* Feature test switches */
+#define _POSIX_C_SOURCE 200809L /* mkstemp */
+
 /* C standard library */
-#include <stdlib.h> /* malloc, calloc */
-#include <stdio.h>  /* printf, fprintf, stderr */
+#include <stdlib.h> /* malloc, calloc, getenv, mkstemp */
+#include <stdio.h>  /* printf, fprintf, snprintf, stderr */
+#include <stdint.h> /* SIZE_MAX */
+#include <string.h> /* memcpy */
+
+/* POSIX */
+#include <unistd.h>   /* close, unlink, ftruncate, sysconf */
+#include <sys/mman.h> /* mmap, munmap */
 
 /* code base */
 #include "gimage.h" /* declarations, consistency */
 
 
-/* PUBLIC FUNCTIONS */
+/* internal (static) variables */
 
-/*****************/
-/* newBitImage() */
-/*****************/
-gImage*
-newBitImage(
+/* images with more data than this are better tiled, 0 until computed */
+static size_t MemoryLimit = 0;
+
+/* data bytes of images made by this thread, see imageBytesAllocated() */
+static _Thread_local size_t ThreadBytes = 0;
+
+
+/* internal (static) functions */
+
+/********************/
+/* newImageStruct() */
+/********************/
+/* allocate and initialize a gImage struct, data is left NULL */
+static gImage*
+newImageStruct(
+ const char *inCaller,
+ unsigned int inType,
+ unsigned int inDepth,
  unsigned int inWidth,
  unsigned int inHeight)
 {
 gImage *gimageP = NULL;
 
-  /* allocate struct */
   gimageP = malloc(sizeof(gImage));
   if (gimageP == NULL) {
-    fprintf(stderr, "xopenimage newBitImage malloc fail\n");
+    fprintf(stderr, "xopenimage %s malloc fail\n", inCaller);
 
   } else {
 
-    gimageP->data = calloc( inHeight * ((inWidth + 7) / 8 ) , sizeof(unsigned char) );
+    gimageP->gitype   = inType;
+    gimageP->width    = inWidth;
+    gimageP->height   = inHeight;
+    gimageP->depth    = inDepth; /* redundant with gitype */
+    gimageP->gamma    = 1.0;
+    gimageP->title[0] = '\0';
+
+    gimageP->background[0] = '\0'; /* is used for bitmap */
+    gimageP->foreground[0] = '\0'; /* is used for bitmap */
+
+    gimageP->data      = NULL;
+
+    gimageP->storage   = GI_LINEAR;
+    gimageP->tiledim   = 0;
+    gimageP->mapbytes  = 0;
+    gimageP->tilestate = NULL;
+    gimageP->tileread  = NULL;
+    gimageP->tileclose = NULL;
+    gimageP->tilectx   = NULL;
+
+  }
+  return(gimageP);
+}
+
+
+/**************/
+/* newImage() */
+/**************/
+/* common allocation for linear gImage types */
+/*  inZero non-zero: data is calloc'd (zero filled) */
+/*  inZero zero: data is malloc'd, contents undefined, */
+/*   caller must write every byte */
+static gImage*
+newImage(
+ const char *inCaller,
+ unsigned int inType,
+ unsigned int inDepth,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ int inZero)
+{
+gImage *gimageP = NULL;
+size_t  nbytes;
+
+  /* size in size_t, checked for overflow */
+  nbytes = imageDataBytes(inType, inWidth, inHeight);
+
+  if (nbytes == 0 && inWidth != 0 && inHeight != 0) {
+    fprintf(stderr, "xopenimage %s %u x %u image too large\n",
+      inCaller, inWidth, inHeight);
+
+  } else {
+    gimageP = newImageStruct(inCaller, inType, inDepth, inWidth, inHeight);
+  }
+
+  if (gimageP != NULL) {
+
+    if (inZero != 0) {
+      gimageP->data = calloc(nbytes, sizeof(unsigned char));
+    } else {
+      gimageP->data = malloc(nbytes);
+    }
     if (gimageP->data == NULL) {
-      fprintf(stderr, "xopenimage newBitImage calloc fail\n");
+      fprintf(stderr, "xopenimage %s %s fail\n", inCaller,
+        (inZero != 0 ? "calloc" : "malloc"));
       free(gimageP);
       gimageP = NULL;
+    } else {
+      ThreadBytes += nbytes;
+    }
+  }
+  return(gimageP);
+}
 
+
+/*******************/
+/* tileMapCreate() */
+/*******************/
+/* memory map an unlinked temp file of inBytes */
+/*  MAP_SHARED, so dirty pages go back to the file, not to swap */
+/*  returns NULL on failure */
+static unsigned char*
+tileMapCreate(
+ size_t inBytes)
+{
+unsigned char *mapP = NULL;
+void *vP = NULL;
+const char *dirP = NULL;
+char path[4096];
+int fd = -1;
+
+  dirP = getenv("TMPDIR");
+  if (dirP == NULL || dirP[0] == '\0') {
+    dirP = "/tmp";
+  }
+  snprintf(path, sizeof(path), "%s/xopenimage-XXXXXX", dirP);
+
+  fd = mkstemp(path);
+  if (fd < 0) {
+    perror(path);
+  } else {
+    /* unlink now, file goes away when unmapped (or on crash) */
+    unlink(path);
+    if (ftruncate(fd, (off_t)inBytes) != 0) {
+      perror("xopenimage tile file ftruncate");
     } else {
+      vP = mmap(NULL, inBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (vP == MAP_FAILED) {
+        perror("xopenimage tile file mmap");
+      } else {
+        mapP = vP;
+      }
+    }
+    /* mapping keeps the file alive */
+    close(fd);
+  }
+  return(mapP);
+}
+
+
+/**************/
+/* tileCopy() */
+/**************/
+/* copy a span of a row between tiles and a linear row buffer */
+/*  inToTiles zero: tiles -to-> inRowP, else inRowP -to-> tiles */
+/*  returns 0, or -1 if a tile could not be read */
+static int
+tileCopy(
+ gImage *ingiP,
+ unsigned int inX,
+ unsigned int inY,
+ unsigned int inNpix,
+ unsigned char *inRowP,
+ int inToTiles)
+{
+int status = 0;
+unsigned char *tileP = NULL;
+size_t pixbytes;
+size_t tilerowbytes;
+unsigned int tx;
+unsigned int ty;
+unsigned int x;
+unsigned int x0;
+unsigned int n;
+
+  pixbytes = imageRowBytes(ingiP->gitype, 1);
+  tilerowbytes = imageRowBytes(ingiP->gitype, ingiP->tiledim);
+  ty = inY / ingiP->tiledim;
+
+  for (x = inX; x < inX + inNpix && status == 0; x += n) {
+    tx = x / ingiP->tiledim;
+    x0 = x % ingiP->tiledim;
+    n = ingiP->tiledim - x0;
+    if (n > inX + inNpix - x) {
+      n = inX + inNpix - x;
+    }
+    tileP = imageTile(ingiP, tx, ty);
+    if (tileP == NULL) {
+      status = -1;
+    } else {
+      tileP += (inY % ingiP->tiledim) * tilerowbytes + x0 * pixbytes;
+      if (inToTiles != 0) {
+        memcpy(tileP, inRowP + (x - inX) * pixbytes, n * pixbytes);
+      } else {
+        memcpy(inRowP + (x - inX) * pixbytes, tileP, n * pixbytes);
+      }
+    }
+  }
+  return(status);
+}
 
-      gimageP->gitype   = IBITMAP;
-      gimageP->width    = inWidth;
-      gimageP->height   = inHeight;
-      gimageP->depth    = 1; /* redundant since IBITMAP */
-      gimageP->gamma    = 1.0; /* not appropriate for bitmap */
-      gimageP->title[0] = '\0';
 
-      gimageP->background[0] = '\0'; /* is used for bitmap */
-      gimageP->foreground[0] = '\0'; /* is used for bitmap */
+/* PUBLIC FUNCTIONS */
+
+/*******************/
+/* imageRowBytes() */
+/*******************/
+/* bytes in one row of data, 0 if unknown type or too large */
+size_t
+imageRowBytes(
+ unsigned int inType,
+ unsigned int inWidth)
+{
+size_t rowbytes = 0;
+size_t pixbytes = 0;
+
+  switch (inType) {
+   case IBITMAP:
+    rowbytes = ((size_t)inWidth + 7) / 8;
+    break;
+   case IRGB24:
+    pixbytes = 3;
+    break;
+   case IRGB48:
+    pixbytes = 3 * 2;
+    break;
+   case IRGBF32:
+    pixbytes = 3 * sizeof(float);
+    break;
+   default:
+    rowbytes = 0;
+  }
 
+  if (pixbytes != 0) {
+    rowbytes = (size_t)inWidth * pixbytes;
+    if (rowbytes / pixbytes != inWidth) {
+      /* size_t overflow */
+      rowbytes = 0;
     }
   }
-  return(gimageP);
+  return(rowbytes);
+}
+
+
+/********************/
+/* imageDataBytes() */
+/********************/
+/* bytes in all of data, 0 if unknown type or too large */
+size_t
+imageDataBytes(
+ unsigned int inType,
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+size_t rowbytes;
+size_t nbytes = 0;
+
+  rowbytes = imageRowBytes(inType, inWidth);
+  if (rowbytes != 0 && inHeight <= SIZE_MAX / rowbytes) {
+    nbytes = rowbytes * inHeight;
+  }
+  return(nbytes);
+}
+
+
+/*************************/
+/* setImageMemoryLimit() */
+/*************************/
+void
+setImageMemoryLimit(
+ size_t inBytes)
+{
+  MemoryLimit = inBytes;
+}
+
+
+/**********************/
+/* imageMemoryLimit() */
+/**********************/
+size_t
+imageMemoryLimit(void)
+{
+long pages;
+long pagesize;
+
+  if (MemoryLimit == 0) {
+    /* default, half of physical memory */
+    pages = sysconf(_SC_PHYS_PAGES);
+    pagesize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pagesize > 0 &&
+        (size_t)pages / 2 <= SIZE_MAX / (size_t)pagesize) {
+      MemoryLimit = ((size_t)pages / 2) * (size_t)pagesize;
+    } else {
+      MemoryLimit = SIZE_MAX;
+    }
+  }
+  return(MemoryLimit);
+}
+
+
+/*************************/
+/* imageBytesAllocated() */
+/*************************/
+size_t
+imageBytesAllocated(void)
+{
+  return(ThreadBytes);
+}
+
+
+/*********************/
+/* imageWantsTiles() */
+/*********************/
+int
+imageWantsTiles(
+ unsigned int inType,
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+size_t nbytes;
+int ret = 0;
+
+  nbytes = imageDataBytes(inType, inWidth, inHeight);
+  if ((inType == IRGB24 || inType == IRGB48 || inType == IRGBF32) &&
+      (nbytes == 0 || nbytes > imageMemoryLimit())) {
+    ret = -1;
+  }
+  return(ret);
+}
+
+
+/*****************/
+/* newBitImage() */
+/*****************/
+gImage*
+newBitImage(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  /* gamma not appropriate for bitmap, left at 1.0 */
+  return(newImage("newBitImage", IBITMAP, 1, inWidth, inHeight, -1));
 }
 
 
@@ -66,70 +377,278 @@ gImage*
 newRGB24Image(
  unsigned int inWidth,
  unsigned int inHeight)
+{
+  return(newImage("newRGB24Image", IRGB24, 24, inWidth, inHeight, -1));
+}
+
+
+/*******************/
+/* newRGB48Image() */
+/*******************/
+gImage*
+newRGB48Image(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  return(newImage("newRGB48Image", IRGB48, 48, inWidth, inHeight, -1));
+}
+
+
+/********************/
+/* newRGBF32Image() */
+/********************/
+gImage*
+newRGBF32Image(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  /* all zero bits is 0.0f in IEEE 754 */
+  return(newImage("newRGBF32Image", IRGBF32, 96, inWidth, inHeight, -1));
+}
+
+
+/***********************/
+/* newBitImageUninit() */
+/***********************/
+gImage*
+newBitImageUninit(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  return(newImage("newBitImageUninit", IBITMAP, 1, inWidth, inHeight, 0));
+}
+
+
+/*************************/
+/* newRGB24ImageUninit() */
+/*************************/
+gImage*
+newRGB24ImageUninit(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  return(newImage("newRGB24ImageUninit", IRGB24, 24, inWidth, inHeight, 0));
+}
+
+
+/*************************/
+/* newRGB48ImageUninit() */
+/*************************/
+gImage*
+newRGB48ImageUninit(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  return(newImage("newRGB48ImageUninit", IRGB48, 48, inWidth, inHeight, 0));
+}
+
+
+/**************************/
+/* newRGBF32ImageUninit() */
+/**************************/
+gImage*
+newRGBF32ImageUninit(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+  return(newImage("newRGBF32ImageUninit", IRGBF32, 96, inWidth, inHeight, 0));
+}
+
+
+/*******************/
+/* newTiledImage() */
+/*******************/
+gImage*
+newTiledImage(
+ unsigned int inType,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ unsigned int inTiledim)
 {
 gImage *gimageP = NULL;
+size_t tilebytes;
+size_t ntiles;
+size_t mapbytes = 0;
+unsigned int across;
+unsigned int down;
+
+  if (inTiledim == 0) {
+    inTiledim = GI_TILEDIM;
+  }
 
-  /* allocate struct */
-  gimageP = malloc(sizeof(gImage));
-  if (gimageP == NULL) {
-    fprintf(stderr, "xopenimage newRGB24Image malloc fail\n");
+  if ((inType != IRGB24 && inType != IRGB48 && inType != IRGBF32) ||
+      inTiledim % 8 != 0 ||
+      inWidth == 0 || inHeight == 0) {
+    fprintf(stderr, "xopenimage newTiledImage invalid arguments\n");
   } else {
+    across = (inWidth  - 1) / inTiledim + 1;
+    down   = (inHeight - 1) / inTiledim + 1;
+    ntiles = (size_t)across * down;
+    tilebytes = imageDataBytes(inType, inTiledim, inTiledim);
+    if (tilebytes != 0 && ntiles <= SIZE_MAX / tilebytes) {
+      mapbytes = ntiles * tilebytes;
+    }
+    if (mapbytes == 0) {
+      fprintf(stderr, "xopenimage newTiledImage %u x %u image too large\n",
+        inWidth, inHeight);
+    } else {
+      gimageP = newImageStruct("newTiledImage", inType,
+        (unsigned int)imageRowBytes(inType, 1) * 8, inWidth, inHeight);
+    }
+  }
 
-    gimageP->data = calloc(inHeight * inWidth * 3, sizeof(unsigned char) );
+  if (gimageP != NULL) {
+    gimageP->data     = tileMapCreate(mapbytes);
     if (gimageP->data == NULL) {
-      fprintf(stderr, "xopenimage newRGB24Image calloc fail\n");
+      fprintf(stderr, "xopenimage newTiledImage %u x %u mapping fail\n",
+        inWidth, inHeight);
       free(gimageP);
       gimageP = NULL;
-
     } else {
-
-      gimageP->gitype   = IRGB24;
-      gimageP->width    = inWidth;
-      gimageP->height   = inHeight;
-      gimageP->depth    = 24; /* redundant since IRGB24 */
-      gimageP->gamma    = 1.0;
-      gimageP->title[0] = '\0';
-
+      gimageP->storage  = GI_TILED;
+      gimageP->tiledim  = inTiledim;
+      gimageP->mapbytes = mapbytes;
+      ThreadBytes += mapbytes;
     }
   }
+
   return(gimageP);
 }
 
 
 /*******************/
-/* newRGB48Image() */
+/* newLargeImage() */
 /*******************/
 gImage*
-newRGB48Image(
+newLargeImage(
+ unsigned int inType,
  unsigned int inWidth,
  unsigned int inHeight)
 {
 gImage *gimageP = NULL;
 
-  /* allocate struct */
-  gimageP = malloc(sizeof(gImage));
-  if (gimageP == NULL) {
-    fprintf(stderr, "xopenimage newRGB48Image malloc fail\n");
+  if (imageWantsTiles(inType, inWidth, inHeight) != 0) {
+    gimageP = newTiledImage(inType, inWidth, inHeight, 0);
+  } else if (inType == IRGB24) {
+    gimageP = newRGB24ImageUninit(inWidth, inHeight);
+  } else if (inType == IRGB48) {
+    gimageP = newRGB48ImageUninit(inWidth, inHeight);
+  } else if (inType == IRGBF32) {
+    gimageP = newRGBF32ImageUninit(inWidth, inHeight);
   } else {
+    fprintf(stderr, "xopenimage newLargeImage invalid type\n");
+  }
+  return(gimageP);
+}
 
-    gimageP->data = calloc(inHeight * inWidth * 3 * 2, sizeof(unsigned char) );
-    if (gimageP->data == NULL) {
-      fprintf(stderr, "xopenimage newRGB48Image calloc fail\n");
-      free(gimageP);
-      gimageP = NULL;
 
-    }  else {
+/***************/
+/* imageTile() */
+/***************/
+unsigned char*
+imageTile(
+ gImage *gimageP,
+ unsigned int inTx,
+ unsigned int inTy)
+{
+unsigned char *tileP = NULL;
+unsigned int across;
+size_t t;
+
+  across = (gimageP->width - 1) / gimageP->tiledim + 1;
+  t = (size_t)inTy * across + inTx;
+  tileP = gimageP->data + t * imageDataBytes(gimageP->gitype,
+    gimageP->tiledim, gimageP->tiledim);
+
+  /* read on demand */
+  if (gimageP->tilestate != NULL && gimageP->tilestate[t] == 0) {
+    if (gimageP->tileread == NULL ||
+        gimageP->tileread(gimageP, inTx, inTy, tileP) != 0) {
+      fprintf(stderr, "xopenimage tile %u,%u read fail\n", inTx, inTy);
+      tileP = NULL;
+    } else {
+      gimageP->tilestate[t] = 1;
+    }
+  }
+  return(tileP);
+}
 
-      gimageP->gitype   = IRGB48;
-      gimageP->width    = inWidth;
-      gimageP->height   = inHeight;
-      gimageP->depth    = 48; /* redundant since IRGB48 */
-      gimageP->gamma    = 1.0;
-      gimageP->title[0] = '\0';
 
+/***************/
+/* imageRowP() */
+/***************/
+unsigned char*
+imageRowP(
+ gImage *gimageP,
+ unsigned int inX,
+ unsigned int inY,
+ unsigned int inNpix,
+ unsigned char *scratchP)
+{
+unsigned char *rowP = NULL;
+
+  if (gimageP->storage == GI_TILED) {
+    if (tileCopy(gimageP, inX, inY, inNpix, scratchP, 0) == 0) {
+      rowP = scratchP;
+    }
+  } else if (gimageP->gitype == IBITMAP) {
+    rowP = gimageP->data + (size_t)inY * imageRowBytes(IBITMAP, gimageP->width)
+      + inX / 8;
+  } else {
+    rowP = gimageP->data + (size_t)inY * imageRowBytes(gimageP->gitype, gimageP->width)
+      + imageRowBytes(gimageP->gitype, inX);
+  }
+  return(rowP);
+}
+
+
+/*****************/
+/* imagePutRow() */
+/*****************/
+void
+imagePutRow(
+ gImage *gimageP,
+ unsigned int inY,
+ const unsigned char *inRowP)
+{
+size_t rowbytes;
+unsigned char *dstP = NULL;
+
+  if (gimageP->storage == GI_TILED) {
+    /* tileCopy does not modify the row when copying to tiles */
+    tileCopy(gimageP, 0, inY, gimageP->width, (unsigned char *)inRowP, -1);
+  } else {
+    rowbytes = imageRowBytes(gimageP->gitype, gimageP->width);
+    dstP = gimageP->data + (size_t)inY * rowbytes;
+    if (dstP != inRowP) {
+      memcpy(dstP, inRowP, rowbytes);
     }
   }
-  return(gimageP);
+}
+
+
+/********************/
+/* imagePutPixels() */
+/********************/
+void
+imagePutPixels(
+ gImage *gimageP,
+ unsigned int inX,
+ unsigned int inY,
+ unsigned int inNpix,
+ const unsigned char *inPixP)
+{
+unsigned char *dstP = NULL;
+
+  if (gimageP->storage == GI_TILED) {
+    /* tileCopy does not modify the pixels when copying to tiles */
+    tileCopy(gimageP, inX, inY, inNpix, (unsigned char *)inPixP, -1);
+  } else {
+    dstP = gimageP->data
+      + (size_t)inY * imageRowBytes(gimageP->gitype, gimageP->width)
+      + imageRowBytes(gimageP->gitype, inX);
+    memcpy(dstP, inPixP, imageRowBytes(gimageP->gitype, inNpix));
+  }
 }
 
 
@@ -139,8 +658,21 @@ gImage *gimageP = NULL;
 void
 freeImageData(gImage *gimageP)
 {
+  if (gimageP->tileclose != NULL) {
+    gimageP->tileclose(gimageP->tilectx);
+    gimageP->tileclose = NULL;
+    gimageP->tilectx = NULL;
+  }
+  if (gimageP->tilestate != NULL) {
+    free(gimageP->tilestate);
+    gimageP->tilestate = NULL;
+  }
   if (gimageP->data != NULL) {
-    free(gimageP->data);
+    if (gimageP->storage == GI_TILED) {
+      munmap(gimageP->data, gimageP->mapbytes);
+    } else {
+      free(gimageP->data);
+    }
     gimageP->data = NULL;
   }
 }
@@ -157,4 +689,3 @@ freeImage(gImage *gimageP)
     free(gimageP);
   }
 }
-
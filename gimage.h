@@ -17,6 +17,8 @@
  * \#include "gimage.h"
  */
 
+#include <stddef.h> /* size_t */
+
 
 /* defines */
 /*  change to enum? */
@@ -24,12 +26,20 @@
 #define IBITMAP (1)
 #define IRGB24 (2)
 #define IRGB48 (3)
+#define IRGBF32 (4) /* linear light RGB, 3 floats per pixel, not encoded */
+
+/* storage of data */
+#define GI_LINEAR (0) /* rows one after another, in malloc'd memory */
+#define GI_TILED  (1) /* square tiles, in a memory-mapped temp file */
+
+/* default tile width and height in pixels (multiple of 8) */
+#define GI_TILEDIM (256)
 
 /* custom generic 'gImage' structure */
 
 typedef struct gimage_struct {
- unsigned int   gitype;     /* type of gimage: IBITMAP IRGB24 IRGB48 */
- unsigned int   depth;      /* depth: bitmap 1, color 24 or 48 */
+ unsigned int   gitype;     /* type of gimage: IBITMAP IRGB24 IRGB48 IRGBF32 */
+ unsigned int   depth;      /* depth: bitmap 1, color 24, 48 or 96 */
  unsigned int   width;      /* width in pixels */
  unsigned int   height;     /* height in pixels */
  float          gamma;      /* gamma correction */
@@ -37,6 +47,22 @@ typedef struct gimage_struct {
  char           background[256]; /* color string for bitmap background */
  char           foreground[256]; /* color string for bitmap foreground */
  unsigned char *data;       /* data */
+ /* tiled storage, only used if storage is GI_TILED */
+ /*  data is then tiles, row-major by tile, each tile row-major */
+ /*  use imageTile(), imageRowP() and imagePutRow() to access */
+ /*  tiles read on demand (tilestate not NULL) come from tiled TIFF */
+ /*  files, orientLazy() and zoomLazy(); a PNG is decoded whole, its */
+ /*  rows can only be had in order.  such an image is for one thread */
+ /*  at a time: imageTile() updates tilestate and tileread may share */
+ /*  a decoder in tilectx, with no lock.  see pyrNew() */
+ unsigned int   storage;    /* GI_LINEAR or GI_TILED */
+ unsigned int   tiledim;    /* tile width and height in pixels */
+ size_t         mapbytes;   /* bytes mapped at data */
+ unsigned char *tilestate;  /* per tile, 0 if not yet read; NULL if all read */
+ int          (*tileread)(struct gimage_struct *, unsigned int, unsigned int,
+                unsigned char *); /* fill tile tx,ty at pointer, 0 ok */
+ void         (*tileclose)(void *);
+ void          *tilectx;    /* private data of tileread and tileclose */
 } gImage;
 
 
@@ -45,14 +71,38 @@ typedef struct gimage_struct {
 #define BITMAPP(IMAGE) ((IMAGE)->gitype == IBITMAP)
 #define RGB24P(IMAGE)  ((IMAGE)->gitype == IRGB24)
 #define RGB48P(IMAGE)  ((IMAGE)->gitype == IRGB48)
+#define RGBF32P(IMAGE) ((IMAGE)->gitype == IRGBF32)
+#define TILEDP(IMAGE)  ((IMAGE)->storage == GI_TILED)
+
 
 
+/* sizes are size_t, so images past 4 GB of data are supported */
+/*  where size_t is 64 bits */
+
+/** imageRowBytes
+ * @ingroup gimage
+ * @param[in] gitype IBITMAP IRGB24 IRGB48 IRGBF32
+ * @param[in] width
+ * @return bytes in one row of data, 0 if bad type or size_t overflow
+ */
+size_t imageRowBytes(unsigned int gitype, unsigned int width);
+
+
+/** imageDataBytes
+ * @ingroup gimage
+ * @param[in] gitype IBITMAP IRGB24 IRGB48 IRGBF32
+ * @param[in] width
+ * @param[in] height
+ * @return bytes in all of data, 0 if bad type or size_t overflow
+ */
+size_t imageDataBytes(unsigned int gitype, unsigned int width, unsigned int height);
+
 
 /** newBitImage
  * @ingroup gimage
  * @param[in] width
  * @param[in] height
- * @return new gImage
+ * @return new gImage, or NULL if allocation fails or size overflows
  */
 gImage* newBitImage(unsigned int width, unsigned int height);
 
@@ -75,6 +125,171 @@ gImage* newRGB24Image(unsigned int width, unsigned int height);
 gImage* newRGB48Image(unsigned int width, unsigned int height);
 
 
+/** newRGBF32Image
+ * @ingroup gimage
+ * @param[in] width
+ * @param[in] height
+ * @return new gImage, all pixels 0.0
+ *
+ * linear light float pixels, for chains of transforms that should
+ * only be encoded to sRGB once, see csLinearImage() and csEncodeImage()
+ */
+gImage* newRGBF32Image(unsigned int width, unsigned int height);
+
+
+/* uninitialized variants */
+/*  data is NOT zero filled, for loaders that write every byte */
+/*  bitmap code that ORs bits into data must use the zeroed versions */
+
+/** newBitImageUninit
+ * @ingroup gimage
+ * @param[in] width
+ * @param[in] height
+ * @return new gImage, data contents undefined
+ */
+gImage* newBitImageUninit(unsigned int width, unsigned int height);
+
+
+/** newRGB24ImageUninit
+ * @ingroup gimage
+ * @param[in] width
+ * @param[in] height
+ * @return new gImage, data contents undefined
+ */
+gImage* newRGB24ImageUninit(unsigned int width, unsigned int height);
+
+
+/** newRGB48ImageUninit
+ * @ingroup gimage
+ * @param[in] width
+ * @param[in] height
+ * @return new gImage, data contents undefined
+ */
+gImage* newRGB48ImageUninit(unsigned int width, unsigned int height);
+
+
+/** newRGBF32ImageUninit
+ * @ingroup gimage
+ * @param[in] width
+ * @param[in] height
+ * @return new gImage, data contents undefined
+ */
+gImage* newRGBF32ImageUninit(unsigned int width, unsigned int height);
+
+
+/* tiled, out-of-core images */
+/*  pixel data lives in an unlinked temp file under $TMPDIR that is */
+/*  memory mapped, so the kernel pages tiles in and out as needed */
+/*  only IRGB24, IRGB48 and IRGBF32 may be tiled */
+
+/** setImageMemoryLimit
+ * @ingroup gimage
+ * @param[in] bytes largest data kept in memory, 0 to restore the default
+ *
+ * images larger than this should be created with newLargeImage().
+ * default is half of physical memory.
+ */
+void setImageMemoryLimit(size_t bytes);
+
+
+/** imageMemoryLimit
+ * @ingroup gimage
+ * @return largest data kept in memory, see setImageMemoryLimit()
+ */
+size_t imageMemoryLimit(void);
+
+
+/** imageBytesAllocated
+ * @ingroup gimage
+ * @return data bytes of all the images made so far by the calling
+ * thread, tiled ones included; never decreases
+ */
+size_t imageBytesAllocated(void);
+
+
+/** imageWantsTiles
+ * @ingroup gimage
+ * @param[in] gitype
+ * @param[in] width
+ * @param[in] height
+ * @return -1 (true) if the data would exceed the memory limit, else 0
+ */
+int imageWantsTiles(unsigned int gitype, unsigned int width, unsigned int height);
+
+
+/** newTiledImage
+ * @ingroup gimage
+ * @param[in] gitype IRGB24, IRGB48 or IRGBF32
+ * @param[in] width
+ * @param[in] height
+ * @param[in] tiledim tile width and height, multiple of 8, 0 for default
+ * @return new tiled gImage, data contents undefined
+ */
+gImage* newTiledImage(unsigned int gitype, unsigned int width, unsigned int height, unsigned int tiledim);
+
+
+/** newLargeImage
+ * @ingroup gimage
+ * @param[in] gitype IRGB24, IRGB48 or IRGBF32
+ * @param[in] width
+ * @param[in] height
+ * @return new gImage, data contents undefined;
+ *  tiled if imageWantsTiles(), else linear
+ */
+gImage* newLargeImage(unsigned int gitype, unsigned int width, unsigned int height);
+
+
+/** imageTile
+ * @ingroup gimage
+ * @param[in] gimageP tiled gImage
+ * @param[in] tx tile column
+ * @param[in] ty tile row
+ * @return pointer to the tile, reading it first if necessary,
+ *  or NULL if the tile could not be read.
+ *  tile rows are imageRowBytes(gitype, tiledim) apart.
+ */
+unsigned char* imageTile(gImage *gimageP, unsigned int tx, unsigned int ty);
+
+
+/** imageRowP
+ * @ingroup gimage
+ * @param[in] gimageP
+ * @param[in] x first pixel (multiple of 8 for IBITMAP)
+ * @param[in] y row
+ * @param[in] npix number of pixels
+ * @param[in] scratchP buffer of at least imageRowBytes(gitype, npix)
+ * @return pointer to the pixels: into data if linear, else scratchP
+ *
+ * works for both GI_LINEAR and GI_TILED
+ */
+unsigned char* imageRowP(gImage *gimageP, unsigned int x, unsigned int y, unsigned int npix, unsigned char *scratchP);
+
+
+/** imagePutRow
+ * @ingroup gimage
+ * @param[in,out] gimageP
+ * @param[in] y row
+ * @param[in] rowP a full row of pixels
+ *
+ * store a row, which may have been filled in place through imageRowP().
+ * no-op if rowP already is the row in data.
+ */
+void imagePutRow(gImage *gimageP, unsigned int y, const unsigned char *rowP);
+
+
+/** imagePutPixels
+ * @ingroup gimage
+ * @param[in,out] gimageP IRGB24, IRGB48 or IRGBF32
+ * @param[in] x first pixel
+ * @param[in] y row
+ * @param[in] npix number of pixels
+ * @param[in] pixP the pixels
+ *
+ * store part of a row, works for both GI_LINEAR and GI_TILED
+ */
+void imagePutPixels(gImage *gimageP, unsigned int x, unsigned int y, unsigned int npix, const unsigned char *pixP);
+
+
 /** freeImageData
  * @ingroup gimage
  * @param[in] gimageP
@@ -18,7 +18,8 @@
 
 #include "options.h"     /* declarations, consistency */
 
-#include "fileformats.h" /* supportedFormats() */
+#include "fileformats.h" /* supportedFormats(), outputExtension() */
+#include "transforms/rotate.h" /* FLIP_HORIZONTAL, FLIP_VERTICAL */
 #include "usageHelp.h"   /* usageHelp */
 
 
@@ -30,6 +31,13 @@ static OptionArray Options[] = {
 
   /* global options */
 
+  { "cachelimit", CACHELIMIT, "megabytes", "\
+Keep contact sheet thumbnails in a cache under $XDG_CACHE_HOME of at most\n\
+this size, least recently used removed first.  0 turns the cache off.\n\
+Default is 256.", },
+  { "contact",    CONTACT,    "pixels", "\
+Show all the images as thumbnails of this size in one contact sheet, and\n\
+click on one to view it.", },
   { "display",    DISPLAY,    "display_string", "\
 Indicate the X display you would like to use.", },
   { "fork",       FORK,       NULL, "\
@@ -41,12 +49,32 @@ Specify the size of the display window.  Ignored if -fullscreen is given.", },
   { "help",       HELP,       "[option ...]", "\
 Give help on a particular option or series of options.  If no option is\n\
 supplied, a list of available options is given.", },
+  { "keys",       KEYS,       "file|keys", "\
+Keys to act on, in order, for a build without a display (xopenimage-headless).\n\
+A file of keys, or the keys themselves: n, p, space, <, > and q,\n\
+and cX,Y to click at X,Y on a contact sheet.", },
+  { "memlimit",   MEMLIMIT,   "megabytes", "\
+Images with more pixel data than this are kept in tiles in a memory mapped\n\
+temporary file instead of in memory.  Default is half of physical memory.", },
+  { "outformat",  OUTFORMAT,  "ppm|png|jpeg", "\
+File format of images written with -output.  Default is ppm.", },
+  { "output",     OUTPUT,     "directory", "\
+Write each image, after its options, to this directory instead of\n\
+displaying it.  Images are converted in parallel, one per processor.\n\
+Nothing is written if two images would go to the same file.", },
+  { "profile",    PROFILE,    "file|-", "\
+Time each stage of loading, processing and showing images, and write one\n\
+JSON object per stage to file, or a summary to standard output for -.", },
   { "quiet",      QUIET,      NULL, "\
 Turn off verbose mode.", },
   { "shrink",      SHRINKTOFIT, NULL, "\
 Shrink an image larger than screen to fit.", }, 
   { "supported",  SUPPORTED,  NULL, "\
 Give a list of the supported file formats.", },
+  { "trace",      TRACE,      "file", "\
+Record when each stage of each image runs, per thread, and write them to\n\
+file at exit in the Chrome trace_event format, for Perfetto or\n\
+chrome://tracing.", },
   { "verbose",    VERBOSE,    NULL, "\
 Turn on verbose mode.", },
   { "version",    VER_NUM,    NULL, "\
@@ -57,6 +85,8 @@ Show the version number of this version of xopenimage.", },
   { "background", BACKGROUND, "color", "\
 Set the background pixel color for a monochrome image.  See -foreground and\n\
 -invert.", },
+  { "flip",       FLIP,       "horizontal|vertical", "\
+Mirror the image left to right (horizontal) or top to bottom (vertical).", },
   { "foreground", FOREGROUND, "color", "\
 Set the foreground pixel color for a monochrome image.  See -background and\n\
 -invert.", },
@@ -538,6 +568,28 @@ int global_opt = 0;
 
     /* process options global to everything */
 
+     case CACHELIMIT:
+      if (++i >= argc) {
+        optionUsage(CACHELIMIT);
+      }
+      newopt->info.cachelimit = getInteger(CACHELIMIT, argv[i]);
+      if ((int)newopt->info.cachelimit < 0) {
+        optionUsage(CACHELIMIT);
+      }
+      global_opt = 1;
+      break;
+
+     case CONTACT:
+      if (++i >= argc) {
+        optionUsage(CONTACT);
+      }
+      newopt->info.contact = getInteger(CONTACT, argv[i]);
+      if ((int)newopt->info.contact <= 0) {
+        optionUsage(CONTACT);
+      }
+      global_opt = 1;
+      break;
+
      case DISPLAY:
       if (++i >= argc) {
         optionUsage(DISPLAY);
@@ -586,6 +638,52 @@ int global_opt = 0;
       }
       exit(EXIT_SUCCESS);
 
+     case KEYS:
+      if (++i >= argc) {
+        optionUsage(KEYS);
+      }
+      newopt->info.keys = argv[i];
+      global_opt = 1;
+      break;
+
+     case MEMLIMIT:
+      if (++i >= argc) {
+        optionUsage(MEMLIMIT);
+      }
+      newopt->info.memlimit = getInteger(MEMLIMIT, argv[i]);
+      if ((int)newopt->info.memlimit <= 0) {
+        optionUsage(MEMLIMIT);
+      }
+      global_opt = 1;
+      break;
+
+     case OUTFORMAT:
+      if (++i >= argc) {
+        optionUsage(OUTFORMAT);
+      }
+      if (outputExtension(argv[i]) == NULL) {
+        optionUsage(OUTFORMAT);
+      }
+      newopt->info.outformat = argv[i];
+      global_opt = 1;
+      break;
+
+     case OUTPUT:
+      if (++i >= argc) {
+        optionUsage(OUTPUT);
+      }
+      newopt->info.output = argv[i];
+      global_opt = 1;
+      break;
+
+     case PROFILE:
+      if (++i >= argc) {
+        optionUsage(PROFILE);
+      }
+      newopt->info.profile = argv[i];
+      global_opt = 1;
+      break;
+
      case QUIET:
       killOption(global_options, VERBOSE);
       global_opt = 1;
@@ -599,6 +697,14 @@ int global_opt = 0;
       supportedFormats();
       exit(EXIT_SUCCESS);
 
+     case TRACE:
+      if (++i >= argc) {
+        optionUsage(TRACE);
+      }
+      newopt->info.trace = argv[i];
+      global_opt = 1;
+      break;
+
      case VERBOSE:
       global_opt = 1;
       break;
@@ -616,6 +722,21 @@ int global_opt = 0;
       newopt->info.background = argv[i];
       break;
 
+     case FLIP:
+      if (++i >= argc) {
+        optionUsage(FLIP);
+      }
+      if (argv[i][0] == 'h' || argv[i][0] == 'H') {
+        newopt->info.flip = FLIP_HORIZONTAL;
+      } else if (argv[i][0] == 'v' || argv[i][0] == 'V') {
+        newopt->info.flip = FLIP_VERTICAL;
+      } else {
+        fprintf(stderr, "Argument to %s must be horizontal or vertical (ignored)\n",
+                optionName(FLIP));
+        newopt->type= OPT_IGNORE;
+      }
+      break;
+
      case FOREGROUND:
       if (++i >= argc) {
         optionUsage(FOREGROUND);
@@ -28,12 +28,13 @@ typedef enum option_id {
   /* global options */
 
   OPT_NOTOPT= 0, OPT_BADOPT, OPT_SHORTOPT, OPT_IGNORE,
-  DISPLAY, FORK, FULLSCREEN, GEOMETRY, HELP, QUIET,
-  SHRINKTOFIT, SUPPORTED, VERBOSE, VER_NUM,
+  CACHELIMIT, CONTACT, DISPLAY, FORK, FULLSCREEN, GEOMETRY, HELP, KEYS, MEMLIMIT,
+  OUTFORMAT, OUTPUT, PROFILE, QUIET,
+  SHRINKTOFIT, SUPPORTED, TRACE, VERBOSE, VER_NUM,
 
   /* local options */
 
-  BACKGROUND, FOREGROUND, FORMAT, GAMMA, GLOBAL, GOTO,
+  BACKGROUND, FLIP, FOREGROUND, FORMAT, GAMMA, GLOBAL, GOTO,
   INVERT, NAME, ROTATE, TITLE, XZOOM, YZOOM, ZOOM
 } OptionId;
 
@@ -47,7 +48,10 @@ typedef struct option {
       unsigned int x, y;      /* location to load image at */
     } at;
     char         *background; /* background color for mono images */
+    unsigned int  cachelimit; /* megabytes of thumbnail cache, 0 for none */
+    unsigned int  contact;    /* contact sheet cell size, pixels */
     char         *display;    /* display name */
+    unsigned int  flip;       /* FLIP_HORIZONTAL or FLIP_VERTICAL */
     char         *foreground; /* foreground color for mono images */
     char         *format_id;  /* file format of image */
     float         gamma;      /* gamma value */
@@ -57,9 +61,15 @@ typedef struct option {
       unsigned int h;
     } geometry;
     char         *go_to;      /* label to go to */
+    char         *keys;       /* key script file, or the keys */
+    unsigned int  memlimit;   /* megabytes of image data before tiling */
     char         *name;       /* name of image */
+    char         *outformat;  /* format_id of written images */
+    char         *output;     /* directory to write images to */
+    char         *profile;    /* timing file, "-" for a summary */
     unsigned int  rotate;     /* # of degrees to rotate image */
     char         *title;      /* title of image */
+    char         *trace;      /* Chrome trace file */
     struct {
       unsigned int x, y;      /* zoom factors */
     } zoom;
@@ -0,0 +1,593 @@
+/* profile.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+/* each span is one JSON object on its own line: */
+/*  {"type":"span","stage":"decode","name":"a.jpg","thread":1, */
+/*   "start_ms":12.345,"ms":80.123,"bytes":9000000,"maxrss_kb":51200} */
+/*  start_ms is from profileOpen(), threads are numbered from 1 in */
+/*  the order they first end a span.  at exit a "stage" line for */
+/*  each stage gives its totals, then a "process" line the peak */
+/*  resident size */
+
+/* a trace keeps the same spans as Chrome trace_event "X" (complete) */
+/*  events, in a ring per thread that only its thread writes: the */
+/*  head is published with a release store and read at exit with an */
+/*  acquire load, so recording takes no lock.  a full ring keeps the */
+/*  latest TRACE_EVENTS of its thread.  when a thread exits its events */
+/*  are copied to a list of just their size, and the ring is kept for */
+/*  the next thread, so short lived threads do not each cost a ring. */
+/*  threads may still be recording while the trace is written at exit: */
+/*  as with a seqlock, an event is written only if its slot was not */
+/*  being reused while it was copied, so the oldest events of a full */
+/*  ring may be dropped, but none is torn */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, getpid, pthreads */
+
+/* Standard C library */
+#include <stdlib.h>    /* atexit, calloc, malloc */
+#include <stdio.h>     /* fopen, fprintf, printf */
+#include <string.h>    /* strcmp, memcpy */
+#include <time.h>      /* clock_gettime */
+#include <stdatomic.h> /* atomic_size_t, trace ring heads */
+
+/* POSIX */
+#include <unistd.h>    /* getpid */
+#include <sys/resource.h> /* getrusage */
+#include <pthread.h>
+
+/* code base */
+#include "gimage.h"    /* imageBytesAllocated */
+
+#include "profile.h"   /* declarations, consistency */
+
+
+/* INTERNAL */
+
+/* most stages totalled, further ones are only in the JSON lines */
+#define PROFILE_STAGES (32)
+
+/* events kept per thread, and the part of a name kept with each */
+#define TRACE_EVENTS  (16384)
+#define TRACE_NAMELEN (64)
+
+/* totals of one stage */
+struct stage_struct {
+ const char *stage;
+ unsigned long count;
+ double      ms;
+ double      maxms;
+ size_t      bytes;
+};
+
+static pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+static int   ProfileOn = 0;        /* -1 (true) once profileOpen() */
+static FILE *ProfileFile = NULL;   /* JSON lines, NULL for a summary */
+static struct timespec ProfileStart;
+static struct stage_struct Stages[PROFILE_STAGES];
+static unsigned int NStages = 0;
+static unsigned int NThreads = 0;
+static _Thread_local unsigned int ThreadNumber = 0; /* 0 until numbered */
+
+/* one span of a trace */
+struct trace_event {
+ const char *stage;
+ char        name[TRACE_NAMELEN]; /* "" if none */
+ double      ts;    /* microseconds from profileOpen() or traceOpen() */
+ double      dur;   /* microseconds */
+ size_t      bytes;
+};
+
+/* the events of one thread */
+struct trace_ring {
+ struct trace_ring *next;   /* in Rings or FreeRings, under profileLock */
+ unsigned int       thread;
+ char               tname[32];
+ atomic_size_t      head;   /* events recorded, ever */
+ struct trace_event events[TRACE_EVENTS];
+};
+
+/* the events of a thread that has exited, oldest first */
+struct trace_done {
+ struct trace_done *next;   /* in Done, under profileLock */
+ unsigned int       thread;
+ char               tname[32];
+ size_t             n;
+ struct trace_event events[];
+};
+
+static int   TraceOn = 0;          /* -1 (true) once traceOpen() */
+static FILE *TraceFile = NULL;
+static pthread_key_t TraceKey;     /* the ring, for traceRetire() */
+static struct trace_ring *Rings = NULL;     /* of running threads */
+static struct trace_ring *FreeRings = NULL; /* for the next thread */
+static struct trace_done *Done = NULL;
+static _Thread_local struct trace_ring *ThreadRing = NULL;
+
+
+/* INTERNAL (static) FUNCTIONS */
+
+/*************/
+/* msSince() */
+/*************/
+/* milliseconds from inStartP to inEndP */
+static double
+msSince(
+ const struct timespec *inStartP,
+ const struct timespec *inEndP)
+{
+  return((inEndP->tv_sec - inStartP->tv_sec) * 1000.0 +
+         (inEndP->tv_nsec - inStartP->tv_nsec) / 1000000.0);
+}
+
+
+/************/
+/* maxRSS() */
+/************/
+/* peak resident size of the process, kilobytes */
+static long
+maxRSS(void)
+{
+struct rusage usage;
+long kb = 0;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    kb = usage.ru_maxrss;
+  }
+  return(kb);
+}
+
+
+/*******************/
+/* profileString() */
+/*******************/
+/* a JSON string, with quotes */
+static void
+profileString(
+ FILE *inFP,
+ const char *inStr)
+{
+const unsigned char *cP = NULL;
+
+  fputc('"', inFP);
+  for (cP = (const unsigned char *)inStr; *cP != '\0'; cP++) {
+    if (*cP == '"' || *cP == '\\') {
+      fprintf(inFP, "\\%c", *cP);
+    } else if (*cP < 0x20) {
+      fprintf(inFP, "\\u%04x", *cP);
+    } else {
+      fputc(*cP, inFP);
+    }
+  }
+  fputc('"', inFP);
+}
+
+
+/******************/
+/* threadNumber() */
+/******************/
+/* number of the calling thread, from 1 in order of first use */
+static unsigned int
+threadNumber(void)
+{
+  if (ThreadNumber == 0) {
+    pthread_mutex_lock(&profileLock);
+    ThreadNumber = ++NThreads;
+    pthread_mutex_unlock(&profileLock);
+  }
+  return(ThreadNumber);
+}
+
+
+/***************/
+/* traceRing() */
+/***************/
+/* ring of the calling thread, on first use one a thread that has */
+/*  exited left, or a new one.  NULL if no memory */
+/*  inName names the thread, NULL for "thread N" */
+static struct trace_ring*
+traceRing(
+ const char *inName)
+{
+struct trace_ring *ringP = ThreadRing;
+unsigned int thread;
+
+  if (ringP == NULL) {
+    thread = threadNumber();
+    pthread_mutex_lock(&profileLock);
+    ringP = FreeRings;
+    if (ringP != NULL) {
+      FreeRings = ringP->next;
+    } else {
+      ringP = calloc(1, sizeof(struct trace_ring));
+    }
+    if (ringP != NULL) {
+      ringP->thread = thread;
+      memset(ringP->tname, 0, sizeof(ringP->tname));
+      if (inName != NULL) {
+        strncpy(ringP->tname, inName, sizeof(ringP->tname) - 1);
+      } else {
+        snprintf(ringP->tname, sizeof(ringP->tname), "thread %u", thread);
+      }
+      atomic_init(&ringP->head, 0);
+      ringP->next = Rings;
+      Rings = ringP;
+    }
+    pthread_mutex_unlock(&profileLock);
+    if (ringP != NULL) {
+      ThreadRing = ringP;
+      pthread_setspecific(TraceKey, ringP);
+    }
+  }
+  return(ringP);
+}
+
+
+/*****************/
+/* traceRetire() */
+/*****************/
+/* thread exit: the ring's events to Done, the ring to FreeRings */
+/*  if there is no memory for the copy, the ring itself is kept */
+static void
+traceRetire(
+ void *inRingP)
+{
+struct trace_ring *ringP = inRingP;
+struct trace_ring **linkPP = NULL;
+struct trace_done *doneP = NULL;
+size_t head;
+size_t first;
+size_t i;
+
+  ThreadRing = NULL;
+  head = atomic_load_explicit(&ringP->head, memory_order_relaxed);
+  first = (head > TRACE_EVENTS ? head - TRACE_EVENTS : 0);
+  doneP = malloc(sizeof(struct trace_done) +
+    (head - first) * sizeof(struct trace_event));
+  if (doneP != NULL) {
+    doneP->thread = ringP->thread;
+    doneP->n = head - first;
+    for (i = first; i < head; i++) {
+      doneP->events[i - first] = ringP->events[i % TRACE_EVENTS];
+    }
+
+    pthread_mutex_lock(&profileLock);
+    /* the name may have been set by profileThreadName() under the lock */
+    memcpy(doneP->tname, ringP->tname, sizeof(doneP->tname));
+    doneP->next = Done;
+    Done = doneP;
+    linkPP = &Rings;
+    while (*linkPP != ringP) {
+      linkPP = &(*linkPP)->next;
+    }
+    *linkPP = ringP->next;
+    ringP->next = FreeRings;
+    FreeRings = ringP;
+    pthread_mutex_unlock(&profileLock);
+  }
+}
+
+
+/****************/
+/* traceEvent() */
+/****************/
+/* one event of a trace, after those before it */
+static void
+traceEvent(
+ long inPid,
+ unsigned int inThread,
+ const struct trace_event *eP)
+{
+  fprintf(TraceFile, ",\n{\"name\":");
+  profileString(TraceFile, eP->stage);
+  fprintf(TraceFile, ",\"cat\":\"xopenimage\",\"ph\":\"X\","
+    "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%u,"
+    "\"args\":{\"name\":", eP->ts, eP->dur, inPid, inThread);
+  profileString(TraceFile, eP->name);
+  fprintf(TraceFile, ",\"bytes\":%zu}}", eP->bytes);
+}
+
+
+/*********************/
+/* traceThreadName() */
+/*********************/
+/* the name of a thread in a trace, after the events before it */
+static void
+traceThreadName(
+ long inPid,
+ unsigned int inThread,
+ const char *inName)
+{
+  fprintf(TraceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+    "\"pid\":%ld,\"tid\":%u,\"args\":{\"name\":", inPid, inThread);
+  profileString(TraceFile, inName);
+  fprintf(TraceFile, "}}");
+}
+
+
+/*****************/
+/* traceRecord() */
+/*****************/
+/* one event in the calling thread's ring, no lock */
+static void
+traceRecord(
+ const ProfileSpan *inSpanP,
+ const struct timespec *inEndP,
+ const char *inStage,
+ const char *inName,
+ size_t inBytes)
+{
+struct trace_ring *ringP = NULL;
+struct trace_event *eP = NULL;
+size_t head;
+
+  ringP = traceRing(NULL);
+  if (ringP != NULL) {
+    head = atomic_load_explicit(&ringP->head, memory_order_relaxed);
+    eP = &ringP->events[head % TRACE_EVENTS];
+    /* head, published before this slot is overwritten, see traceClose() */
+    atomic_thread_fence(memory_order_release);
+    eP->stage = inStage;
+    eP->name[0] = '\0';
+    if (inName != NULL) {
+      strncpy(eP->name, inName, TRACE_NAMELEN - 1);
+      eP->name[TRACE_NAMELEN - 1] = '\0';
+    }
+    eP->ts = msSince(&ProfileStart, &inSpanP->start) * 1000.0;
+    eP->dur = msSince(&inSpanP->start, inEndP) * 1000.0;
+    eP->bytes = inBytes;
+    atomic_store_explicit(&ringP->head, head + 1, memory_order_release);
+  }
+}
+
+
+/****************/
+/* traceClose() */
+/****************/
+/* atexit: every ring, and the events of threads that have exited, */
+/*  as a Chrome trace_event JSON file */
+static void
+traceClose(void)
+{
+struct trace_ring *ringP = NULL;
+struct trace_done *doneP = NULL;
+struct trace_event event;
+size_t head;
+size_t i;
+long pid;
+
+  pid = (long)getpid();
+  pthread_mutex_lock(&profileLock);
+  fprintf(TraceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(TraceFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,"
+    "\"tid\":0,\"args\":{\"name\":\"xopenimage\"}}", pid);
+  for (ringP = Rings; ringP != NULL; ringP = ringP->next) {
+    traceThreadName(pid, ringP->thread, ringP->tname);
+    head = atomic_load_explicit(&ringP->head, memory_order_acquire);
+    for (i = (head > TRACE_EVENTS ? head - TRACE_EVENTS : 0); i < head; i++) {
+      /* the thread may still be recording: event i is whole only if */
+      /*  event i + TRACE_EVENTS, in the same slot, was not begun */
+      event = ringP->events[i % TRACE_EVENTS];
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&ringP->head, memory_order_relaxed) <
+          i + TRACE_EVENTS) {
+        traceEvent(pid, ringP->thread, &event);
+      }
+    }
+  }
+  for (doneP = Done; doneP != NULL; doneP = doneP->next) {
+    traceThreadName(pid, doneP->thread, doneP->tname);
+    for (i = 0; i < doneP->n; i++) {
+      traceEvent(pid, doneP->thread, &doneP->events[i]);
+    }
+  }
+  fprintf(TraceFile, "\n]}\n");
+  fclose(TraceFile);
+  TraceFile = NULL;
+  pthread_mutex_unlock(&profileLock);
+}
+
+
+/******************/
+/* profileClose() */
+/******************/
+/* atexit: stage totals and peak resident size */
+static void
+profileClose(void)
+{
+unsigned int i;
+
+  pthread_mutex_lock(&profileLock);
+  if (ProfileFile != NULL) {
+    for (i = 0; i < NStages; i++) {
+      fprintf(ProfileFile, "{\"type\":\"stage\",\"stage\":");
+      profileString(ProfileFile, Stages[i].stage);
+      fprintf(ProfileFile, ",\"count\":%lu,\"ms\":%.3f,\"max_ms\":%.3f,"
+        "\"bytes\":%zu}\n", Stages[i].count, Stages[i].ms, Stages[i].maxms,
+        Stages[i].bytes);
+    }
+    fprintf(ProfileFile, "{\"type\":\"process\",\"threads\":%u,"
+      "\"maxrss_kb\":%ld}\n", NThreads, maxRSS());
+    fclose(ProfileFile);
+    ProfileFile = NULL;
+  } else if (ProfileOn) {
+    printf("%-12s %8s %12s %12s %12s\n", "stage", "count", "total ms",
+      "max ms", "image MB");
+    for (i = 0; i < NStages; i++) {
+      printf("%-12s %8lu %12.3f %12.3f %12.3f\n", Stages[i].stage,
+        Stages[i].count, Stages[i].ms, Stages[i].maxms,
+        Stages[i].bytes / (1024.0 * 1024.0));
+    }
+    printf("peak resident size %ld kB, %u threads\n", maxRSS(), NThreads);
+  }
+  pthread_mutex_unlock(&profileLock);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/*****************/
+/* profileOpen() */
+/*****************/
+int
+profileOpen(
+ const char *filename)
+{
+int status = 0;
+
+  if (strcmp(filename, "-") != 0) {
+    ProfileFile = fopen(filename, "w");
+    if (ProfileFile == NULL) {
+      perror(filename);
+      status = (-1);
+    }
+  }
+  if (status == 0) {
+    if (!TraceOn) {
+      clock_gettime(CLOCK_MONOTONIC, &ProfileStart);
+    }
+    ProfileOn = -1;
+    atexit(profileClose);
+  }
+  return(status);
+}
+
+
+/***************/
+/* traceOpen() */
+/***************/
+int
+traceOpen(
+ const char *filename)
+{
+int status = 0;
+
+  TraceFile = fopen(filename, "w");
+  if (TraceFile == NULL) {
+    perror(filename);
+    status = (-1);
+  } else {
+    if (!ProfileOn) {
+      clock_gettime(CLOCK_MONOTONIC, &ProfileStart);
+    }
+    pthread_key_create(&TraceKey, traceRetire);
+    TraceOn = -1;
+    atexit(traceClose);
+  }
+  return(status);
+}
+
+
+/***************/
+/* profileOn() */
+/***************/
+int
+profileOn(void)
+{
+  return(ProfileOn || TraceOn ? -1 : 0);
+}
+
+
+/***********************/
+/* profileThreadName() */
+/***********************/
+void
+profileThreadName(
+ const char *name)
+{
+struct trace_ring *ringP = NULL;
+
+  if (TraceOn && ThreadRing == NULL) {
+    traceRing(name);
+  } else if (TraceOn) {
+    /* traceClose() may be reading it */
+    ringP = ThreadRing;
+    pthread_mutex_lock(&profileLock);
+    strncpy(ringP->tname, name, sizeof(ringP->tname) - 1);
+    pthread_mutex_unlock(&profileLock);
+  }
+}
+
+
+/******************/
+/* profileBegin() */
+/******************/
+void
+profileBegin(
+ ProfileSpan *spanP)
+{
+  if (ProfileOn || TraceOn) {
+    spanP->bytes = imageBytesAllocated();
+    clock_gettime(CLOCK_MONOTONIC, &spanP->start);
+  }
+}
+
+
+/****************/
+/* profileEnd() */
+/****************/
+void
+profileEnd(
+ ProfileSpan *spanP,
+ const char *stage,
+ const char *name)
+{
+struct timespec end;
+double ms = 0.0;
+size_t bytes = 0;
+long kb;
+unsigned int i;
+
+  if (ProfileOn || TraceOn) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ms = msSince(&spanP->start, &end);
+    bytes = imageBytesAllocated() - spanP->bytes;
+  }
+  if (TraceOn) {
+    traceRecord(spanP, &end, stage, name, bytes);
+  }
+
+  if (ProfileOn) {
+    kb = maxRSS();
+
+    pthread_mutex_lock(&profileLock);
+    if (ThreadNumber == 0) {
+      ThreadNumber = ++NThreads;
+    }
+
+    for (i = 0; i < NStages && strcmp(Stages[i].stage, stage) != 0; i++) {
+      ;
+    }
+    if (i == NStages && NStages < PROFILE_STAGES) {
+      Stages[i].stage = stage;
+      NStages++;
+    }
+    if (i < NStages) {
+      Stages[i].count++;
+      Stages[i].ms += ms;
+      if (ms > Stages[i].maxms) {
+        Stages[i].maxms = ms;
+      }
+      Stages[i].bytes += bytes;
+    }
+
+    if (ProfileFile != NULL) {
+      fprintf(ProfileFile, "{\"type\":\"span\",\"stage\":");
+      profileString(ProfileFile, stage);
+      if (name != NULL) {
+        fprintf(ProfileFile, ",\"name\":");
+        profileString(ProfileFile, name);
+      }
+      fprintf(ProfileFile, ",\"thread\":%u,\"start_ms\":%.3f,\"ms\":%.3f,"
+        "\"bytes\":%zu,\"maxrss_kb\":%ld}\n", ThreadNumber,
+        msSince(&ProfileStart, &spanP->start), ms, bytes, kb);
+    }
+    pthread_mutex_unlock(&profileLock);
+  }
+}
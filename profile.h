@@ -0,0 +1,90 @@
+/* profile.h */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+#ifndef profile_h
+#define profile_h
+
+/**
+ * @defgroup profile  timing of stages
+ * spans of monotonic time around the stages of loading, processing
+ * and showing an image, with the image data each one allocated
+ *
+ * \#include "profile.h"
+ */
+
+#include <stddef.h> /* size_t */
+#include <time.h>   /* struct timespec */
+
+
+/* one timed stage, on the stack of the code being timed */
+typedef struct profile_span {
+ struct timespec start;
+ size_t          bytes; /* imageBytesAllocated() at the start */
+} ProfileSpan;
+
+
+/** profileOpen
+ * @ingroup profile
+ * @param[in] filename JSON lines written here, or "-" for a summary
+ * on standard output
+ * @return 0, or -1 if the file cannot be written
+ *
+ * turns profiling on; the summary and totals are written at exit
+ */
+int profileOpen(const char *filename);
+
+
+/** traceOpen
+ * @ingroup profile
+ * @param[in] filename Chrome trace_event JSON written here at exit
+ * @return 0, or -1 if the file cannot be written
+ *
+ * turns tracing on: every span is kept, per thread, for viewing
+ * in Perfetto or chrome://tracing.  may be used with profileOpen()
+ */
+int traceOpen(const char *filename);
+
+
+/** profileOn
+ * @ingroup profile
+ * @return -1 (true) if profileOpen() or traceOpen() was called
+ */
+int profileOn(void);
+
+
+/** profileThreadName
+ * @ingroup profile
+ * @param[in] name what the calling thread does, for the trace
+ */
+void profileThreadName(const char *name);
+
+
+/** profileBegin
+ * @ingroup profile
+ * @param[out] spanP span to start
+ *
+ * nothing is done unless profiling or tracing.  safe from any thread.
+ */
+void profileBegin(ProfileSpan *spanP);
+
+
+/** profileEnd
+ * @ingroup profile
+ * @param[in] spanP span started with profileBegin(), same thread
+ * @param[in] stage name of the stage, a string constant
+ * @param[in] name file or image the stage worked on, may be NULL
+ *
+ * records the time since profileBegin(), the image data allocated by
+ * this thread meanwhile, and the peak resident size of the process
+ */
+void profileEnd(ProfileSpan *spanP, const char *stage, const char *name);
+
+
+#endif
@@ -0,0 +1,561 @@
+/* thumbcache.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+/* thumbnails are kept one per file, named by a hash of the key: */
+/*  source path, size, modification time and the size asked for */
+/*  each file is a struct cache_header, the source path, then the */
+/*  image data at an 8 byte boundary, as in memory, so a file is */
+/*  mapped and copied once.  files are in host byte order. */
+/*  a file's own modification time is when it was last used, */
+/*  the oldest are removed first when the cache is over its limit. */
+/*  temporary files an interrupted store left are removed once they */
+/*  are CACHE_TMP_AGE old */
+
+#define _XOPEN_SOURCE 700 /* realpath, mkstemp, futimens, pthreads */
+
+/* Standard C library */
+#include <stdlib.h>    /* malloc, free, getenv, realpath, mkstemp, qsort */
+#include <stdio.h>     /* printf, fprintf, snprintf */
+#include <string.h>    /* memcpy, memcmp, memset, strlen */
+#include <stdint.h>    /* uint32_t, uint64_t, int64_t */
+#include <errno.h>     /* errno, EEXIST */
+#include <time.h>      /* time */
+
+/* POSIX */
+#include <unistd.h>    /* close, write, unlink */
+#include <fcntl.h>     /* open */
+#include <dirent.h>    /* opendir, readdir */
+#include <sys/stat.h>  /* stat, fstat, mkdir, futimens */
+#include <sys/mman.h>  /* mmap, munmap */
+#include <pthread.h>
+
+/* code base */
+#include "gimage.h"     /* 'gImage' struct */
+
+#include "thumbcache.h" /* declarations, consistency */
+
+
+/* INTERNAL */
+
+#define CACHE_MAGIC   "XOITHMB1"
+#define CACHE_SUFFIX  ".thm"
+#define CACHE_TMP     "tmp."
+#define CACHE_SUBDIR  "xopenimage"
+
+/* over the limit, thumbnails are removed down to this fraction */
+/*  of it, so a full cache is not scanned for every store */
+#define CACHE_LOW(limit) ((limit) / 4 * 3)
+
+/* seconds after which a temporary file is taken to be left over, */
+/*  not one another process is still writing */
+#define CACHE_TMP_AGE (3600)
+
+struct cache_header {
+ char     magic[8];   /* CACHE_MAGIC */
+ uint32_t gitype;     /* IBITMAP, IRGB24 or IRGB48 */
+ uint32_t width;
+ uint32_t height;
+ uint32_t maxdim;     /* key: size asked for */
+ uint64_t size;       /* key: source file size */
+ int64_t  mtime;      /* key: source modification time */
+ int64_t  mtimensec;
+ float    gamma;
+ uint32_t pathlen;    /* key: absolute source path, follows the header */
+ uint32_t dataoff;    /* image data, a multiple of 8 */
+ uint32_t pad;
+};
+
+/* one cache file, for eviction */
+struct cache_entry {
+ char    *name;
+ time_t   mtime;
+ long     mtimensec;
+ off_t    size;
+};
+
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t CacheLimit = THUMBCACHE_LIMIT;
+static char  *CacheDir = NULL;   /* NULL until first use */
+static int    CacheDirTried = 0; /* -1 (true) once CacheDir was looked for */
+static size_t CacheBytes = 0;    /* size of the cache, as far as known */
+static int    CacheScanned = 0;  /* -1 (true) once CacheBytes was counted */
+
+
+/* INTERNAL (static) FUNCTIONS */
+
+/********************/
+/* cacheDirectory() */
+/********************/
+/* $XDG_CACHE_HOME/xopenimage, created if needed */
+/*  XDG_CACHE_HOME must be absolute, else ~/.cache is used */
+/*  returns NULL if there is none, called with cacheLock held */
+static const char*
+cacheDirectory(void)
+{
+const char *baseP = NULL;
+const char *homeP = NULL;
+char *dirP = NULL;
+size_t len;
+
+  if (!CacheDirTried) {
+    CacheDirTried = -1;
+    baseP = getenv("XDG_CACHE_HOME");
+    homeP = getenv("HOME");
+    len = 0;
+    if (baseP != NULL && baseP[0] == '/') {
+      len = strlen(baseP) + 1 + strlen(CACHE_SUBDIR) + 1;
+      dirP = malloc(len);
+      if (dirP != NULL) {
+        mkdir(baseP, 0700);
+        snprintf(dirP, len, "%s/%s", baseP, CACHE_SUBDIR);
+      }
+    } else if (homeP != NULL && homeP[0] == '/') {
+      len = strlen(homeP) + strlen("/.cache/") + strlen(CACHE_SUBDIR) + 1;
+      dirP = malloc(len);
+      if (dirP != NULL) {
+        snprintf(dirP, len, "%s/.cache", homeP);
+        mkdir(dirP, 0700);
+        snprintf(dirP, len, "%s/.cache/%s", homeP, CACHE_SUBDIR);
+      }
+    }
+    if (dirP != NULL && mkdir(dirP, 0700) != 0 && errno != EEXIST) {
+      perror(dirP);
+      free(dirP);
+      dirP = NULL;
+    }
+    CacheDir = dirP;
+  }
+  return(CacheDir);
+}
+
+
+/**************/
+/* cacheKey() */
+/**************/
+/* the key of a source file as it is now */
+/*  outKeyP->path is NULL if the file is not there */
+static void
+cacheKey(
+ const char *inFilepath,
+ unsigned int inMaxdim,
+ CacheKey *outKeyP)
+{
+struct stat filestat;
+
+  memset(outKeyP, 0, sizeof(CacheKey));
+  if (stat(inFilepath, &filestat) == 0) {
+    outKeyP->path = realpath(inFilepath, NULL);
+  }
+  if (outKeyP->path != NULL) {
+    outKeyP->maxdim = inMaxdim;
+    outKeyP->size = filestat.st_size;
+    outKeyP->mtime = filestat.st_mtim.tv_sec;
+    outKeyP->mtimensec = filestat.st_mtim.tv_nsec;
+  }
+}
+
+
+/*****************/
+/* cacheHeader() */
+/*****************/
+/* the key fields of a cache file's header */
+static void
+cacheHeader(
+ const CacheKey *inKeyP,
+ struct cache_header *outHdrP)
+{
+  memset(outHdrP, 0, sizeof(struct cache_header));
+  memcpy(outHdrP->magic, CACHE_MAGIC, 8);
+  outHdrP->maxdim = inKeyP->maxdim;
+  outHdrP->size = inKeyP->size;
+  outHdrP->mtime = inKeyP->mtime;
+  outHdrP->mtimensec = inKeyP->mtimensec;
+  outHdrP->pathlen = strlen(inKeyP->path);
+  outHdrP->dataoff = (sizeof(struct cache_header) + outHdrP->pathlen + 7) / 8 * 8;
+}
+
+
+/***************/
+/* cachePath() */
+/***************/
+/* cache file for a key, named by its FNV-1a hash */
+/*  returns malloc'd path, NULL if out of memory */
+static char*
+cachePath(
+ const char *inDir,
+ const char *inPath,
+ const struct cache_header *inHdrP)
+{
+uint64_t h = 14695981039346656037ULL;
+uint64_t v[4];
+const unsigned char *bP = NULL;
+char *rpathP = NULL;
+size_t len;
+size_t i;
+
+  for (bP = (const unsigned char *)inPath; *bP != '\0'; bP++) {
+    h = (h ^ *bP) * 1099511628211ULL;
+  }
+  v[0] = inHdrP->size;
+  v[1] = inHdrP->mtime;
+  v[2] = inHdrP->mtimensec;
+  v[3] = inHdrP->maxdim;
+  bP = (const unsigned char *)v;
+  for (i = 0; i < sizeof(v); i++) {
+    h = (h ^ bP[i]) * 1099511628211ULL;
+  }
+
+  len = strlen(inDir) + 1 + 16 + strlen(CACHE_SUFFIX) + 1;
+  rpathP = malloc(len);
+  if (rpathP != NULL) {
+    snprintf(rpathP, len, "%s/%016llx%s", inDir, (unsigned long long)h,
+      CACHE_SUFFIX);
+  }
+  return(rpathP);
+}
+
+
+/******************/
+/* cacheCompare() */
+/******************/
+/* qsort, oldest first */
+static int
+cacheCompare(
+ const void *inAP,
+ const void *inBP)
+{
+const struct cache_entry *aP = inAP;
+const struct cache_entry *bP = inBP;
+int ret = 0;
+
+  if (aP->mtime != bP->mtime) {
+    ret = (aP->mtime < bP->mtime ? -1 : 1);
+  } else if (aP->mtimensec != bP->mtimensec) {
+    ret = (aP->mtimensec < bP->mtimensec ? -1 : 1);
+  }
+  return(ret);
+}
+
+
+/****************/
+/* cacheEvict() */
+/****************/
+/* count the cache, and if it is over the limit remove the least */
+/*  recently used thumbnails down to CACHE_LOW.  temporary files */
+/*  older than CACHE_TMP_AGE are removed, newer ones are counted */
+/*  called with cacheLock held */
+static void
+cacheEvict(
+ const char *inDir,
+ unsigned int inVerbose)
+{
+DIR *dP = NULL;
+struct dirent *deP = NULL;
+struct stat filestat;
+struct cache_entry *entriesP = NULL;
+struct cache_entry *tmpP = NULL;
+char *pathP = NULL;
+size_t nentries = 0;
+size_t maxentries = 0;
+size_t total = 0;
+size_t len;
+size_t sufflen;
+size_t i;
+unsigned int nremoved = 0;
+time_t now;
+int tmp;
+
+  dP = opendir(inDir);
+  if (dP == NULL) {
+    return;
+  }
+
+  now = time(NULL);
+  sufflen = strlen(CACHE_SUFFIX);
+  while ((deP = readdir(dP)) != NULL) {
+    len = strlen(deP->d_name);
+    tmp = (strncmp(deP->d_name, CACHE_TMP, strlen(CACHE_TMP)) == 0);
+    if (!tmp && (len <= sufflen ||
+        strcmp(deP->d_name + len - sufflen, CACHE_SUFFIX) != 0)) {
+      continue;
+    }
+    len += strlen(inDir) + 2;
+    pathP = malloc(len);
+    if (pathP == NULL) {
+      break;
+    }
+    snprintf(pathP, len, "%s/%s", inDir, deP->d_name);
+    if (stat(pathP, &filestat) != 0) {
+      free(pathP);
+      continue;
+    }
+    if (tmp) {
+      /* left by an interrupted store, or still being written */
+      if (filestat.st_mtime + CACHE_TMP_AGE < now && unlink(pathP) == 0) {
+        nremoved++;
+      } else {
+        total += filestat.st_size;
+      }
+      free(pathP);
+      continue;
+    }
+    if (nentries == maxentries) {
+      maxentries = (maxentries == 0 ? 256 : maxentries * 2);
+      tmpP = realloc(entriesP, maxentries * sizeof(struct cache_entry));
+      if (tmpP == NULL) {
+        free(pathP);
+        break;
+      }
+      entriesP = tmpP;
+    }
+    entriesP[nentries].name = pathP;
+    entriesP[nentries].mtime = filestat.st_mtim.tv_sec;
+    entriesP[nentries].mtimensec = filestat.st_mtim.tv_nsec;
+    entriesP[nentries].size = filestat.st_size;
+    total += filestat.st_size;
+    nentries++;
+  }
+  closedir(dP);
+
+  if (total > CacheLimit && nentries > 0) {
+    qsort(entriesP, nentries, sizeof(struct cache_entry), cacheCompare);
+    for (i = 0; i < nentries && total > CACHE_LOW(CacheLimit); i++) {
+      if (unlink(entriesP[i].name) == 0) {
+        total -= entriesP[i].size;
+        nremoved++;
+      }
+    }
+  }
+  if (inVerbose && nremoved > 0) {
+    printf("thumbnail cache: %u removed, %zu bytes kept\n", nremoved, total);
+  }
+  CacheBytes = total;
+  CacheScanned = -1;
+
+  for (i = 0; i < nentries; i++) {
+    free(entriesP[i].name);
+  }
+  free(entriesP);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/*******************/
+/* setCacheLimit() */
+/*******************/
+void
+setCacheLimit(
+ size_t inBytes)
+{
+  CacheLimit = inBytes;
+}
+
+
+/***************/
+/* cacheLoad() */
+/***************/
+gImage*
+cacheLoad(
+ const char *inFilepath,
+ unsigned int inMaxdim,
+ CacheKey *outKeyP,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+const char *dirP = NULL;
+char *pathP = NULL;
+const unsigned char *mapP = NULL;
+const struct cache_header *fhdrP = NULL;
+struct cache_header key;
+struct stat filestat;
+size_t nbytes = 0;
+int fd = -1;
+
+  pthread_mutex_lock(&cacheLock);
+  dirP = (CacheLimit != 0 ? cacheDirectory() : NULL);
+  pthread_mutex_unlock(&cacheLock);
+
+  memset(outKeyP, 0, sizeof(CacheKey));
+  if (dirP != NULL) {
+    cacheKey(inFilepath, inMaxdim, outKeyP);
+  }
+  if (outKeyP->path != NULL) {
+    cacheHeader(outKeyP, &key);
+    pathP = cachePath(dirP, outKeyP->path, &key);
+  }
+  if (pathP != NULL) {
+    fd = open(pathP, O_RDONLY);
+  }
+  if (fd >= 0 && fstat(fd, &filestat) == 0 &&
+      (size_t)filestat.st_size >= key.dataoff) {
+    mapP = mmap(NULL, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapP == MAP_FAILED) {
+      mapP = NULL;
+    }
+  }
+
+  if (mapP != NULL) {
+    fhdrP = (const struct cache_header *)mapP;
+    if (fhdrP->gitype == IBITMAP || fhdrP->gitype == IRGB24 ||
+        fhdrP->gitype == IRGB48) {
+      nbytes = imageDataBytes(fhdrP->gitype, fhdrP->width, fhdrP->height);
+    }
+    /* the key, all of it, or some other file with the same hash */
+    if (memcmp(fhdrP->magic, key.magic, 8) == 0 &&
+        fhdrP->maxdim == key.maxdim && fhdrP->size == key.size &&
+        fhdrP->mtime == key.mtime && fhdrP->mtimensec == key.mtimensec &&
+        fhdrP->pathlen == key.pathlen && fhdrP->dataoff == key.dataoff &&
+        memcmp(mapP + sizeof(struct cache_header), outKeyP->path,
+          key.pathlen) == 0 &&
+        nbytes != 0 && (size_t)filestat.st_size - key.dataoff >= nbytes) {
+      switch (fhdrP->gitype) {
+       case IBITMAP:
+        rgiP = newBitImageUninit(fhdrP->width, fhdrP->height);
+        break;
+       case IRGB24:
+        rgiP = newRGB24ImageUninit(fhdrP->width, fhdrP->height);
+        break;
+       case IRGB48:
+        rgiP = newRGB48ImageUninit(fhdrP->width, fhdrP->height);
+        break;
+      }
+    }
+    if (rgiP != NULL) {
+      memcpy(rgiP->data, mapP + key.dataoff, nbytes);
+      rgiP->gamma = fhdrP->gamma;
+      strncpy(rgiP->title, inFilepath, 255);
+      rgiP->title[255] = '\0';
+      /* just used */
+      futimens(fd, NULL);
+      if (inVerbose) {
+        printf("%s, cached thumbnail, size: %u x %u\n", inFilepath,
+          rgiP->width, rgiP->height);
+      }
+    }
+    munmap((void *)mapP, filestat.st_size);
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
+  free(pathP);
+
+  return(rgiP);
+}
+
+
+/****************/
+/* cacheStore() */
+/****************/
+/* written to a temporary name and renamed, so a reader in another */
+/*  thread or process sees all of a thumbnail or none of it */
+void
+cacheStore(
+ const CacheKey *inKeyP,
+ gImage *ingiP,
+ unsigned int inVerbose)
+{
+const char *dirP = NULL;
+CacheKey now;
+char *pathP = NULL;
+char *tmpP = NULL;
+unsigned char *bufP = NULL;
+struct cache_header hdr;
+size_t nbytes = 0;
+size_t total = 0;
+size_t len;
+int fd = -1;
+int status = (-1);
+
+  if (inKeyP->path == NULL || TILEDP(ingiP) ||
+      (!BITMAPP(ingiP) && !RGB24P(ingiP) && !RGB48P(ingiP))) {
+    return;
+  }
+
+  pthread_mutex_lock(&cacheLock);
+  dirP = (CacheLimit != 0 ? cacheDirectory() : NULL);
+  pthread_mutex_unlock(&cacheLock);
+
+  /* rewritten while it was decoded: these pixels may be of either */
+  cacheKey(inKeyP->path, inKeyP->maxdim, &now);
+  if (now.path == NULL || strcmp(now.path, inKeyP->path) != 0 ||
+      now.size != inKeyP->size || now.mtime != inKeyP->mtime ||
+      now.mtimensec != inKeyP->mtimensec) {
+    dirP = NULL;
+  }
+  cacheKeyFree(&now);
+
+  if (dirP != NULL) {
+    cacheHeader(inKeyP, &hdr);
+    hdr.gitype = ingiP->gitype;
+    hdr.width = ingiP->width;
+    hdr.height = ingiP->height;
+    hdr.gamma = ingiP->gamma;
+    nbytes = imageDataBytes(ingiP->gitype, ingiP->width, ingiP->height);
+    total = hdr.dataoff + nbytes;
+    pathP = cachePath(dirP, inKeyP->path, &hdr);
+    len = strlen(dirP) + strlen("/" CACHE_TMP "XXXXXX") + 1;
+    tmpP = malloc(len);
+    bufP = calloc(1, hdr.dataoff);
+  }
+  if (pathP != NULL && tmpP != NULL && bufP != NULL && nbytes != 0) {
+    snprintf(tmpP, len, "%s/" CACHE_TMP "XXXXXX", dirP);
+    fd = mkstemp(tmpP);
+  }
+
+  if (fd >= 0) {
+    memcpy(bufP, &hdr, sizeof(struct cache_header));
+    memcpy(bufP + sizeof(struct cache_header), inKeyP->path, hdr.pathlen);
+    if (write(fd, bufP, hdr.dataoff) == (ssize_t)hdr.dataoff &&
+        write(fd, ingiP->data, nbytes) == (ssize_t)nbytes) {
+      status = 0;
+    }
+    if (close(fd) != 0) {
+      status = (-1);
+    }
+    if (status == 0 && rename(tmpP, pathP) != 0) {
+      status = (-1);
+    }
+    if (status != 0) {
+      unlink(tmpP);
+    }
+  }
+
+  if (status == 0) {
+    pthread_mutex_lock(&cacheLock);
+    if (!CacheScanned) {
+      /* the first store counts what is there */
+      cacheEvict(dirP, inVerbose);
+    } else {
+      CacheBytes += total;
+      if (CacheBytes > CacheLimit) {
+        cacheEvict(dirP, inVerbose);
+      }
+    }
+    pthread_mutex_unlock(&cacheLock);
+  }
+
+  free(bufP);
+  free(tmpP);
+  free(pathP);
+}
+
+
+/******************/
+/* cacheKeyFree() */
+/******************/
+void
+cacheKeyFree(
+ CacheKey *inKeyP)
+{
+  free(inKeyP->path);
+  inKeyP->path = NULL;
+}
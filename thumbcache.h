@@ -0,0 +1,87 @@
+/* thumbcache.h */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+#ifndef thumbcache_h
+#define thumbcache_h
+
+/**
+ * @defgroup thumbcache  on-disk thumbnail cache
+ * reduced images kept between runs, under
+ * $XDG_CACHE_HOME/xopenimage, or ~/.cache/xopenimage
+ *
+ * \#include "thumbcache.h"
+ */
+
+#include <stddef.h> /* size_t */
+
+#include "gimage.h" /* 'gImage' struct */
+
+
+/* default size of the cache */
+#define THUMBCACHE_LIMIT ((size_t)256 * 1024 * 1024)
+
+
+/* a source file as cacheLoad() found it, before it is decoded */
+typedef struct cache_key {
+ char        *path;      /* absolute, NULL if it cannot be cached */
+ unsigned int maxdim;
+ long long    size;
+ long long    mtime;
+ long         mtimensec;
+} CacheKey;
+
+
+/** setCacheLimit
+ * @ingroup thumbcache
+ * @param[in] bytes size the cache is kept under, 0 to turn it off
+ *
+ * set before any thread uses the cache
+ */
+void setCacheLimit(size_t bytes);
+
+
+/** cacheLoad
+ * @ingroup thumbcache
+ * @param[in] filename image file
+ * @param[in] maxdim size the thumbnail was made for
+ * @param[out] keyP the file as it is now, for cacheStore(); free
+ * with cacheKeyFree()
+ * @param[in] verbose flag for verbose output
+ * @return new gImage, NULL if not cached
+ *
+ * a thumbnail is found only if the file has the same path, size
+ * and modification time as when it was stored.  safe from any
+ * thread.
+ */
+gImage* cacheLoad(const char *filename, unsigned int maxdim, CacheKey *keyP, unsigned int verbose);
+
+
+/** cacheStore
+ * @ingroup thumbcache
+ * @param[in] keyP from cacheLoad(), before the file was decoded
+ * @param[in] gimageP thumbnail, IBITMAP, IRGB24 or IRGB48, not tiled
+ * @param[in] verbose flag for verbose output
+ *
+ * nothing is stored if the file has changed since keyP was taken,
+ * so a thumbnail is never kept under a newer file's key.  the least
+ * recently used thumbnails are removed when the cache grows over
+ * its limit.  safe from any thread.
+ */
+void cacheStore(const CacheKey *keyP, gImage *gimageP, unsigned int verbose);
+
+
+/** cacheKeyFree
+ * @ingroup thumbcache
+ * @param[in] keyP key filled in by cacheLoad()
+ */
+void cacheKeyFree(CacheKey *keyP);
+
+
+#endif
@@ -14,39 +14,297 @@
 #include <stdlib.h>
 #include <stdio.h>  /* fprintf */
 #include <math.h>   /* modf */
+#include <stdint.h> /* uint64_t */
 
 /* code base */
 #include "bitdownscale.h" /* declaration consistency */
 
-/* PUBLIC FUNCTIONS */
+
+/* INTERNAL */
+
+/****************/
+/* popcount64() */
+/****************/
+static unsigned int
+popcount64(
+ uint64_t inW)
+{
+unsigned int n;
+
+#if defined(__GNUC__)
+  n = __builtin_popcountll(inW);
+#else
+  inW = inW - ((inW >> 1) & 0x5555555555555555ULL);
+  inW = (inW & 0x3333333333333333ULL) + ((inW >> 2) & 0x3333333333333333ULL);
+  inW = (inW + (inW >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  n = (inW * 0x0101010101010101ULL) >> 56;
+#endif
+  return(n);
+}
+
+
+/************/
+/* bitsAt() */
+/************/
+/* inCount (at most 64) bits of a bitmap row from inStart, */
+/*  first pixel in the least significant bit, bits past the row are 0 */
+/*  bytes are assembled least significant first, so bit order in */
+/*  the word is pixel order */
+static uint64_t
+bitsAt(
+ const unsigned char *rowP,
+ size_t inRowBytes,
+ size_t inStart,
+ unsigned int inCount)
+{
+uint64_t w = 0;
+uint64_t hi = 0;
+size_t byte;
+size_t i;
+unsigned int shift;
+
+  byte = inStart / 8;
+  shift = inStart % 8;
+  if (byte + 8 <= inRowBytes) {
+    w = (uint64_t)rowP[byte]           | (uint64_t)rowP[byte + 1] << 8  |
+        (uint64_t)rowP[byte + 2] << 16 | (uint64_t)rowP[byte + 3] << 24 |
+        (uint64_t)rowP[byte + 4] << 32 | (uint64_t)rowP[byte + 5] << 40 |
+        (uint64_t)rowP[byte + 6] << 48 | (uint64_t)rowP[byte + 7] << 56;
+  } else {
+    for (i = 0; byte + i < inRowBytes && i < 8; i++) {
+      w |= (uint64_t)rowP[byte + i] << (8 * i);
+    }
+  }
+  w >>= shift;
+  /* the ninth byte, for bits pushed out by the shift */
+  if (shift != 0 && inCount > 64 - shift && byte + 8 < inRowBytes) {
+    hi = rowP[byte + 8];
+    w |= hi << (64 - shift);
+  }
+  if (inCount < 64) {
+    w &= ((uint64_t)1 << inCount) - 1;
+  }
+  return(w);
+}
+
+
+/***************/
+/* bitsInRow() */
+/***************/
+/* number of set bits from inStart for inCount bits of a bitmap row */
+static unsigned int
+bitsInRow(
+ const unsigned char *rowP,
+ size_t inRowBytes,
+ size_t inStart,
+ unsigned int inCount)
+{
+unsigned int nset = 0;
+unsigned int take;
+
+  while (inCount > 0) {
+    take = (inCount < 64 ? inCount : 64);
+    nset += popcount64(bitsAt(rowP, inRowBytes, inStart, take));
+    inStart += take;
+    inCount -= take;
+  }
+  return(nset);
+}
+
 
 /******************/
-/* bitdownscale() */
+/* boxdownscale() */
 /******************/
-/* dstP must already be allocated */
-int
-bitdownscale(
+/* whole number ratios on both axes: every dst pixel is a box of */
+/*  whole src pixels, so the area average is a count of set bits */
+/*  output to dstP as bits, or to coverP as fractions if not NULL */
+static int
+boxdownscale(
  const unsigned char *srcP,
  unsigned int src_xdim,
  unsigned int src_ydim,
  unsigned char *dstP,
+ float *coverP,
  unsigned int dst_xdim,
  unsigned int dst_ydim)
 {
 int status = 0;
-unsigned int srowbytes;
-unsigned int drowbytes;
-unsigned int xs, ys, xd, yd;
-unsigned char bitset;
-unsigned char byte;
+size_t srowbytes;
+size_t drowbytes;
+unsigned int kx, ky;
+unsigned int xd, yd;
+unsigned int j;
+unsigned int g;
+unsigned int ngroup;
+unsigned long box;
+uint64_t w;
+uint64_t mask;
+unsigned long *countP = NULL;
+const unsigned char *rowP = NULL;
+
+  kx = src_xdim / dst_xdim;
+  ky = src_ydim / dst_ydim;
+  box = (unsigned long)kx * ky;
+
+  srowbytes = ((size_t)src_xdim + 7) / 8;
+  drowbytes = ((size_t)dst_xdim + 7) / 8;
+
+  countP = malloc(sizeof(unsigned long) * (size_t)dst_xdim);
+  if (countP == NULL) {
+    fprintf(stderr, "bitdownscale error: malloc\n");
+    status = -1;
+  } else {
+    for (yd = 0; yd < dst_ydim; yd++) {
+      for (xd = 0; xd < dst_xdim; xd++) {
+        countP[xd] = 0;
+      }
+      for (j = 0; j < ky; j++) {
+        rowP = srcP + ((size_t)yd * ky + j) * srowbytes;
+        if (kx <= 32) {
+          /* several dst pixels per 64 bit word */
+          ngroup = 64 / kx;
+          mask = ((uint64_t)1 << kx) - 1;
+          for (xd = 0; xd < dst_xdim; xd += ngroup) {
+            w = bitsAt(rowP, srowbytes, (size_t)xd * kx, ngroup * kx);
+            for (g = 0; g < ngroup && xd + g < dst_xdim; g++) {
+              countP[xd + g] += popcount64(w & mask);
+              w >>= kx;
+            }
+          }
+        } else {
+          for (xd = 0; xd < dst_xdim; xd++) {
+            countP[xd] += bitsInRow(rowP, srowbytes, (size_t)xd * kx, kx);
+          }
+        }
+      }
+      if (coverP != NULL) {
+        for (xd = 0; xd < dst_xdim; xd++) {
+          coverP[(size_t)yd * dst_xdim + xd] = (double)countP[xd] / box;
+        }
+      } else {
+        /* set bit if average >= 0.5 */
+        for (xd = 0; xd < dst_xdim; xd++) {
+          if (2 * countP[xd] >= box) {
+            *(dstP + (size_t)yd * drowbytes + (xd / 8)) |= 0x01 << (xd % 8);
+          }
+        }
+      }
+    }
+  }
+
+  free(countP);
+  return(status);
+}
+
+
+/* one dst column: the src columns it covers, [x0, x0 + n) whole */
+/*  less f0 of column x0, plus f1 of column x0 + n */
+struct cell_struct {
+  size_t       x0;
+  unsigned int n;
+  double       f0;
+  double       f1;
+};
+
+
+/***********/
+/* bitAt() */
+/***********/
+static unsigned int
+bitAt(
+ const unsigned char *rowP,
+ size_t inX)
+{
+  return((rowP[inX / 8] >> (inX % 8)) & 0x01);
+}
+
+
+/************/
+/* addRow() */
+/************/
+/* add inWeight times the coverage of each dst column by one src row */
+/*  whole src columns are counted with popcount, from one 64 bit word */
+/*  shared by the dst columns that fit in it */
+static void
+addRow(
+ const unsigned char *rowP,
+ size_t inRowBytes,
+ const struct cell_struct *cellsP,
+ unsigned int dst_xdim,
+ double inWeight,
+ double *ioSumP)
+{
+const struct cell_struct *cP = NULL;
+unsigned int xd;
+unsigned int shift;
+size_t wstart = 0;
+uint64_t w = 0;
+uint64_t cw;
+int have = 0;
+double sum;
+
+  for (xd = 0; xd < dst_xdim; xd++) {
+    cP = &cellsP[xd];
+    if (cP->n < 64) {
+      /* the column and the partial one after it, in the word */
+      if (!have || cP->x0 + cP->n >= wstart + 64) {
+        wstart = cP->x0;
+        w = bitsAt(rowP, inRowBytes, wstart, 64);
+        have = -1;
+      }
+      shift = cP->x0 - wstart;
+      cw = w >> shift;
+      sum = popcount64(cw & (((uint64_t)1 << cP->n) - 1));
+      if (cP->f0 > 0.0 && (cw & 0x01) != 0) {
+        sum -= cP->f0;
+      }
+      if (cP->f1 > 0.0 && ((cw >> cP->n) & 0x01) != 0) {
+        sum += cP->f1;
+      }
+    } else {
+      sum = bitsInRow(rowP, inRowBytes, cP->x0, cP->n);
+      if (cP->f0 > 0.0 && bitAt(rowP, cP->x0)) {
+        sum -= cP->f0;
+      }
+      if (cP->f1 > 0.0 && bitAt(rowP, cP->x0 + cP->n)) {
+        sum += cP->f1;
+      }
+    }
+    ioSumP[xd] += inWeight * sum;
+  }
+}
+
+
+/*******************/
+/* areadownscale() */
+/*******************/
+/* area weighted average of src bits for each dst pixel */
+/*  output to dstP as bits, or to coverP as fractions if not NULL */
+/*  src rows and columns wholly inside a dst pixel are counted with */
+/*  popcount; only the partial ones at its edges are weighted */
+static int
+areadownscale(
+ const unsigned char *srcP,
+ unsigned int src_xdim,
+ unsigned int src_ydim,
+ unsigned char *dstP,
+ float *coverP,
+ unsigned int dst_xdim,
+ unsigned int dst_ydim)
+{
+int status = 0;
+size_t srowbytes;
+size_t drowbytes;
+unsigned int ys, xd, yd;
 double  sx1,  sy1;
 /* f - fractional part */
 double fsx0, fsx1, fsy0, fsy1;
 /* i - integer    part */
 double isx0, isx1, isy0, isy1;
 double src_area;
-double fx, fy;
-double sum;
+double fy;
+struct cell_struct *cellsP = NULL;
+double *sumP = NULL;
 
   /* input checking */
   if ( (src_ydim == 0) || (src_xdim == 0) ||
@@ -56,13 +314,40 @@ double sum;
   } else if ( (dst_ydim > src_ydim) || (dst_xdim > src_xdim) ) {
     fprintf(stderr, "bitdownscale error: dst dimensions cannot be larger than src\n");
     status = -1;
-  } else { 
+  } else if (src_xdim % dst_xdim == 0 && src_ydim % dst_ydim == 0) {
+    status = boxdownscale(srcP, src_xdim, src_ydim, dstP, coverP,
+      dst_xdim, dst_ydim);
+  } else {
+    cellsP = malloc(sizeof(struct cell_struct) * (size_t)dst_xdim);
+    sumP = malloc(sizeof(double) * (size_t)dst_xdim);
+    if (cellsP == NULL || sumP == NULL) {
+      fprintf(stderr, "bitdownscale error: malloc\n");
+      status = -1;
+    }
+  }
 
-    srowbytes = (src_xdim + 7) / 8;
-    drowbytes = (dst_xdim + 7) / 8;
+  if (cellsP != NULL && sumP != NULL) {
+
+    srowbytes = ((size_t)src_xdim + 7) / 8;
+    drowbytes = ((size_t)dst_xdim + 7) / 8;
 
     src_area = ((double) src_xdim * src_ydim) / ((double) dst_xdim * dst_ydim);
 
+    /* the same columns for every row */
+    isx0 = 0.0;
+    fsx0 = 0.0;
+    for (xd = 0; xd < dst_xdim; xd++) {
+       sx1 = ((xd + 1.0) / dst_xdim) * src_xdim;
+      fsx1 = modf(sx1, &isx1);
+      /* there is no partial column past the right edge */
+      cellsP[xd].x0 = isx0;
+      cellsP[xd].n = isx1 - isx0;
+      cellsP[xd].f0 = fsx0;
+      cellsP[xd].f1 = (isx1 < src_xdim ? fsx1 : 0.0);
+      isx0 = isx1;
+      fsx0 = fsx1;
+    }
+
     isy0 = 0.0;
     fsy0 = 0.0;
     for (yd = 0; yd < dst_ydim; yd++) {
@@ -70,48 +355,28 @@ double sum;
        sy1 = ((yd + 1.0) / dst_ydim) * src_ydim;
       fsy1 = modf(sy1, &isy1);
 
-      isx0 = 0.0;
-      fsx0 = 0.0;
       for (xd = 0; xd < dst_xdim; xd++) {
+        sumP[xd] = 0.0;
+      }
 
-         sx1 = ((xd + 1.0) / dst_xdim) * src_xdim;
-        fsx1 = modf(sx1, &isx1);
-
-        sum = 0.0;
-
-        ys = isy0;
-        fy = 1.0 - fsy0;
-        do {
-          xs = isx0;
-          fx = 1.0 - fsx0;
-
-          do {
-
-            /* convert from xs,ys to byte and bit of src */
-            /*  if bit set, multiply by (fx * fy) and add to sum */
-            byte = *(srcP + ys * srowbytes + (xs / 8) );
-            bitset = byte & (0x01 << (xs % 8));
-            if (bitset != 0) {
-              sum += (fx * fy);
-            }
-
-            xs++;
-            fx = (xs < isx1 ? 1.0 : fsx1);
-          } while (xs < sx1);
-
-          ys++;
-          fy = (ys < isy1 ? 1.0 : fsy1);
-        } while (ys < sy1);
-
-        /* if average >= 0.5, set bit */
-        /*  determine byte and bit from xd,yd */ 
-        if ((sum / src_area) >= 0.5) {
-          bitset = 0x01 << (xd % 8);
-          *(dstP + yd * drowbytes + (xd / 8)) |= bitset;
+      /* rows isy0 to isy1, the first less fsy0, the last only fsy1 */
+      for (ys = isy0; ys < sy1 && ys < src_ydim; ys++) {
+        if (ys < isy1) {
+          fy = (ys == isy0 ? 1.0 - fsy0 : 1.0);
+        } else {
+          fy = fsy1;
         }
+        addRow(srcP + (size_t)ys * srowbytes, srowbytes, cellsP, dst_xdim,
+          fy, sumP);
+      }
 
-        isx0 = isx1;
-        fsx0 = fsx1;
+      /* coverage, or if average >= 0.5, set bit */
+      for (xd = 0; xd < dst_xdim; xd++) {
+        if (coverP != NULL) {
+          coverP[(size_t)yd * dst_xdim + xd] = sumP[xd] / src_area;
+        } else if ((sumP[xd] / src_area) >= 0.5) {
+          *(dstP + (size_t)yd * drowbytes + (xd / 8)) |= 0x01 << (xd % 8);
+        }
       }
 
       isy0 = isy1;
@@ -120,6 +385,45 @@ double sum;
 
   }
 
+  free(cellsP);
+  free(sumP);
   return(status);
 }
 
+
+/* PUBLIC FUNCTIONS */
+
+/******************/
+/* bitdownscale() */
+/******************/
+/* dstP must already be allocated, and zero filled */
+int
+bitdownscale(
+ const unsigned char *srcP,
+ unsigned int src_xdim,
+ unsigned int src_ydim,
+ unsigned char *dstP,
+ unsigned int dst_xdim,
+ unsigned int dst_ydim)
+{
+  return(areadownscale(srcP, src_xdim, src_ydim, dstP, NULL,
+    dst_xdim, dst_ydim));
+}
+
+
+/***********************/
+/* bitdownscalecover() */
+/***********************/
+/* coverP must already be allocated */
+int
+bitdownscalecover(
+ const unsigned char *srcP,
+ unsigned int src_xdim,
+ unsigned int src_ydim,
+ float *coverP,
+ unsigned int dst_xdim,
+ unsigned int dst_ydim)
+{
+  return(areadownscale(srcP, src_xdim, src_ydim, NULL, coverP,
+    dst_xdim, dst_ydim));
+}
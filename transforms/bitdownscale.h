@@ -30,5 +30,17 @@ int bitdownscale(const unsigned char *src,
  unsigned char *dst,
  unsigned int dst_xdim, unsigned int dst_ydim);
 
+/**
+ * same area average as bitdownscale(), without the threshold:
+ *  cover is dst_xdim * dst_ydim floats, row by row,
+ *  each the fraction (0.0 to 1.0) of the src area under it
+ *  that has bits set
+ */
+
+int bitdownscalecover(const unsigned char *src,
+ unsigned int src_xdim, unsigned int src_ydim,
+ float *cover,
+ unsigned int dst_xdim, unsigned int dst_ydim);
+
 #endif
 
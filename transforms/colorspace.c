@@ -17,18 +17,25 @@
  only 1 return in functions */
 
 /* Feature test switches */
-#define _POSIX_C_SOURCE 1
+#define _POSIX_C_SOURCE 200809L /* pthreads */
 
 /* System headers */
 #include <stdlib.h>
 #include <stdio.h>  /* fprintf */
+#include <string.h> /* memmove */
+#include <stdint.h> /* uint16_t */
 #include <math.h>   /* pow */
+#include <pthread.h>
 
 /* Local headers */
+#include "../gimage.h" /* 'gImage' struct */
 #include "colorspace.h"
 
 /* Macros */
-   /* NONE */
+/* pixels per pass of each stage in the whole buffer conversions */
+#define CS_BLOCK (256)
+/* out of range by more than this is counted as clipped */
+#define CS_SLACK (1.0e-4f)
 /* File scope variables */
  /* none */
 /* External variables */
@@ -376,6 +383,575 @@ double Li;
 
 
 
+/****************************/
+/* whole buffer conversions */
+/****************************/
+
+/* each pixel goes decode -> linear -> 3x3 matrix -> clamp -> encode */
+/*  a block of pixels at a time, each stage one plain loop over the */
+/*  block, so the block stays in cache; for 8 and 16 bit the decode */
+/*  and encode are table lookups, nothing is called per pixel */
+/* linear is linear RGB for sRGB and AdobeRGB, XYZ for XYZ and CIELAB */
+/*  all are D65, so no white point adaptation is needed */
+
+/******************/
+/* csPairMatrix() */
+/******************/
+/* linear inFrom to linear inTo, through XYZ */
+static void
+csPairMatrix(
+ unsigned int inFrom,
+ unsigned int inTo,
+ float *outM)
+{
+/* RGB to XYZ, sRGB2XYZ() and aRGB2XYZ() */
+static const double toXYZ[2][9] = {
+ { 0.4124,  0.3576,  0.1805,  0.2126,  0.7152,  0.0722,  0.0193,  0.1192,  0.9505 },
+ { 0.57667, 0.18556, 0.18823, 0.29734, 0.62736, 0.07529, 0.02703, 0.07069, 0.99134 }
+};
+/* XYZ to RGB, XYZ2sRGB() and XYZ2aRGB() */
+static const double fromXYZ[2][9] = {
+ { 3.2406255, -1.537208,  -0.4986286,
+  -0.9689307,  1.8757561,  0.0415175,
+   0.0557101, -0.2040211,  1.0569959 },
+ { 2.04159,   -0.56501,   -0.34473,
+  -0.96924,    1.87597,    0.04156,
+   0.01344,   -0.11836,    1.01517 }
+};
+static const double ident[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+const double *aP = NULL;
+const double *bP = NULL;
+unsigned int r;
+unsigned int c;
+
+  aP = (inFrom <= CS_ARGB ? toXYZ[inFrom] : ident);
+  bP = (inTo <= CS_ARGB ? fromXYZ[inTo] : ident);
+  for (r = 0; r < 3; r++) {
+    for (c = 0; c < 3; c++) {
+      outM[r * 3 + c] = bP[r * 3] * aP[c] + bP[r * 3 + 1] * aP[3 + c] +
+                        bP[r * 3 + 2] * aP[6 + c];
+    }
+  }
+}
+
+
+/**************/
+/* csDecode() */
+/**************/
+/* encoded component [0...1] of an RGB space to linear */
+static double
+csDecode(
+ unsigned int inSpace,
+ double inC)
+{
+double ret;
+
+  if (inC <= 0.0) {
+    ret = 0.0;
+  } else if (inSpace == CS_ARGB) {
+    ret = pow(inC, 563.0 / 256.0);
+  } else if (inC <= 0.04045) {
+    ret = inC / 12.92;
+  } else {
+    ret = pow((inC + 0.055) / 1.055, 2.4);
+  }
+  return(ret);
+}
+
+
+/**************/
+/* csEncode() */
+/**************/
+/* linear to encoded component [0...1] of an RGB space */
+static double
+csEncode(
+ unsigned int inSpace,
+ double inLin)
+{
+  return(inSpace == CS_ARGB ? lin2aRGB(inLin) : lin2sRGB(inLin));
+}
+
+
+/****************/
+/* csMatClamp() */
+/****************/
+/* inN linear pixels through the matrix, in place */
+/*  if inClamp, results are clamped to [0...1] */
+/*  returns the samples that were out of range by more than rounding */
+static size_t
+csMatClamp(
+ const float *inM,
+ float *ioLinP,
+ size_t inN,
+ int inClamp)
+{
+size_t clipped = 0;
+size_t i;
+unsigned int c;
+float r, g, b;
+float v[3];
+
+  for (i = 0; i < inN; i++) {
+    r = ioLinP[0];
+    g = ioLinP[1];
+    b = ioLinP[2];
+    v[0] = inM[0] * r + inM[1] * g + inM[2] * b;
+    v[1] = inM[3] * r + inM[4] * g + inM[5] * b;
+    v[2] = inM[6] * r + inM[7] * g + inM[8] * b;
+    for (c = 0; c < 3; c++) {
+      if (inClamp && v[c] < 0.0f) {
+        clipped += (v[c] < -CS_SLACK);
+        v[c] = 0.0f;
+      } else if (inClamp && v[c] > 1.0f) {
+        clipped += (v[c] > 1.0f + CS_SLACK);
+        v[c] = 1.0f;
+      }
+      ioLinP[c] = v[c];
+    }
+    ioLinP += 3;
+  }
+  return(clipped);
+}
+
+
+/*************/
+/* csTable() */
+/*************/
+/* cached lookup tables of an RGB space, built on first use */
+/*  decode: 256 or 65536 floats, encoded value to linear */
+/*  encode: CS_ENCSIZE entries of linear * (CS_ENCSIZE - 1) to */
+/*   encoded 8 bit (unsigned char) or 16 bit (uint16_t) */
+/*  tables are kept for the run, so pointers stay valid */
+/*  returns NULL if out of memory */
+static const void*
+csTable(
+ unsigned int inSpace,
+ unsigned int inBits,
+ int inEncode)
+{
+static void *tables[2][2][2]; /* [space][8 or 16 bit][decode, encode] */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+void *tP = NULL;
+float *decP = NULL;
+unsigned char *enc8P = NULL;
+uint16_t *enc16P = NULL;
+unsigned int b;
+size_t n;
+size_t i;
+double max;
+double v;
+
+  b = (inBits == 8 ? 0 : 1);
+  max = (inBits == 8 ? 255.0 : 65535.0);
+  pthread_mutex_lock(&lock);
+  tP = tables[inSpace][b][inEncode != 0];
+  if (tP == NULL) {
+    if (inEncode == 0) {
+      n = (size_t)max + 1;
+      tP = decP = malloc(n * sizeof(float));
+      for (i = 0; decP != NULL && i < n; i++) {
+        if (inBits == 8) {
+          decP[i] = (inSpace == CS_ARGB ? aRGBlin[i] : sRGBlin[i]);
+        } else {
+          decP[i] = csDecode(inSpace, i / max);
+        }
+      }
+    } else {
+      n = CS_ENCSIZE;
+      if (inBits == 8) {
+        tP = enc8P = malloc(n);
+      } else {
+        tP = enc16P = malloc(n * sizeof(uint16_t));
+      }
+      for (i = 0; tP != NULL && i < n; i++) {
+        v = csEncode(inSpace, (double)i / (CS_ENCSIZE - 1)) * max + 0.5;
+        if (enc8P != NULL) {
+          enc8P[i] = (unsigned char)v;
+        } else {
+          enc16P[i] = (uint16_t)v;
+        }
+      }
+    }
+    if (tP == NULL) {
+      fprintf(stderr, "colorspace table malloc error\n");
+    }
+    tables[inSpace][b][inEncode != 0] = tP;
+  }
+  pthread_mutex_unlock(&lock);
+  return(tP);
+}
+
+
+/******************/
+/* csConvertInt() */
+/******************/
+/* 8 or 16 bit RGB to RGB, for csConvert8() and csConvert16() */
+static size_t
+csConvertInt(
+ const void *inP,
+ void *outP,
+ size_t inNpix,
+ unsigned int inFrom,
+ unsigned int inTo,
+ unsigned int inBits)
+{
+float lin[CS_BLOCK * 3];
+float m[9];
+const float *decP = NULL;
+const unsigned char *enc8P = NULL;
+const uint16_t *enc16P = NULL;
+const unsigned char *in8P = inP;
+const uint16_t *in16P = inP;
+unsigned char *out8P = outP;
+uint16_t *out16P = outP;
+size_t clipped = 0;
+size_t done;
+size_t n;
+size_t i;
+
+  if (inFrom > CS_ARGB || inTo > CS_ARGB) {
+    fprintf(stderr, "colorspace: %u bit conversion is RGB to RGB only\n", inBits);
+  } else if (inFrom == inTo) {
+    if (inP != outP) {
+      memmove(outP, inP, inNpix * 3 * (inBits / 8));
+    }
+  } else {
+    decP = csTable(inFrom, inBits, 0);
+    if (inBits == 8) {
+      enc8P = csTable(inTo, 8, -1);
+    } else {
+      enc16P = csTable(inTo, 16, -1);
+    }
+    csPairMatrix(inFrom, inTo, m);
+
+    for (done = 0; decP != NULL && (enc8P != NULL || enc16P != NULL) &&
+         done < inNpix; done += n) {
+      n = (inNpix - done < CS_BLOCK ? inNpix - done : CS_BLOCK);
+      if (inBits == 8) {
+        for (i = 0; i < n * 3; i++) {
+          lin[i] = decP[in8P[done * 3 + i]];
+        }
+      } else {
+        for (i = 0; i < n * 3; i++) {
+          lin[i] = decP[in16P[done * 3 + i]];
+        }
+      }
+      clipped += csMatClamp(m, lin, n, -1);
+      if (inBits == 8) {
+        for (i = 0; i < n * 3; i++) {
+          out8P[done * 3 + i] = enc8P[(size_t)(lin[i] * (CS_ENCSIZE - 1) + 0.5f)];
+        }
+      } else {
+        for (i = 0; i < n * 3; i++) {
+          out16P[done * 3 + i] = enc16P[(size_t)(lin[i] * (CS_ENCSIZE - 1) + 0.5f)];
+        }
+      }
+    }
+  }
+  return(clipped);
+}
+
+
+/**************/
+/* csMatrix() */
+/**************/
+void
+csMatrix(
+ unsigned int inFrom,
+ unsigned int inTo,
+ float *outM)
+{
+  csPairMatrix(inFrom, inTo, outM);
+}
+
+
+/********************/
+/* csConvertFloat() */
+/********************/
+size_t
+csConvertFloat(
+ const float *inP,
+ float *outP,
+ size_t inNpix,
+ unsigned int inFrom,
+ unsigned int inTo)
+{
+float lin[CS_BLOCK * 3];
+float m[9];
+double X, Y, Z;
+double L, a, b;
+size_t clipped = 0;
+size_t done;
+size_t n;
+size_t i;
+
+  if (inFrom > CS_LAB || inTo > CS_LAB) {
+    fprintf(stderr, "colorspace: unknown colorspace\n");
+  } else {
+    csPairMatrix(inFrom, inTo, m);
+
+    for (done = 0; done < inNpix; done += n) {
+      n = (inNpix - done < CS_BLOCK ? inNpix - done : CS_BLOCK);
+
+      /* decode */
+      if (inFrom == CS_LAB) {
+        for (i = 0; i < n; i++) {
+          Lab2XYZ(inP[(done + i) * 3], inP[(done + i) * 3 + 1],
+            inP[(done + i) * 3 + 2], &X, &Y, &Z);
+          lin[i * 3] = X;
+          lin[i * 3 + 1] = Y;
+          lin[i * 3 + 2] = Z;
+        }
+      } else if (inFrom == CS_XYZ) {
+        for (i = 0; i < n * 3; i++) {
+          lin[i] = inP[done * 3 + i];
+        }
+      } else {
+        for (i = 0; i < n * 3; i++) {
+          lin[i] = csDecode(inFrom, inP[done * 3 + i]);
+        }
+      }
+
+      clipped += csMatClamp(m, lin, n, inTo <= CS_ARGB);
+
+      /* encode */
+      if (inTo == CS_LAB) {
+        for (i = 0; i < n; i++) {
+          XYZ2Lab(lin[i * 3], lin[i * 3 + 1], lin[i * 3 + 2], &L, &a, &b);
+          outP[(done + i) * 3] = L;
+          outP[(done + i) * 3 + 1] = a;
+          outP[(done + i) * 3 + 2] = b;
+        }
+      } else if (inTo == CS_XYZ) {
+        for (i = 0; i < n * 3; i++) {
+          outP[done * 3 + i] = lin[i];
+        }
+      } else {
+        for (i = 0; i < n * 3; i++) {
+          outP[done * 3 + i] = csEncode(inTo, lin[i]);
+        }
+      }
+    }
+  }
+  return(clipped);
+}
+
+
+/****************/
+/* csConvert8() */
+/****************/
+size_t
+csConvert8(
+ const unsigned char *inP,
+ unsigned char *outP,
+ size_t inNpix,
+ unsigned int inFrom,
+ unsigned int inTo)
+{
+  return(csConvertInt(inP, outP, inNpix, inFrom, inTo, 8));
+}
+
+
+/*****************/
+/* csConvert16() */
+/*****************/
+size_t
+csConvert16(
+ const uint16_t *inP,
+ uint16_t *outP,
+ size_t inNpix,
+ unsigned int inFrom,
+ unsigned int inTo)
+{
+  return(csConvertInt(inP, outP, inNpix, inFrom, inTo, 16));
+}
+
+
+/********************/
+/* csConvertImage() */
+/********************/
+size_t
+csConvertImage(
+ gImage *ingimageP,
+ unsigned int inFrom,
+ unsigned int inTo)
+{
+unsigned char *scratchP = NULL;
+unsigned char *rowP = NULL;
+size_t clipped = 0;
+unsigned int y;
+
+  if (RGB24P(ingimageP) || RGB48P(ingimageP)) {
+    scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+    if (scratchP == NULL) {
+      fprintf(stderr, "colorspace malloc error\n");
+    }
+    for (y = 0; scratchP != NULL && y < ingimageP->height; y++) {
+      rowP = imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+      if (rowP != NULL) {
+        if (RGB24P(ingimageP)) {
+          clipped += csConvert8(rowP, rowP, ingimageP->width, inFrom, inTo);
+        } else {
+          clipped += csConvert16((uint16_t *)rowP, (uint16_t *)rowP,
+            ingimageP->width, inFrom, inTo);
+        }
+        imagePutRow(ingimageP, y, rowP);
+      }
+    }
+    free(scratchP);
+  }
+  return(clipped);
+}
+
+
+/********************/
+/* csEncodeTable8() */
+/********************/
+const unsigned char*
+csEncodeTable8(void)
+{
+  return(csTable(CS_SRGB, 8, -1));
+}
+
+
+/*******************/
+/* csLinearImage() */
+/*******************/
+gImage*
+csLinearImage(
+ gImage *ingimageP)
+{
+gImage *rgiP = NULL;
+const float *decP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *rowP = NULL;
+uint16_t *u16P = NULL;
+float *fscratchP = NULL;
+float *dstP = NULL;
+size_t len;
+size_t i;
+unsigned int y;
+
+  if (RGB24P(ingimageP) || RGB48P(ingimageP)) {
+    decP = csTable(CS_SRGB, (RGB24P(ingimageP) ? 8 : 16), 0);
+    scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+    fscratchP = malloc(imageRowBytes(IRGBF32, ingimageP->width));
+    rgiP = newLargeImage(IRGBF32, ingimageP->width, ingimageP->height);
+    if (decP == NULL || scratchP == NULL || fscratchP == NULL) {
+      fprintf(stderr, "colorspace malloc error\n");
+      freeImage(rgiP);
+      rgiP = NULL;
+    }
+  }
+  len = (size_t)ingimageP->width * 3;
+  for (y = 0; rgiP != NULL && y < ingimageP->height; y++) {
+    rowP = imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+    if (rowP == NULL) {
+      freeImage(rgiP);
+      rgiP = NULL;
+    } else {
+      /* tiled output is built in scratch, then stored */
+      if (TILEDP(rgiP)) {
+        dstP = fscratchP;
+      } else {
+        dstP = (float *)imageRowP(rgiP, 0, y, ingimageP->width,
+          (unsigned char *)fscratchP);
+      }
+      if (RGB24P(ingimageP)) {
+        for (i = 0; i < len; i++) {
+          dstP[i] = decP[rowP[i]];
+        }
+      } else {
+        u16P = (uint16_t *)rowP;
+        for (i = 0; i < len; i++) {
+          dstP[i] = decP[u16P[i]];
+        }
+      }
+      imagePutRow(rgiP, y, (unsigned char *)dstP);
+    }
+  }
+  if (rgiP != NULL) {
+    rgiP->gamma = ingimageP->gamma;
+    memcpy(rgiP->title, ingimageP->title, sizeof(rgiP->title));
+  }
+  free(scratchP);
+  free(fscratchP);
+  return(rgiP);
+}
+
+
+/*******************/
+/* csEncodeImage() */
+/*******************/
+gImage*
+csEncodeImage(
+ gImage *ingimageP,
+ unsigned int inType)
+{
+gImage *rgiP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *dstscratchP = NULL;
+unsigned char *dstP = NULL;
+uint16_t *u16P = NULL;
+const float *rowP = NULL;
+double v;
+double max;
+size_t len;
+size_t i;
+unsigned int y;
+
+  if (RGBF32P(ingimageP) && (inType == IRGB24 || inType == IRGB48)) {
+    scratchP = malloc(imageRowBytes(IRGBF32, ingimageP->width));
+    dstscratchP = malloc(imageRowBytes(inType, ingimageP->width));
+    rgiP = newLargeImage(inType, ingimageP->width, ingimageP->height);
+    if (scratchP == NULL || dstscratchP == NULL) {
+      fprintf(stderr, "colorspace malloc error\n");
+      freeImage(rgiP);
+      rgiP = NULL;
+    }
+  }
+  len = (size_t)ingimageP->width * 3;
+  max = (inType == IRGB24 ? 255.0 : 65535.0);
+  for (y = 0; rgiP != NULL && y < ingimageP->height; y++) {
+    rowP = (const float *)imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+    if (rowP == NULL) {
+      freeImage(rgiP);
+      rgiP = NULL;
+    } else {
+      if (TILEDP(rgiP)) {
+        dstP = dstscratchP;
+      } else {
+        dstP = imageRowP(rgiP, 0, y, ingimageP->width, dstscratchP);
+      }
+      /* exact, as zoom() encodes its reductions */
+      u16P = (uint16_t *)dstP;
+      for (i = 0; i < len; i++) {
+        v = rowP[i];
+        if (v < 0.0) {
+          v = 0.0;
+        } else if (v > 1.0) {
+          v = 1.0;
+        }
+        v = rint(max * lin2sRGB(v));
+        if (inType == IRGB24) {
+          dstP[i] = (unsigned char)v;
+        } else {
+          u16P[i] = (uint16_t)v;
+        }
+      }
+      imagePutRow(rgiP, y, dstP);
+    }
+  }
+  if (rgiP != NULL) {
+    rgiP->gamma = ingimageP->gamma;
+    memcpy(rgiP->title, ingimageP->title, sizeof(rgiP->title));
+  }
+  free(scratchP);
+  free(dstscratchP);
+  return(rgiP);
+}
+
+
 /* linearization - assuming the input is integer discretized and 8 bit */
 /*  much faster to use a precomputed lookup table (array) */
 
@@ -897,4 +1473,3 @@ long double aRGBlin[256] = {
 0.982832301032851582163L,
 0.991395886924351911419L,
 1.0L};
-
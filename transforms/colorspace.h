@@ -19,6 +19,22 @@
  * \#include "colorspace.h"
  */
 
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint16_t */
+
+#include "../gimage.h" /* 'gImage' struct */
+
+/* colorspaces of the whole buffer conversions */
+/*  sRGB and AdobeRGB are encoded (gamma) components [0...1], */
+/*  XYZ is D65 with Y of white 1, CIELAB is D65 with L [0...100] */
+#define CS_SRGB (0)
+#define CS_ARGB (1)
+#define CS_XYZ  (2)
+#define CS_LAB  (3)
+
+/* entries of the encode tables, indexed by linear value * (CS_ENCSIZE - 1) */
+#define CS_ENCSIZE (65536)
+
 /* linearization - assuming 8bit component starting point */
 /*  lookup table (array) much faster */
 extern long double sRGBlin[256];
@@ -154,5 +170,97 @@ void XYZ2Lab(double X, double Y, double Z, double *L, double *a, double *b);
 void Lab2XYZ(double L, double a, double b, double *X, double *Y, double *Z);
 
 
+
+/* whole buffers */
+/*  out of range input is not reported per pixel: each function */
+/*  returns how many output samples were clipped to [0...1] */
+/*  input and output may be the same buffer */
+
+/** csMatrix
+ * @ingroup colorspace
+ * @param[in] from CS_SRGB, CS_ARGB or CS_XYZ
+ * @param[in] to CS_SRGB, CS_ARGB or CS_XYZ
+ * @param[out] m 3x3, row major
+ *
+ * the matrix from linear from to linear to, as used by the conversions below
+ */
+void csMatrix(unsigned int from, unsigned int to, float *m);
+
+/** csConvertFloat
+ * @ingroup colorspace
+ * @param[in] in interleaved triples
+ * @param[out] out interleaved triples
+ * @param[in] npix number of pixels
+ * @param[in] from CS_SRGB, CS_ARGB, CS_XYZ or CS_LAB
+ * @param[in] to CS_SRGB, CS_ARGB, CS_XYZ or CS_LAB
+ * @return samples clipped, only RGB outputs are clipped
+ */
+size_t csConvertFloat(const float *in, float *out, size_t npix, unsigned int from, unsigned int to);
+
+/** csConvert8
+ * @ingroup colorspace
+ * @param[in] in interleaved 8 bit RGB
+ * @param[out] out interleaved 8 bit RGB
+ * @param[in] npix number of pixels
+ * @param[in] from CS_SRGB or CS_ARGB
+ * @param[in] to CS_SRGB or CS_ARGB
+ * @return samples clipped
+ */
+size_t csConvert8(const unsigned char *in, unsigned char *out, size_t npix, unsigned int from, unsigned int to);
+
+/** csConvert16
+ * @ingroup colorspace
+ * @param[in] in interleaved 16 bit RGB
+ * @param[out] out interleaved 16 bit RGB
+ * @param[in] npix number of pixels
+ * @param[in] from CS_SRGB or CS_ARGB
+ * @param[in] to CS_SRGB or CS_ARGB
+ * @return samples clipped
+ */
+size_t csConvert16(const uint16_t *in, uint16_t *out, size_t npix, unsigned int from, unsigned int to);
+
+/** csConvertImage
+ * @ingroup colorspace
+ * @param[in,out] gimageP IRGB24 or IRGB48, converted in place
+ * @param[in] from CS_SRGB or CS_ARGB
+ * @param[in] to CS_SRGB or CS_ARGB
+ * @return samples clipped
+ *
+ * bitmaps are unchanged
+ */
+size_t csConvertImage(gImage *gimageP, unsigned int from, unsigned int to);
+
+
+/* linear light images */
+
+/** csEncodeTable8
+ * @ingroup colorspace
+ * @return CS_ENCSIZE entries, linear sRGB * (CS_ENCSIZE - 1) to
+ *  8 bit encoded sRGB, or NULL if out of memory
+ *
+ * built on first use and kept, safe from any thread
+ */
+const unsigned char* csEncodeTable8(void);
+
+/** csLinearImage
+ * @ingroup colorspace
+ * @param[in] gimageP IRGB24 or IRGB48 (sRGB)
+ * @return new IRGBF32 of the same pixels in linear light,
+ *  NULL for other types or if out of memory
+ */
+gImage* csLinearImage(gImage *gimageP);
+
+/** csEncodeImage
+ * @ingroup colorspace
+ * @param[in] gimageP IRGBF32
+ * @param[in] gitype IRGB24 or IRGB48
+ * @return new image encoded to sRGB, NULL for other types or
+ *  if out of memory
+ *
+ * linear values outside [0...1] are clipped, each sample is
+ * rounded once, to the same value zoom() gives
+ */
+gImage* csEncodeImage(gImage *gimageP, unsigned int gitype);
+
 #endif
 
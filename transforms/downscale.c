@@ -28,24 +28,46 @@
 /* External functions */
    /* NONE */
 /* Structures and unions */
-   /* NONE */
+
+/* row source for downscale(), whole image already in memory */
+struct arraysrc_struct {
+ const float  *src;
+ unsigned int  src_xdim;
+ unsigned char samp_per_pixel;
+};
+
 /* Signal catching functions */
    /* NONE */
 
 /* Functions */
 
-/***************/
-/* downscale() */
-/***************/
-/* assumes RGB in range [0,1] (not integer 0-255) */
-/* ideally would be linearized RGB floating point */
-/* assumes 2 dimensional square pixels */
-/* assumes 3 components (no good for images with alpha or grayscale) */
-/* process along rowlines = x-direction */
+/****************/
+/* arrayRowFn() */
+/****************/
+static const float*
+arrayRowFn(
+ void *inCtx,
+ unsigned int inY)
+{
+struct arraysrc_struct *arrayP = inCtx;
+
+  return(arrayP->src + (size_t)inY * arrayP->src_xdim * arrayP->samp_per_pixel);
+}
+
+
+/*******************/
+/* downscaleRows() */
+/*******************/
+/* same area weighting as downscale(), but pulls src one row at a time */
+/*  so the source never has to be in memory as one float array */
+/* each dst row accumulates the src rows it covers, in double */
+/*  per dst pixel the sum order is ys outer, xs inner, */
+/*  so results are identical to the all-in-memory version */
 int
-downscale(
+downscaleRows(
  unsigned char samp_per_pixel,
- const float *src,
+ downscaleRowFn getrow,
+ void *ctx,
  unsigned int src_xdim,
  unsigned int src_ydim,
  float *dst,
@@ -57,79 +79,113 @@ int status = 0;
 /* internal floating point in double precision */
 double yratio, xratio;
 double area;
-double sum1, sum2, sum3;
 double fy, fx;
-
-double sy1, sx1; /* (fractional) coord of dst pixel in src coord system */
-  /* x=0 represents left edge of left most pixel,
-     x=src_xdim-1 represents left edge of last pixel in row,
-     x=src_xdim represents right edge of last pixel in row */
-double fsy0, fsx0, fsy1, fsx1; /* fractional part of coords */
-double isy0, isx0, isy1, isx1; /* integer part of coords */
-
-/* the only integer values, the indices */
+double *accP = NULL;   /* one dst row of sums */
+
+double sy1;            /* (fractional) coord of dst pixel in src coord system */
+  /* y=0 represents top edge of top most pixel */
+double fsy0, fsy1;     /* fractional part of coords */
+double isy0, isy1;     /* integer part of coords */
+
+/* per dst column, precomputed: start, fractions, end in src */
+unsigned int *xs0P = NULL;
+double *fx0P = NULL;
+double *isx1P = NULL;
+double *fsx1P = NULL;
+double *sx1P = NULL;
+double sx1, fsx1, isx1, fsx0, isx0;
+
+const float *rowP = NULL;
+float *dstP = NULL;
+unsigned int spp;
+unsigned int c;
 unsigned int yd, xd;   /* dst pixel indices */
 unsigned int ys, xs;   /* src pixel indices */
 
+  spp = samp_per_pixel;
+
   /* input checking */
   /*  must avoid divide by zero */
   if ( (src_ydim == 0) || (src_xdim == 0) ||
-       (dst_ydim == 0) || (dst_xdim == 0) ) {
+       (dst_ydim == 0) || (dst_xdim == 0) || (spp == 0) ) {
     fprintf(stderr, "error: dimensions cannot be zero\n");
     status = -1;
   } else {
+    accP  = malloc(sizeof(double) * spp * (size_t)dst_xdim);
+    xs0P  = malloc(sizeof(unsigned int) * (size_t)dst_xdim);
+    fx0P  = malloc(sizeof(double) * (size_t)dst_xdim);
+    isx1P = malloc(sizeof(double) * (size_t)dst_xdim);
+    fsx1P = malloc(sizeof(double) * (size_t)dst_xdim);
+    sx1P  = malloc(sizeof(double) * (size_t)dst_xdim);
+    if (accP == NULL || xs0P == NULL || fx0P == NULL ||
+        isx1P == NULL || fsx1P == NULL || sx1P == NULL) {
+      fprintf(stderr, "error: downscale malloc\n");
+      status = -1;
+    }
+  }
+
+  if (status == 0) {
 
     yratio = (double)src_ydim / dst_ydim;
     xratio = (double)src_xdim / dst_xdim;
     area = yratio * xratio; /* must not be zero */
 
+    /* columns are the same for every row */
+    isx0 = 0.0;
+    fsx0 = 0.0;
+    for (xd = 0; xd < dst_xdim; xd++) {
+       sx1 = ((xd+1.0)/dst_xdim) * src_xdim;
+      fsx1 = modf(sx1, &isx1);
+      xs0P[xd]  = isx0;
+      fx0P[xd]  = 1.0 - fsx0;
+      isx1P[xd] = isx1;
+      fsx1P[xd] = fsx1;
+      sx1P[xd]  = sx1;
+      isx0 = isx1;
+      fsx0 = fsx1;
+    }
 
     isy0 = 0.0;
     fsy0 = 0.0;
-    for (yd = 0; yd < dst_ydim; yd++) {
+    for (yd = 0; yd < dst_ydim && status == 0; yd++) {
        sy1 = ((yd+1.0)/dst_ydim) * src_ydim;
       fsy1 = modf(sy1, &isy1);
 
-      isx0 = 0.0;
-      fsx0 = 0.0;
-      for (xd = 0; xd < dst_xdim; xd++) {
-
-         sx1 = ((xd+1.0)/dst_xdim) * src_xdim;
-        fsx1 = modf(sx1, &isx1);
+      for (xd = 0; xd < spp * dst_xdim; xd++) {
+        accP[xd] = 0.0;
+      }
 
-        /* assumes 3 components */
-        sum1 = 0.0;
-        sum2 = 0.0;
-        sum3 = 0.0;
+      ys = isy0;
+      fy = 1.0 - fsy0;
+      do {
 
-        ys = isy0;
-        fy = 1.0 - fsy0;
-        do {
+        rowP = getrow(ctx, ys);
+        if (rowP == NULL) {
+          fprintf(stderr, "error: downscale source row %u\n", ys);
+          status = -1;
+          break;
+        }
 
-          xs = isx0;
-          fx = 1.0 - fsx0;
+        for (xd = 0; xd < dst_xdim; xd++) {
+          xs = xs0P[xd];
+          fx = fx0P[xd];
           do {
-
-            sum1 += src[3*(ys*src_xdim + xs)   ] * fy * fx;
-            sum2 += src[3*(ys*src_xdim + xs) +1] * fy * fx;
-            sum3 += src[3*(ys*src_xdim + xs) +2] * fy * fx;
-
+            for (c = 0; c < spp; c++) {
+              accP[xd*spp + c] += rowP[(size_t)xs*spp + c] * fy * fx;
+            }
             xs++;
-            fx = (xs < isx1 ? 1.0 : fsx1);
-          } while (xs < sx1);
-
-          ys++;
-          fy = (ys < isy1 ? 1.0 : fsy1);
-        } while (ys < sy1);
-
-        /* set dest pixel */
-        /* if need function, something like putPixel(xd, yd, R, G, B) */
-        dst[3*(yd*dst_xdim + xd)    ] = sum1 / area;
-        dst[3*(yd*dst_xdim + xd) + 1] = sum2 / area;
-        dst[3*(yd*dst_xdim + xd) + 2] = sum3 / area;
-
-        isx0 = isx1;
-        fsx0 = fsx1;
+            fx = (xs < isx1P[xd] ? 1.0 : fsx1P[xd]);
+          } while (xs < sx1P[xd]);
+        }
+
+        ys++;
+        fy = (ys < isy1 ? 1.0 : fsy1);
+      } while (ys < sy1);
+
+      /* set dest row */
+      dstP = dst + (size_t)yd * dst_xdim * spp;
+      for (xd = 0; xd < spp * dst_xdim; xd++) {
+        dstP[xd] = accP[xd] / area;
       }
 
       isy0 = isy1;
@@ -137,6 +193,41 @@ unsigned int ys, xs;   /* src pixel indices */
     }
   }
 
+  free(accP);
+  free(xs0P);
+  free(fx0P);
+  free(isx1P);
+  free(fsx1P);
+  free(sx1P);
+
   return(status);
 }
 
+
+/***************/
+/* downscale() */
+/***************/
+/* assumes RGB in range [0,1] (not integer 0-255) */
+/* ideally would be linearized RGB floating point */
+/* assumes 2 dimensional square pixels */
+/* samp_per_pixel components per pixel, interleaved */
+/* process along rowlines = x-direction */
+int
+downscale(
+ unsigned char samp_per_pixel,
+ const float *src,
+ unsigned int src_xdim,
+ unsigned int src_ydim,
+ float *dst,
+ unsigned int dst_xdim,
+ unsigned int dst_ydim)
+{
+struct arraysrc_struct arraysrc;
+
+  arraysrc.src = src;
+  arraysrc.src_xdim = src_xdim;
+  arraysrc.samp_per_pixel = samp_per_pixel;
+
+  return(downscaleRows(samp_per_pixel, arrayRowFn, &arraysrc,
+    src_xdim, src_ydim, dst, dst_xdim, dst_ydim));
+}
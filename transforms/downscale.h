@@ -15,7 +15,7 @@
 /* assumes RGB in range [0,1] (not integer 0-255) */
 /* ideally would be linearized RGB floating point */
 /* assumes 2 dimensional square pixels */
-/* assumes 3 components (no good for images with alpha or grayscale) */
+/* samp_per_pixel components per pixel, interleaved */
 /* process along rowlines = x-direction */
 /* return 0 on success (no error), -1 on error */
 int downscale(unsigned char samp_per_pixel,
@@ -23,5 +23,21 @@ int downscale(unsigned char samp_per_pixel,
  float *dst, unsigned int dst_xdim, unsigned int dst_ydim);
 
 
+/** downscaleRowFn */
+/* supplies row y of the source, src_xdim * samp_per_pixel floats */
+/*  return NULL on error */
+/*  rows are requested in increasing order, a row may be asked for twice */
+typedef const float* (*downscaleRowFn)(void *ctx, unsigned int y);
+
+/** downscaleRows */
+/* same as downscale(), but the source is read a row at a time */
+/*  through getrow, so it never needs to be one float array */
+/* return 0 on success (no error), -1 on error */
+int downscaleRows(unsigned char samp_per_pixel,
+ downscaleRowFn getrow, void *ctx,
+ unsigned int src_xdim, unsigned int src_ydim,
+ float *dst, unsigned int dst_xdim, unsigned int dst_ydim);
+
+
 #endif
 
@@ -8,26 +8,214 @@
 /* xopenimage project under the "ISC license" */
 /*  see LICENSE.txt */ 
 
+/* Feature test switches */
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
 /* C System */
 #include <stdlib.h>
 #include <stdio.h>     /* fprintf */
+#include <math.h>      /* pow */
+#include <stdint.h>    /* uint16_t */
+#include <pthread.h>
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
 
 #include "gamma.h"     /* declarations */
 
+
+/* INTERNAL */
+/* structures */
+/* one table per (source gamma, target gamma) pair */
+/*  tables are never freed, so pointers handed out stay valid */
+/*  a run only sees the few gamma values given on the command line */
+struct gammatable_struct {
+ float  srcgamma;
+ float  dstgamma;
+ unsigned int bits;    /* 8 or 16 */
+ void  *table;         /* 256 unsigned char, or 65536 uint16_t */
+ struct gammatable_struct *next;
+};
+
+/* data */
+static struct gammatable_struct *gammaTables = NULL;
+static pthread_mutex_t gammaLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* internal (static) functions */
+
+/****************/
+/* gammaTable() */
+/****************/
+/* cached table of (2^inBits) entries: in ^ (srcgamma / dstgamma) */
+/*  NULL if out of memory */
+static const void*
+gammaTable(
+ float inSrcGamma,
+ float inDstGamma,
+ unsigned int inBits)
+{
+struct gammatable_struct *tP = NULL;
+unsigned char *t8P = NULL;
+uint16_t *t16P = NULL;
+const void *rtableP = NULL;
+double exponent;
+double max;
+size_t n;
+size_t i;
+
+  pthread_mutex_lock(&gammaLock);
+
+  for (tP = gammaTables; tP != NULL; tP = tP->next) {
+    if (tP->bits == inBits && tP->srcgamma == inSrcGamma &&
+        tP->dstgamma == inDstGamma) {
+      rtableP = tP->table;
+      break;
+    }
+  }
+
+  if (rtableP == NULL) {
+    n = (size_t)1 << inBits;
+    max = n - 1;
+    exponent = (double)inSrcGamma / inDstGamma;
+    tP = malloc(sizeof(struct gammatable_struct));
+    if (tP != NULL) {
+      tP->table = malloc(n * (inBits == 8 ? 1 : sizeof(uint16_t)));
+    }
+    if (tP == NULL || tP->table == NULL) {
+      fprintf(stderr, "gamma error: malloc\n");
+      free(tP);
+    } else {
+      if (inBits == 8) {
+        t8P = tP->table;
+        for (i = 0; i < n; i++) {
+          t8P[i] = (unsigned char)(max * pow(i / max, exponent) + 0.5);
+        }
+      } else {
+        t16P = tP->table;
+        for (i = 0; i < n; i++) {
+          t16P[i] = (uint16_t)(max * pow(i / max, exponent) + 0.5);
+        }
+      }
+      tP->srcgamma = inSrcGamma;
+      tP->dstgamma = inDstGamma;
+      tP->bits = inBits;
+      tP->next = gammaTables;
+      gammaTables = tP;
+      rtableP = tP->table;
+    }
+  }
+
+  pthread_mutex_unlock(&gammaLock);
+
+  return(rtableP);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/*****************/
+/* gammaTable8() */
+/*****************/
+const unsigned char*
+gammaTable8(
+ float inSrcGamma,
+ float inDstGamma)
+{
+  return(gammaTable(inSrcGamma, inDstGamma, 8));
+}
+
+
+/******************/
+/* gammaTable16() */
+/******************/
+const uint16_t*
+gammaTable16(
+ float inSrcGamma,
+ float inDstGamma)
+{
+  return(gammaTable(inSrcGamma, inDstGamma, 16));
+}
+
+
 /******************/
 /* gammacorrect() */
 /******************/
+/* values over 1.0 brighten, under 1.0 darken: each channel */
+/*  becomes in ^ (1 / inGamma), by a table lookup */
+/*  linear images are done in one pass over data, tiled ones by row */
 void
 gammacorrect(
  gImage* ingimageP,
  float inGamma,
  unsigned int inVerbose)
 {
-  if (inVerbose != 0) {
-    fprintf(stderr, "gammacorrect() called\n");
+const unsigned char *t8P = NULL;
+const uint16_t *t16P = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *rowP = NULL;
+uint16_t *pP = NULL;
+size_t rowbytes;
+size_t n;
+size_t i;
+unsigned int nrows;
+unsigned int y;
+
+  if (inGamma <= 0.0) {
+    fprintf(stderr, "gamma %g not possible\n", inGamma);
+  } else if (inGamma != 1.0 &&
+             (RGB24P(ingimageP) || RGB48P(ingimageP))) {
+
+    if (inVerbose != 0) {
+      printf("gamma correcting by %g\n", inGamma);
+    }
+
+    /* target gamma so that src / dst is 1 / inGamma */
+    if (RGB24P(ingimageP)) {
+      t8P = gammaTable8(ingimageP->gamma, ingimageP->gamma * inGamma);
+    } else {
+      t16P = gammaTable16(ingimageP->gamma, ingimageP->gamma * inGamma);
+    }
+    rowbytes = imageRowBytes(ingimageP->gitype, ingimageP->width);
+
+    if (TILEDP(ingimageP)) {
+      nrows = ingimageP->height;
+      scratchP = malloc(rowbytes);
+      if (scratchP == NULL) {
+        fprintf(stderr, "gamma error: malloc\n");
+        nrows = 0;
+      }
+      n = rowbytes;
+    } else {
+      /* linear: data is one run of rows */
+      nrows = 1;
+      n = rowbytes * ingimageP->height;
+    }
+
+    for (y = 0; y < nrows && (t8P != NULL || t16P != NULL); y++) {
+      if (TILEDP(ingimageP)) {
+        rowP = imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+      } else {
+        rowP = ingimageP->data;
+      }
+      if (rowP == NULL) {
+        continue;
+      }
+      if (t8P != NULL) {
+        for (i = 0; i < n; i++) {
+          rowP[i] = t8P[rowP[i]];
+        }
+      } else {
+        pP = (uint16_t *)rowP;
+        for (i = 0; i < n / 2; i++) {
+          pP[i] = t16P[pP[i]];
+        }
+      }
+      if (TILEDP(ingimageP)) {
+        imagePutRow(ingimageP, y, rowP);
+      }
+    }
+
+    free(scratchP);
   }
 }
-
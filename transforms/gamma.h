@@ -18,15 +18,41 @@
  * \#include "gamma.h"
  */
 
+#include <stdint.h>     /* uint16_t */
+
 #include "../gimage.h" /* 'gImage' struct */
 
+/** gammaTable8
+ * @ingroup gamma
+ * @param[in] srcgamma gamma the values are encoded with
+ * @param[in] dstgamma gamma wanted
+ * @return 256 entry table of v ^ (srcgamma / dstgamma), NULL if no memory
+ *
+ * tables are built once per pair and kept, safe from any thread
+ */
+const unsigned char* gammaTable8(float srcgamma, float dstgamma);
+
+
+/** gammaTable16
+ * @ingroup gamma
+ * @param[in] srcgamma gamma the values are encoded with
+ * @param[in] dstgamma gamma wanted
+ * @return 65536 entry table of v ^ (srcgamma / dstgamma), NULL if no memory
+ *
+ * tables are built once per pair and kept, safe from any thread
+ */
+const uint16_t* gammaTable16(float srcgamma, float dstgamma);
+
+
 /** gammacorrect 
  * @ingroup gamma
  * @param[in,out] gimageP Image to correct gamma 
- * @param[in] gamma gamma value
+ * @param[in] gamma gamma value, over 1.0 brightens
  * @param[in] verbose flag for verbose output
  *
- * gamma corrects an Image (in-place)
+ * gamma corrects an Image (in-place).
+ * bitmaps are unchanged.
+ * for display only, gdsetgamma() does the same while drawing.
  */
 void gammacorrect(gImage *gimageP, float gamma, unsigned int verbose);
 
@@ -0,0 +1,631 @@
+/* icc.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+/* embedded ICC profiles to sRGB */
+
+/* only RGB matrix / TRC profiles are understood: three colorants */
+/*  (rXYZ gXYZ bXYZ) and three tone curves (rTRC gTRC bTRC). */
+/*  that covers camera and editing spaces like AdobeRGB, ProPhoto and */
+/*  Display P3. profiles that are only lookup tables are left alone. */
+/* the chain from encoded profile RGB to linear sRGB, curves, */
+/*  colorants, D50 to D65 and colorspace.c's XYZ to sRGB matrix, is */
+/*  sampled once on an ICC_GRID^3 lattice. pixels are tetrahedrally */
+/*  interpolated in it, clamped, then encoded by table lookup. */
+/*  linear output interpolates well where it crosses 0, which the */
+/*  steep sRGB curve there would not */
+/* reference: ICC.1:2010 (profile version 4.3) */
+
+/* Feature test switches */
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
+/* C System */
+#include <stdlib.h>
+#include <stdio.h>     /* fprintf */
+#include <string.h>    /* memcmp, memcpy */
+#include <stdint.h>    /* uint32_t, uint64_t */
+#include <math.h>      /* pow, fabs, isfinite */
+#include <pthread.h>
+
+/* code base */
+#include "../gimage.h" /* 'gImage' struct */
+#include "colorspace.h" /* csMatrix, lin2sRGB */
+
+#include "icc.h"       /* declarations */
+
+
+/* INTERNAL */
+/* macros */
+#define ICC_NODES ((size_t)ICC_GRID * ICC_GRID * ICC_GRID)
+/* entries of the encode table, indexed by linear value */
+#define ICC_ENCSIZE (65536)
+/* a transform that moves no 8 bit value by this much is not used */
+#define ICC_IDENTITY (1.0 / 255.0)
+
+/* structures */
+/* one per distinct profile, never freed, so icclut handles stay valid */
+/*  profiles that can not or need not be converted are kept too, */
+/*  with gridP NULL, so each is only parsed once */
+struct icclut_struct {
+ uint64_t hash;         /* FNV-1a of the profile */
+ size_t   len;
+ unsigned char *profileP; /* copy, to tell apart equal hashes */
+ float   *gridP;        /* ICC_NODES linear sRGB triples, r slowest */
+ int      matrix;       /* 0 if not an RGB matrix / TRC profile */
+ char     desc[64];     /* profile description, for verbose */
+ struct icclut_struct *next;
+};
+
+/* data */
+static struct icclut_struct *iccLuts = NULL;
+static pthread_mutex_t iccLock = PTHREAD_MUTEX_INITIALIZER;
+/* linear * (ICC_ENCSIZE - 1) to encoded sRGB, built with the first lut */
+static uint16_t *iccEnc = NULL;
+static unsigned char *iccEnc8 = NULL;
+
+/* Bradford chromatic adaptation, ICC D50 to the D65 of colorspace.c */
+static const double d50to65[9] = {
+  0.9555766, -0.0230393,  0.0631636,
+ -0.0282895,  1.0099416,  0.0210077,
+  0.0122982, -0.0204830,  1.3299098
+};
+
+
+/* internal (static) functions */
+
+/************/
+/* iccU32() */
+/************/
+/* profiles are big endian */
+static uint32_t
+iccU32(
+ const unsigned char *inP)
+{
+  return((uint32_t)inP[0] << 24 | (uint32_t)inP[1] << 16 |
+         (uint32_t)inP[2] << 8 | inP[3]);
+}
+
+
+/************/
+/* iccS15() */
+/************/
+/* s15Fixed16Number */
+static double
+iccS15(
+ const unsigned char *inP)
+{
+  return((int32_t)iccU32(inP) / 65536.0);
+}
+
+
+/************/
+/* iccTag() */
+/************/
+/* data of tag inSig, NULL if absent or not inside the profile */
+static const unsigned char*
+iccTag(
+ const unsigned char *inProfileP,
+ size_t inLen,
+ const char *inSig,
+ size_t *outLen)
+{
+const unsigned char *rP = NULL;
+const unsigned char *eP = NULL;
+uint32_t ntags;
+uint32_t off;
+uint32_t len;
+uint32_t t;
+
+  ntags = iccU32(inProfileP + 128);
+  for (t = 0; t < ntags && 132 + ((size_t)t + 1) * 12 <= inLen; t++) {
+    eP = inProfileP + 132 + (size_t)t * 12;
+    if (memcmp(eP, inSig, 4) == 0) {
+      off = iccU32(eP + 4);
+      len = iccU32(eP + 8);
+      if (off <= inLen && len <= inLen - off && len >= 8) {
+        rP = inProfileP + off;
+        *outLen = len;
+      }
+      break;
+    }
+  }
+  return(rP);
+}
+
+
+/**************/
+/* iccCurve() */
+/**************/
+/* tone curve tag at ICC_GRID evenly spaced encoded values, to linear */
+/*  'curv' (gamma or sampled table) and 'para' (parametric) types */
+/*  returns 0, or -1 if not a curve this understands, or one that */
+/*  gives NaN or infinity, as a negative base to pow() can */
+static int
+iccCurve(
+ const unsigned char *inTagP,
+ size_t inLen,
+ double *outP)
+{
+int status = 0;
+static const unsigned int nparams[5] = { 1, 3, 4, 5, 7 };
+double p[7] = { 1, 1, 0, 0, 0, 0, 0 };
+double x;
+double pos;
+uint32_t n;
+uint32_t k;
+unsigned int type;
+unsigned int i;
+
+  if (inTagP == NULL) {
+    status = -1;
+  } else if (memcmp(inTagP, "curv", 4) == 0 && inLen >= 12) {
+    n = iccU32(inTagP + 8);
+    if (n > (inLen - 12) / 2) {
+      status = -1;
+    }
+    for (i = 0; status == 0 && i < ICC_GRID; i++) {
+      x = (double)i / (ICC_GRID - 1);
+      if (n == 0) {
+        outP[i] = x;
+      } else if (n == 1) {
+        /* u8Fixed8Number gamma */
+        outP[i] = pow(x, (inTagP[12] * 256 + inTagP[13]) / 256.0);
+      } else {
+        pos = x * (n - 1);
+        k = (uint32_t)pos;
+        if (k >= n - 1) {
+          k = n - 2;
+        }
+        outP[i] = ((inTagP[12 + 2 * k] * 256 + inTagP[13 + 2 * k]) * (1.0 - (pos - k)) +
+          (inTagP[14 + 2 * k] * 256 + inTagP[15 + 2 * k]) * (pos - k)) / 65535.0;
+      }
+    }
+  } else if (memcmp(inTagP, "para", 4) == 0 && inLen >= 12) {
+    type = inTagP[8] * 256 + inTagP[9];
+    if (type > 4 || inLen < 12 + 4 * (size_t)nparams[type]) {
+      status = -1;
+    } else {
+      for (k = 0; k < nparams[type]; k++) {
+        p[k] = iccS15(inTagP + 12 + 4 * k);
+      }
+      /* g a b c d e f */
+      for (i = 0; i < ICC_GRID; i++) {
+        x = (double)i / (ICC_GRID - 1);
+        if (type == 0) {
+          outP[i] = pow(x, p[0]);
+        } else if (type <= 2) {
+          outP[i] = (x >= -p[2] / p[1] ? pow(p[1] * x + p[2], p[0]) : 0.0) +
+            (type == 2 ? p[3] : 0.0);
+        } else if (x >= p[4]) {
+          outP[i] = pow(p[1] * x + p[2], p[0]) + (type == 4 ? p[5] : 0.0);
+        } else {
+          outP[i] = p[3] * x + (type == 4 ? p[6] : 0.0);
+        }
+      }
+    }
+  } else {
+    status = -1;
+  }
+  for (i = 0; status == 0 && i < ICC_GRID; i++) {
+    if (!isfinite(outP[i])) {
+      status = -1;
+    }
+  }
+  return(status);
+}
+
+
+/*************/
+/* iccDesc() */
+/*************/
+/* profile description, as ASCII, "" if none */
+/*  'desc' (version 2) or the first record of 'mluc' (version 4) */
+static void
+iccDesc(
+ const unsigned char *inProfileP,
+ size_t inLen,
+ char *outP,
+ size_t inSize)
+{
+const unsigned char *tP = NULL;
+size_t tlen = 0;
+size_t n = 0;
+size_t off;
+size_t slen;
+size_t i;
+
+  tP = iccTag(inProfileP, inLen, "desc", &tlen);
+  if (tP != NULL && memcmp(tP, "desc", 4) == 0 && tlen >= 12) {
+    for (i = 12; i < tlen && tP[i] != '\0' && n + 1 < inSize; i++) {
+      outP[n++] = tP[i];
+    }
+  } else if (tP != NULL && memcmp(tP, "mluc", 4) == 0 && tlen >= 28) {
+    /* UTF-16 big endian, keep the low byte of each */
+    slen = iccU32(tP + 20);
+    off = iccU32(tP + 24);
+    for (i = off; i + 1 < tlen && i + 1 < off + slen && n + 1 < inSize; i += 2) {
+      outP[n++] = (tP[i] == 0 ? tP[i + 1] : '?');
+    }
+  }
+  outP[n] = '\0';
+}
+
+
+/*************/
+/* iccGrid() */
+/*************/
+/* sample the profile to sRGB on the lattice */
+/*  returns the grid, or NULL if the profile is not RGB matrix / TRC */
+/*  or has a node that is not finite (*outMatrix 0) or converting */
+/*  would change nothing (*outMatrix 1) */
+static float*
+iccGrid(
+ const unsigned char *inProfileP,
+ size_t inLen,
+ int *outMatrix)
+{
+static const char *trcs[3] = { "rTRC", "gTRC", "bTRC" };
+static const char *xyzs[3] = { "rXYZ", "gXYZ", "bXYZ" };
+float *gridP = NULL;
+const unsigned char *tP = NULL;
+size_t tlen = 0;
+double lin[3][ICC_GRID];
+double m[9];
+double t[9];
+float toRGB[9];
+double xyz[3];
+double sum;
+double diff = 0.0;
+int status = 0;
+unsigned int c;
+unsigned int k;
+unsigned int r, g, b;
+size_t i;
+
+  if (inLen < 132 || memcmp(inProfileP + 16, "RGB ", 4) != 0 ||
+      memcmp(inProfileP + 20, "XYZ ", 4) != 0) {
+    status = -1;
+  }
+  for (c = 0; status == 0 && c < 3; c++) {
+    tP = iccTag(inProfileP, inLen, trcs[c], &tlen);
+    status = iccCurve(tP, tlen, lin[c]);
+    if (status == 0) {
+      tP = iccTag(inProfileP, inLen, xyzs[c], &tlen);
+      if (tP == NULL || memcmp(tP, "XYZ ", 4) != 0 || tlen < 20) {
+        status = -1;
+      } else {
+        /* colorant c is column c of the matrix, adapted to D65 */
+        for (k = 0; k < 3; k++) {
+          xyz[k] = iccS15(tP + 8 + 4 * k);
+        }
+        for (k = 0; k < 3; k++) {
+          m[k * 3 + c] = d50to65[k * 3] * xyz[0] + d50to65[k * 3 + 1] * xyz[1] +
+            d50to65[k * 3 + 2] * xyz[2];
+        }
+      }
+    }
+  }
+  *outMatrix = (status == 0);
+  if (status == 0) {
+    gridP = malloc(ICC_NODES * 3 * sizeof(float));
+    if (gridP == NULL) {
+      fprintf(stderr, "ICC error malloc\n");
+    }
+  }
+
+  if (gridP != NULL) {
+    /* profile linear RGB to XYZ to linear sRGB, as one matrix */
+    /*  rows are scaled so the profile's white stays exactly white, */
+    /*  which rounding in the colorants and D50 to D65 would upset */
+    csMatrix(CS_XYZ, CS_SRGB, toRGB);
+    for (k = 0; k < 3; k++) {
+      sum = 0.0;
+      for (c = 0; c < 3; c++) {
+        t[k * 3 + c] = toRGB[k * 3] * m[c] + toRGB[k * 3 + 1] * m[3 + c] +
+          toRGB[k * 3 + 2] * m[6 + c];
+        sum += t[k * 3 + c];
+      }
+      for (c = 0; c < 3; c++) {
+        t[k * 3 + c] /= sum;
+      }
+    }
+
+    i = 0;
+    for (r = 0; r < ICC_GRID; r++) {
+      for (g = 0; g < ICC_GRID; g++) {
+        for (b = 0; b < ICC_GRID; b++) {
+          for (k = 0; k < 3; k++) {
+            gridP[i] = t[k * 3] * lin[0][r] + t[k * 3 + 1] * lin[1][g] +
+              t[k * 3 + 2] * lin[2][b];
+            if (!isfinite(gridP[i])) {
+              status = -1;
+            }
+            i++;
+          }
+        }
+      }
+    }
+    if (status != 0) {
+      /* a degenerate matrix, white summing to 0 */
+      *outMatrix = 0;
+      free(gridP);
+      gridP = NULL;
+    }
+  }
+
+  if (gridP != NULL) {
+    /* an sRGB profile, up to rounding, is not worth a pass */
+    i = 0;
+    for (r = 0; r < ICC_GRID; r++) {
+      for (g = 0; g < ICC_GRID; g++) {
+        for (b = 0; b < ICC_GRID; b++) {
+          diff = fmax(diff, fabs(lin2sRGB(gridP[i++]) - (double)r / (ICC_GRID - 1)));
+          diff = fmax(diff, fabs(lin2sRGB(gridP[i++]) - (double)g / (ICC_GRID - 1)));
+          diff = fmax(diff, fabs(lin2sRGB(gridP[i++]) - (double)b / (ICC_GRID - 1)));
+        }
+      }
+    }
+    if (diff < ICC_IDENTITY) {
+      free(gridP);
+      gridP = NULL;
+    }
+  }
+  return(gridP);
+}
+
+
+/***************/
+/* iccInterp() */
+/***************/
+/* tetrahedral interpolation, inR inG inB in grid units [0...ICC_GRID-1] */
+/*  the cube around the point is cut into six tetrahedra along its */
+/*  diagonal, the one holding the point is picked by the order of the */
+/*  fractions, so only four of the eight corners are read */
+static void
+iccInterp(
+ const float *inGridP,
+ float inR,
+ float inG,
+ float inB,
+ float *outP)
+{
+const size_t sr = (size_t)ICC_GRID * ICC_GRID * 3;
+const size_t sg = (size_t)ICC_GRID * 3;
+const size_t sb = 3;
+const float *c0P = NULL;
+const float *c1P = NULL;
+const float *c2P = NULL;
+const float *c3P = NULL;
+unsigned int ir, ig, ib;
+float fr, fg, fb;
+float w1, w2, w3;
+unsigned int c;
+
+  ir = (unsigned int)inR;
+  ig = (unsigned int)inG;
+  ib = (unsigned int)inB;
+  ir = (ir > ICC_GRID - 2 ? ICC_GRID - 2 : ir);
+  ig = (ig > ICC_GRID - 2 ? ICC_GRID - 2 : ig);
+  ib = (ib > ICC_GRID - 2 ? ICC_GRID - 2 : ib);
+  fr = inR - ir;
+  fg = inG - ig;
+  fb = inB - ib;
+
+  c0P = inGridP + ir * sr + ig * sg + ib * sb;
+  c3P = c0P + sr + sg + sb;
+  if (fr >= fg) {
+    if (fg >= fb) {
+      c1P = c0P + sr; c2P = c0P + sr + sg; w1 = fr; w2 = fg; w3 = fb;
+    } else if (fr >= fb) {
+      c1P = c0P + sr; c2P = c0P + sr + sb; w1 = fr; w2 = fb; w3 = fg;
+    } else {
+      c1P = c0P + sb; c2P = c0P + sr + sb; w1 = fb; w2 = fr; w3 = fg;
+    }
+  } else {
+    if (fb >= fg) {
+      c1P = c0P + sb; c2P = c0P + sg + sb; w1 = fb; w2 = fg; w3 = fr;
+    } else if (fb >= fr) {
+      c1P = c0P + sg; c2P = c0P + sg + sb; w1 = fg; w2 = fb; w3 = fr;
+    } else {
+      c1P = c0P + sg; c2P = c0P + sr + sg; w1 = fg; w2 = fr; w3 = fb;
+    }
+  }
+  for (c = 0; c < 3; c++) {
+    outP[c] = c0P[c] + w1 * (c1P[c] - c0P[c]) + w2 * (c2P[c] - c1P[c]) +
+      w3 * (c3P[c] - c2P[c]);
+  }
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/************/
+/* iccLut() */
+/************/
+icclut
+iccLut(
+ const unsigned char *inProfileP,
+ size_t inLen,
+ unsigned int inVerbose)
+{
+struct icclut_struct *lP = NULL;
+uint64_t hash = 14695981039346656037ULL;
+double e;
+size_t i;
+
+  /* the header's own size, if it is shorter than what was stored */
+  if (inLen >= 4 && iccU32(inProfileP) < inLen) {
+    inLen = iccU32(inProfileP);
+  }
+  for (i = 0; i < inLen; i++) {
+    hash = (hash ^ inProfileP[i]) * 1099511628211ULL;
+  }
+
+  pthread_mutex_lock(&iccLock);
+
+  for (lP = iccLuts; lP != NULL; lP = lP->next) {
+    if (lP->hash == hash && lP->len == inLen &&
+        memcmp(lP->profileP, inProfileP, inLen) == 0) {
+      break;
+    }
+  }
+
+  if (iccEnc == NULL) {
+    iccEnc = malloc(ICC_ENCSIZE * sizeof(uint16_t));
+    iccEnc8 = malloc(ICC_ENCSIZE);
+    for (i = 0; iccEnc != NULL && iccEnc8 != NULL && i < ICC_ENCSIZE; i++) {
+      e = lin2sRGB((double)i / (ICC_ENCSIZE - 1));
+      iccEnc[i] = (uint16_t)(e * 65535.0 + 0.5);
+      iccEnc8[i] = (unsigned char)(e * 255.0 + 0.5);
+    }
+    if (iccEnc8 == NULL) {
+      free(iccEnc);
+      iccEnc = NULL;
+    }
+  }
+
+  if (lP == NULL && iccEnc == NULL) {
+    fprintf(stderr, "ICC error malloc\n");
+  } else if (lP == NULL) {
+    lP = malloc(sizeof(struct icclut_struct));
+    if (lP != NULL) {
+      lP->profileP = malloc(inLen);
+    }
+    if (lP == NULL || lP->profileP == NULL) {
+      fprintf(stderr, "ICC error malloc\n");
+      free(lP);
+      lP = NULL;
+    } else {
+      memcpy(lP->profileP, inProfileP, inLen);
+      lP->hash = hash;
+      lP->len = inLen;
+      lP->desc[0] = '\0';
+      if (inLen >= 132) {
+        iccDesc(inProfileP, inLen, lP->desc, sizeof(lP->desc));
+      }
+      lP->gridP = iccGrid(inProfileP, inLen, &lP->matrix);
+      lP->next = iccLuts;
+      iccLuts = lP;
+    }
+  }
+
+  pthread_mutex_unlock(&iccLock);
+
+  if (lP != NULL && inVerbose) {
+    printf(" ICC profile \"%s\"%s\n", lP->desc,
+      lP->gridP != NULL ? ", converted to sRGB" :
+      lP->matrix == 0 ? ", not a usable RGB matrix profile, not converted" : "");
+  }
+  return(lP != NULL && lP->gridP != NULL ? lP : NULL);
+}
+
+
+/***************/
+/* iccApply8() */
+/***************/
+void
+iccApply8(
+ icclut inLut,
+ unsigned char *ioPixP,
+ size_t inNpix)
+{
+const float scale = (ICC_GRID - 1) / 255.0f;
+float v[3];
+size_t i;
+unsigned int c;
+
+  for (i = 0; i < inNpix; i++) {
+    iccInterp(inLut->gridP, ioPixP[0] * scale, ioPixP[1] * scale,
+      ioPixP[2] * scale, v);
+    for (c = 0; c < 3; c++) {
+      /* NaN to 0 as well, it must not reach the index */
+      v[c] = (!(v[c] > 0.0f) ? 0.0f : v[c] >= 1.0f ? 1.0f : v[c]);
+      ioPixP[c] = iccEnc8[(size_t)(v[c] * (ICC_ENCSIZE - 1) + 0.5f)];
+    }
+    ioPixP += 3;
+  }
+}
+
+
+/****************/
+/* iccApply16() */
+/****************/
+void
+iccApply16(
+ icclut inLut,
+ uint16_t *ioPixP,
+ size_t inNpix)
+{
+const float scale = (ICC_GRID - 1) / 65535.0f;
+float v[3];
+size_t i;
+unsigned int c;
+
+  for (i = 0; i < inNpix; i++) {
+    iccInterp(inLut->gridP, ioPixP[0] * scale, ioPixP[1] * scale,
+      ioPixP[2] * scale, v);
+    for (c = 0; c < 3; c++) {
+      /* NaN to 0 as well, it must not reach the index */
+      v[c] = (!(v[c] > 0.0f) ? 0.0f : v[c] >= 1.0f ? 1.0f : v[c]);
+      ioPixP[c] = iccEnc[(size_t)(v[c] * (ICC_ENCSIZE - 1) + 0.5f)];
+    }
+    ioPixP += 3;
+  }
+}
+
+
+/*********************/
+/* iccConvertImage() */
+/*********************/
+/* linear images are done in one pass over data, tiled ones by row */
+void
+iccConvertImage(
+ gImage *ingimageP,
+ icclut inLut)
+{
+unsigned char *scratchP = NULL;
+unsigned char *rowP = NULL;
+size_t npix;
+unsigned int nrows;
+unsigned int y;
+
+  if (inLut != NULL && (RGB24P(ingimageP) || RGB48P(ingimageP))) {
+    if (TILEDP(ingimageP)) {
+      nrows = ingimageP->height;
+      npix = ingimageP->width;
+      scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+      if (scratchP == NULL) {
+        fprintf(stderr, "ICC error malloc\n");
+        nrows = 0;
+      }
+    } else {
+      nrows = 1;
+      npix = (size_t)ingimageP->width * ingimageP->height;
+    }
+
+    for (y = 0; y < nrows; y++) {
+      if (TILEDP(ingimageP)) {
+        rowP = imageRowP(ingimageP, 0, y, ingimageP->width, scratchP);
+      } else {
+        rowP = ingimageP->data;
+      }
+      if (rowP != NULL) {
+        if (RGB24P(ingimageP)) {
+          iccApply8(inLut, rowP, npix);
+        } else {
+          iccApply16(inLut, (uint16_t *)rowP, npix);
+        }
+        if (TILEDP(ingimageP)) {
+          imagePutRow(ingimageP, y, rowP);
+        }
+      }
+    }
+    free(scratchP);
+  }
+}
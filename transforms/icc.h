@@ -0,0 +1,75 @@
+/* icc.h */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */
+
+#ifndef icc_h
+#define icc_h
+
+/**
+ * @defgroup icc ICC profile routines
+ * embedded ICC profiles, converted to sRGB through a 3D lookup table
+ *
+ * \#include "icc.h"
+ */
+
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint16_t */
+
+#include "../gimage.h" /* 'gImage' struct */
+
+/* nodes per axis of the lookup table */
+#define ICC_GRID (33)
+
+/* RGB to sRGB transform of one profile */
+typedef struct icclut_struct* icclut;
+
+
+/** iccLut
+ * @ingroup icc
+ * @param[in] profileP the embedded profile, as stored in the file
+ * @param[in] len bytes of profile
+ * @param[in] verbose flag for verbose output
+ * @return transform to sRGB, or NULL if no conversion is needed
+ *  or the profile is not an RGB matrix / TRC profile
+ *
+ * transforms are built once per distinct profile and kept,
+ * safe from any thread
+ */
+icclut iccLut(const unsigned char *profileP, size_t len, unsigned int verbose);
+
+
+/** iccApply8
+ * @ingroup icc
+ * @param[in] lut from iccLut()
+ * @param[in,out] pixP interleaved 8 bit RGB, converted in place
+ * @param[in] npix number of pixels
+ */
+void iccApply8(icclut lut, unsigned char *pixP, size_t npix);
+
+
+/** iccApply16
+ * @ingroup icc
+ * @param[in] lut from iccLut()
+ * @param[in,out] pixP interleaved 16 bit RGB, converted in place
+ * @param[in] npix number of pixels
+ */
+void iccApply16(icclut lut, uint16_t *pixP, size_t npix);
+
+
+/** iccConvertImage
+ * @ingroup icc
+ * @param[in,out] gimageP IRGB24 or IRGB48, converted in place
+ * @param[in] lut from iccLut(), nothing is done if NULL
+ *
+ * bitmaps are unchanged
+ */
+void iccConvertImage(gImage *gimageP, icclut lut);
+
+#endif
+
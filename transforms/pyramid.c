@@ -0,0 +1,310 @@
+/* pyramid.c */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */ 
+
+/* Feature test switches */
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
+/* C System */
+#include <stdlib.h>    /* malloc */
+#include <stdio.h>     /* fprintf */
+#include <pthread.h>
+
+/* code base */
+#include "../gimage.h" /* 'gImage' struct */
+
+#include "pyramid.h"   /* declarations */
+
+#include "zoom.h"      /* zoomLinear */
+#include "colorspace.h" /* csEncodeImage */
+#include "../profile.h" /* profileBegin, profileEnd */
+
+
+/* INTERNAL */
+/* structures */
+struct pyramid_struct {
+ gImage         *level[PYR_MAXLEVELS];
+ unsigned int    nlevels;   /* levels wanted, including level 0 */
+ unsigned int    built;     /* levels 0 ... built-1 are done */
+ gImage         *linear;    /* IRGBF32 of level built-1, NULL if none */
+ int             threaded;  /* -1 (true) if the background thread was started */
+ int             stop;      /* -1 (true) asks the thread to finish early */
+ pthread_t       thread;
+ pthread_mutex_t lock;      /* protects level, nlevels, built, stop */
+ pthread_cond_t  cond;      /* signalled each time a level is built */
+ pyrReloadFn     reload;    /* makes level 0 after eviction */
+ void           *reloadctx;
+};
+
+
+/* internal (static) functions */
+
+/****************/
+/* buildLevel() */
+/****************/
+/* next level from the one before, caller holds no lock */
+/*  zoom() only reads its source, so this can run alongside display */
+/*  color levels are reduced in linear light from the unrounded */
+/*  IRGBF32 of the level before, kept in ioPyrP->linear, and each */
+/*  stored level is encoded once, so rounding does not build up */
+/*  ioPyrP->linear is used without the lock, only one builder */
+/*  (the thread, or pyrLevel() when there is none) ever runs */
+static gImage*
+buildLevel(
+ pyramid ioPyrP,
+ gImage *inprevP)
+{
+gImage *rgiP = NULL;
+gImage *srcP = NULL;
+gImage *linP = NULL;
+ProfileSpan span;
+
+  profileBegin(&span);
+  srcP = (ioPyrP->linear != NULL ? ioPyrP->linear : inprevP);
+  linP = zoomLinear(srcP, 50, 50, 0);
+  if (linP == srcP) {
+    linP = NULL;
+  }
+  freeImage(ioPyrP->linear);
+  ioPyrP->linear = NULL;
+
+  if (linP != NULL && RGBF32P(linP) && !RGBF32P(inprevP)) {
+    /* store as the level before, keep the floats for the next */
+    rgiP = csEncodeImage(linP, inprevP->gitype);
+    if (rgiP != NULL) {
+      ioPyrP->linear = linP;
+    } else {
+      freeImage(linP);
+    }
+  } else {
+    rgiP = linP;
+  }
+  profileEnd(&span, "pyramid", inprevP->title);
+  return(rgiP);
+}
+
+
+/**************/
+/* addLevel() */
+/**************/
+/* record a built level, caller holds the lock */
+/*  a failed level ends the pyramid there */
+static void
+addLevel(
+ pyramid ioPyrP,
+ unsigned int inLevel,
+ gImage *ingiP)
+{
+  if (ingiP == NULL) {
+    fprintf(stderr, "pyramid level %u could not be built\n", inLevel);
+    ioPyrP->nlevels = inLevel;
+  } else {
+    ioPyrP->level[inLevel] = ingiP;
+    ioPyrP->built = inLevel + 1;
+  }
+  pthread_cond_broadcast(&ioPyrP->cond);
+}
+
+
+/*****************/
+/* buildThread() */
+/*****************/
+static void*
+buildThread(
+ void *inArgP)
+{
+pyramid pyrP = inArgP;
+gImage *prevP = NULL;
+gImage *giP = NULL;
+unsigned int k;
+
+  profileThreadName("pyramid");
+  pthread_mutex_lock(&pyrP->lock);
+  for (k = pyrP->built; k < pyrP->nlevels && !pyrP->stop; k++) {
+    prevP = pyrP->level[k - 1];
+    pthread_mutex_unlock(&pyrP->lock);
+    giP = buildLevel(pyrP, prevP);
+    pthread_mutex_lock(&pyrP->lock);
+    addLevel(pyrP, k, giP);
+  }
+  /* the last level's floats are not needed */
+  freeImage(pyrP->linear);
+  pyrP->linear = NULL;
+  pthread_mutex_unlock(&pyrP->lock);
+
+  return(NULL);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/************/
+/* pyrNew() */
+/************/
+pyramid
+pyrNew(
+ gImage *inbaseP,
+ pyrReloadFn inReload,
+ void *inCtxP)
+{
+pyramid rpyrP = NULL;
+unsigned int w;
+unsigned int h;
+
+  if (inbaseP != NULL) {
+    rpyrP = calloc(1, sizeof(struct pyramid_struct));
+  }
+  if (rpyrP == NULL) {
+    fprintf(stderr, "pyrNew error\n");
+  } else {
+    rpyrP->level[0] = inbaseP;
+    rpyrP->built = 1;
+    rpyrP->reload = inReload;
+    rpyrP->reloadctx = inCtxP;
+
+    /* halve until a side would be 0 */
+    rpyrP->nlevels = 1;
+    w = inbaseP->width / 2;
+    h = inbaseP->height / 2;
+    while (w > 0 && h > 0 && rpyrP->nlevels < PYR_MAXLEVELS) {
+      rpyrP->nlevels++;
+      w /= 2;
+      h /= 2;
+    }
+
+    pthread_mutex_init(&rpyrP->lock, NULL);
+    pthread_cond_init(&rpyrP->cond, NULL);
+
+    /* tiles read on demand are not safe to read from two threads, */
+    /*  see gImage tilestate */
+    /* computes the memory limit now, not in the thread */
+    imageWantsTiles(inbaseP->gitype, inbaseP->width, inbaseP->height);
+    if (rpyrP->nlevels > 1 && inbaseP->tileread == NULL) {
+      if (pthread_create(&rpyrP->thread, NULL, buildThread, rpyrP) == 0) {
+        rpyrP->threaded = -1;
+      }
+    }
+  }
+
+  return(rpyrP);
+}
+
+
+/***************/
+/* pyrLevels() */
+/***************/
+unsigned int
+pyrLevels(
+ pyramid inPyrP)
+{
+unsigned int n;
+
+  pthread_mutex_lock(&inPyrP->lock);
+  n = inPyrP->nlevels;
+  pthread_mutex_unlock(&inPyrP->lock);
+  return(n);
+}
+
+
+/**************/
+/* pyrLevel() */
+/**************/
+gImage*
+pyrLevel(
+ pyramid inPyrP,
+ unsigned int inLevel)
+{
+gImage *rgiP = NULL;
+gImage *prevP = NULL;
+gImage *giP = NULL;
+unsigned int k;
+
+  pthread_mutex_lock(&inPyrP->lock);
+  if (inPyrP->threaded) {
+    while (inLevel < inPyrP->nlevels && inLevel >= inPyrP->built) {
+      pthread_cond_wait(&inPyrP->cond, &inPyrP->lock);
+    }
+  } else {
+    /* no thread, build what is missing now */
+    for (k = inPyrP->built; k <= inLevel && k < inPyrP->nlevels; k++) {
+      prevP = inPyrP->level[k - 1];
+      giP = buildLevel(inPyrP, prevP);
+      addLevel(inPyrP, k, giP);
+    }
+  }
+  if (inLevel == 0 && inPyrP->level[0] == NULL) {
+    /* evicted, the thread is done so no one else uses level 0 */
+    inPyrP->level[0] = inPyrP->reload(inPyrP->reloadctx);
+  }
+  if (inLevel < inPyrP->nlevels) {
+    rgiP = inPyrP->level[inLevel];
+  }
+  pthread_mutex_unlock(&inPyrP->lock);
+
+  return(rgiP);
+}
+
+
+/**************/
+/* pyrEvict() */
+/**************/
+size_t
+pyrEvict(
+ pyramid inPyrP,
+ const gImage *inKeepP,
+ size_t inMinBytes)
+{
+gImage *giP = NULL;
+size_t nbytes = 0;
+
+  pthread_mutex_lock(&inPyrP->lock);
+  giP = inPyrP->level[0];
+  /* once every level is built, the thread no longer reads level 0 */
+  if (inPyrP->reload != NULL && giP != NULL && giP != inKeepP &&
+      inPyrP->built >= inPyrP->nlevels) {
+    nbytes = imageDataBytes(giP->gitype, giP->width, giP->height);
+    if (nbytes > inMinBytes) {
+      freeImage(giP);
+      inPyrP->level[0] = NULL;
+    } else {
+      nbytes = 0;
+    }
+  }
+  pthread_mutex_unlock(&inPyrP->lock);
+
+  return(nbytes);
+}
+
+
+/*************/
+/* pyrFree() */
+/*************/
+void
+pyrFree(
+ pyramid inPyrP)
+{
+unsigned int k;
+
+  if (inPyrP != NULL) {
+    if (inPyrP->threaded) {
+      pthread_mutex_lock(&inPyrP->lock);
+      inPyrP->stop = -1;
+      pthread_mutex_unlock(&inPyrP->lock);
+      /* waits for a level in progress */
+      pthread_join(inPyrP->thread, NULL);
+    }
+    for (k = 0; k < PYR_MAXLEVELS; k++) {
+      freeImage(inPyrP->level[k]);
+    }
+    freeImage(inPyrP->linear);
+    pthread_mutex_destroy(&inPyrP->lock);
+    pthread_cond_destroy(&inPyrP->cond);
+    free(inPyrP);
+  }
+}
@@ -0,0 +1,86 @@
+/* pyramid.h */
+
+/* Part of xopenimage project */
+/*  portions derived from xloadimage */
+/*   copyright 1993 Jim Frost, "X Consortium license" */
+/*  modified under that license */
+/*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
+/* xopenimage project under the "ISC license" */
+/*  see LICENSE.txt */ 
+
+#ifndef pyramid_h
+#define pyramid_h
+
+/**
+ * @defgroup pyramid  image pyramid
+ * successive 50% (gamma correct) reductions of an image,
+ * for fast interactive zoom out
+ *
+ * \#include "pyramid.h"
+ */
+
+#include "../gimage.h" /* 'gImage' struct */
+
+/* most levels kept, level 0 is the original */
+#define PYR_MAXLEVELS (24)
+
+typedef struct pyramid_struct* pyramid;
+
+/* makes level 0 again after pyrEvict(), NULL on failure */
+typedef gImage* (*pyrReloadFn)(void *ctx);
+
+
+/** pyrNew
+ * @ingroup pyramid
+ * @param[in] basegimageP full size image, the pyramid takes ownership
+ * @param[in] reload function to make basegimageP again, or NULL
+ * @param[in] ctx passed to reload
+ * @return new pyramid, or NULL on error (basegimageP is then not owned)
+ *
+ * levels are built from the previous level in a background thread,
+ * except for tiled images read on demand, which are built when asked for.
+ */
+pyramid pyrNew(gImage *basegimageP, pyrReloadFn reload, void *ctx);
+
+
+/** pyrLevels
+ * @ingroup pyramid
+ * @param[in] pyr
+ * @return number of levels, including level 0
+ */
+unsigned int pyrLevels(pyramid pyr);
+
+
+/** pyrLevel
+ * @ingroup pyramid
+ * @param[in] pyr
+ * @param[in] level 0 for the original, n for 1/(2^n) size
+ * @return the level, waiting for or building it if needed;
+ *  owned by the pyramid, do not free. NULL if no such level.
+ */
+gImage* pyrLevel(pyramid pyr, unsigned int level);
+
+
+/** pyrEvict
+ * @ingroup pyramid
+ * @param[in] pyr
+ * @param[in] keep image in use elsewhere, level 0 is kept if it is this one
+ * @param[in] minbytes level 0 is kept if its data is no larger than this
+ * @return bytes of image data freed, 0 if level 0 is kept
+ *
+ * frees level 0 to save memory. only done if there is a reload
+ * function and the background thread is finished with level 0.
+ * pyrLevel(pyr, 0) reloads it; pyrEvict() never does.
+ */
+size_t pyrEvict(pyramid pyr, const gImage *keep, size_t minbytes);
+
+
+/** pyrFree
+ * @ingroup pyramid
+ * @param[in] pyr
+ *
+ * stops the background thread and frees all levels, including level 0
+ */
+void pyrFree(pyramid pyr);
+
+#endif
@@ -6,17 +6,728 @@
 /*  modified under that license */
 /*   modifications copyright 2026 Nicholas Maus, Douglas Maus */
 /* xopenimage project under the "ISC license" */
-/*  see LICENSE.txt */ 
+/*  see LICENSE.txt */
+
+/* lossless rotation by quarter turns, mirroring, and orientation */
 
 /* C System */
 #include <stdlib.h>
 #include <stdio.h>     /* fprintf */
+#include <string.h>    /* memcpy */
+#include <stdint.h>    /* uint64_t */
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
 
 #include "rotate.h"    /* declarations */
 
+
+/* INTERNAL */
+/* structures */
+/* tilectx of an orientLazy() image */
+struct lazyorient_struct {
+ gImage        *srcP;        /* owned, freed with the oriented image */
+ unsigned int   orientation;
+ unsigned char *scratchP;    /* one source row */
+};
+
+/* data */
+
+/* orientations 1 to 8 as 2x2 matrices a b c d on (x, y), y down: */
+/*  upright (x', y') = (a x + b y, c x + d y) */
+static const int orientMatrix[9][4] = {
+ {  1,  0,  0,  1 }, /* 0, unused */
+ {  1,  0,  0,  1 }, /* 1 */
+ { -1,  0,  0,  1 }, /* 2 mirror left to right */
+ { -1,  0,  0, -1 }, /* 3 turn 180 */
+ {  1,  0,  0, -1 }, /* 4 mirror top to bottom */
+ {  0,  1,  1,  0 }, /* 5 transpose */
+ {  0, -1,  1,  0 }, /* 6 turn 90 clockwise */
+ {  0, -1, -1,  0 }, /* 7 transverse */
+ {  0,  1, -1,  0 }  /* 8 turn 270 clockwise */
+};
+
+/* internal (static) functions */
+
+/*****************/
+/* reverseByte() */
+/*****************/
+/* bit order reversed, left most pixel becomes right most */
+static unsigned char
+reverseByte(
+ unsigned char inB)
+{
+  inB = (inB & 0xf0) >> 4 | (inB & 0x0f) << 4;
+  inB = (inB & 0xcc) >> 2 | (inB & 0x33) << 2;
+  inB = (inB & 0xaa) >> 1 | (inB & 0x55) << 1;
+  return(inB);
+}
+
+
+/****************/
+/* transpose8() */
+/****************/
+/* transpose an 8 x 8 block of bits */
+/*  byte j of the word is row j, bit i of a byte is column i */
+/*  after, byte i is column i of the block, bit j its row j */
+static uint64_t
+transpose8(
+ uint64_t inW)
+{
+uint64_t t;
+
+  t = (inW ^ (inW >> 7)) & 0x00aa00aa00aa00aaULL;
+  inW = inW ^ t ^ (t << 7);
+  t = (inW ^ (inW >> 14)) & 0x0000cccc0000ccccULL;
+  inW = inW ^ t ^ (t << 14);
+  t = (inW ^ (inW >> 28)) & 0x00000000f0f0f0f0ULL;
+  inW = inW ^ t ^ (t << 28);
+  return(inW);
+}
+
+
+/*************/
+/* copyPix() */
+/*************/
+/* one IRGB24, IRGB48 or IRGBF32 pixel */
+/*  fixed size copies, so they compile to plain loads and stores */
+static void
+copyPix(
+ unsigned char *dstP,
+ const unsigned char *srcP,
+ size_t inPixBytes)
+{
+  if (inPixBytes == 3) {
+    memcpy(dstP, srcP, 3);
+  } else if (inPixBytes == 6) {
+    memcpy(dstP, srcP, 6);
+  } else {
+    memcpy(dstP, srcP, 12);
+  }
+}
+
+
+/*************/
+/* getBits() */
+/*************/
+/* 8 pixels of a bitmap row starting at pixel inX, which may be */
+/*  negative or run past the row; pixels outside the row are 0 */
+static unsigned char
+getBits(
+ const unsigned char *rowP,
+ unsigned int inWidth,
+ long inX)
+{
+unsigned int b = 0;
+long byte;
+unsigned int shift;
+
+  if (inX >= 0) {
+    byte = inX / 8;
+    shift = inX % 8;
+    b = rowP[byte] >> shift;
+    if (shift != 0 && (unsigned long)(byte + 1) * 8 < inWidth) {
+      b |= rowP[byte + 1] << (8 - shift);
+    }
+  } else if (inX > -8) {
+    b = rowP[0] << -inX;
+  }
+  /* clear pixels past the row */
+  if (inX + 8 > (long)inWidth) {
+    b &= 0xff >> (inX + 8 - (long)inWidth);
+  }
+  return(b & 0xff);
+}
+
+
+/*************/
+/* putBits() */
+/*************/
+/* OR 8 pixels into a zero filled bitmap row at pixel inX, which */
+/*  may be negative; set pixels must lie inside the row */
+static void
+putBits(
+ unsigned char *rowP,
+ long inX,
+ unsigned char inB)
+{
+unsigned int shift;
+long byte;
+
+  if (inX < 0) {
+    inB >>= -inX;
+    inX = 0;
+  }
+  if (inB != 0) {
+    byte = inX / 8;
+    shift = inX % 8;
+    rowP[byte] |= inB << shift;
+    if (shift != 0 && (inB >> (8 - shift)) != 0) {
+      rowP[byte + 1] |= inB >> (8 - shift);
+    }
+  }
+}
+
+
+/******************/
+/* bitTranspose() */
+/******************/
+/* IBITMAP for orientations 5 to 8, which swap width and height */
+/*  8 x 8 pixel blocks are transposed in a 64 bit word */
+static gImage*
+bitTranspose(
+ gImage *ingimageP,
+ unsigned int inOrientation)
+{
+gImage *rgiP = NULL;
+unsigned char *dstrowP = NULL;
+size_t srowbytes;
+size_t drowbytes;
+unsigned int w;
+unsigned int h;
+unsigned int x0;
+unsigned int y0;
+unsigned int i;
+unsigned int j;
+unsigned char b;
+uint64_t blk;
+
+  w = ingimageP->width;
+  h = ingimageP->height;
+  rgiP = newBitImage(h, w);
+  if (rgiP != NULL) {
+    srowbytes = imageRowBytes(IBITMAP, w);
+    drowbytes = imageRowBytes(IBITMAP, h);
+
+    for (y0 = 0; y0 < h; y0 += 8) {
+      for (x0 = 0; x0 < w; x0 += 8) {
+        /* rows past the image are 0, as are padding pixels */
+        blk = 0;
+        for (j = 0; j < 8 && y0 + j < h; j++) {
+          b = getBits(ingimageP->data + (size_t)(y0 + j) * srowbytes, w, x0);
+          blk |= (uint64_t)b << (8 * j);
+        }
+        blk = transpose8(blk);
+
+        /* byte i is source column x0 + i, bit j source row y0 + j */
+        for (i = 0; i < 8 && x0 + i < w; i++) {
+          b = blk >> (8 * i);
+          /* column x becomes row x (5, 6) or row w - 1 - x (7, 8) */
+          if (inOrientation == 5 || inOrientation == 6) {
+            dstrowP = rgiP->data + (size_t)(x0 + i) * drowbytes;
+          } else {
+            dstrowP = rgiP->data + (size_t)(w - 1 - x0 - i) * drowbytes;
+          }
+          /* row y becomes column y (5, 8) or column h - 1 - y (6, 7) */
+          if (inOrientation == 5 || inOrientation == 8) {
+            putBits(dstrowP, y0, b);
+          } else {
+            putBits(dstrowP, (long)h - 8 - (long)y0, reverseByte(b));
+          }
+        }
+      }
+    }
+  }
+  return(rgiP);
+}
+
+
+/***************/
+/* bitMirror() */
+/***************/
+/* IBITMAP for orientations 2 to 4: mirrored left to right */
+/*  and/or top to bottom */
+static gImage*
+bitMirror(
+ gImage *ingimageP,
+ unsigned int inOrientation)
+{
+gImage *rgiP = NULL;
+const unsigned char *srcP = NULL;
+unsigned char *dstP = NULL;
+size_t rowbytes;
+unsigned int w;
+unsigned int h;
+unsigned int y;
+unsigned int ysrc;
+size_t k;
+
+  w = ingimageP->width;
+  h = ingimageP->height;
+  rgiP = newBitImageUninit(w, h);
+  if (rgiP != NULL) {
+    rowbytes = imageRowBytes(IBITMAP, w);
+    for (y = 0; y < h; y++) {
+      ysrc = (inOrientation == 2 ? y : h - 1 - y);
+      srcP = ingimageP->data + (size_t)ysrc * rowbytes;
+      dstP = rgiP->data + (size_t)y * rowbytes;
+      if (inOrientation != 4) {
+        /* dst byte k is pixels w - 8 - 8k ... w - 1 - 8k, reversed */
+        for (k = 0; k < rowbytes; k++) {
+          dstP[k] = reverseByte(getBits(srcP, w, (long)w - 8 - 8 * (long)k));
+        }
+      } else {
+        memcpy(dstP, srcP, rowbytes);
+      }
+    }
+  }
+  return(rgiP);
+}
+
+
+/***************/
+/* rgbOrient() */
+/***************/
+/* IRGB24, IRGB48 or IRGBF32 in any orientation but 1 */
+/*  ORIENT_ROWS source rows at a time through orientPutRows() */
+/*  rows go through imageRowP(), so tiled images are fine */
+static gImage*
+rgbOrient(
+ gImage *ingimageP,
+ unsigned int inOrientation)
+{
+gImage *rgiP = NULL;
+unsigned char *scratchP = NULL;
+unsigned char *rowP[ORIENT_ROWS];
+size_t rowbytes;
+unsigned int w;
+unsigned int h;
+unsigned int y0;
+unsigned int n;
+unsigned int j;
+int status = 0;
+
+  w = ingimageP->width;
+  h = ingimageP->height;
+  rowbytes = imageRowBytes(ingimageP->gitype, w);
+
+  rgiP = newOrientedImage(ingimageP->gitype, w, h, inOrientation);
+  scratchP = malloc(rowbytes * ORIENT_ROWS);
+  if (rgiP == NULL || scratchP == NULL) {
+    fprintf(stderr, "rotate: malloc error\n");
+    status = -1;
+  }
+
+  for (y0 = 0; y0 < h && status == 0; y0 += n) {
+    n = (h - y0 < ORIENT_ROWS ? h - y0 : ORIENT_ROWS);
+    for (j = 0; j < n && status == 0; j++) {
+      rowP[j] = imageRowP(ingimageP, 0, y0 + j, w, scratchP + j * rowbytes);
+      if (rowP[j] == NULL) {
+        fprintf(stderr, "rotate: source row %u unreadable\n", y0 + j);
+        status = -1;
+      }
+    }
+    if (status == 0) {
+      status = orientPutRows(rgiP, inOrientation, w, h, y0, n, rowP);
+    }
+  }
+
+  if (status != 0) {
+    freeImage(rgiP);
+    rgiP = NULL;
+  }
+  free(scratchP);
+
+  return(rgiP);
+}
+
+
+/*******************/
+/* copyImageInfo() */
+/*******************/
+/* everything but size and pixels, from one gImage to another */
+static void
+copyImageInfo(
+ gImage *indstP,
+ const gImage *insrcP)
+{
+  indstP->gamma = insrcP->gamma;
+  memcpy(indstP->title, insrcP->title, sizeof(indstP->title));
+  memcpy(indstP->background, insrcP->background, sizeof(indstP->background));
+  memcpy(indstP->foreground, insrcP->foreground, sizeof(indstP->foreground));
+}
+
+
+/********************/
+/* lazyOrientRead() */
+/********************/
+/* gImage tileread callback of orientLazy() */
+/*  reads the source rectangle that lands on the tile, row by row, */
+/*  each pixel to (a x + b y, c x + d y) plus the offsets that keep */
+/*  it inside the image, see orientMatrix */
+static int
+lazyOrientRead(
+ gImage *ingiP,
+ unsigned int inTx,
+ unsigned int inTy,
+ unsigned char *outTileP)
+{
+struct lazyorient_struct *loP = ingiP->tilectx;
+const int *mP = NULL;
+int status = 0;
+unsigned char *rowP = NULL;
+unsigned char *dstP = NULL;
+size_t pixbytes;
+size_t tilerowbytes;
+long step;
+long offu;
+long offv;
+long u0, v0, u1, v1;
+long xa, ya, xb, yb;
+long sx0, sy0;
+unsigned int sw;
+unsigned int sh;
+unsigned int i;
+unsigned int j;
+
+  mP = orientMatrix[loP->orientation];
+  pixbytes = imageRowBytes(ingiP->gitype, 1);
+  tilerowbytes = imageRowBytes(ingiP->gitype, ingiP->tiledim);
+  offu = (mP[0] < 0 ? loP->srcP->width - 1 : 0) +
+         (mP[1] < 0 ? loP->srcP->height - 1 : 0);
+  offv = (mP[2] < 0 ? loP->srcP->width - 1 : 0) +
+         (mP[3] < 0 ? loP->srcP->height - 1 : 0);
+
+  /* tile corners, then the source corners by the transposed matrix */
+  u0 = (long)inTx * ingiP->tiledim;
+  v0 = (long)inTy * ingiP->tiledim;
+  u1 = (ingiP->width - u0 > ingiP->tiledim ? u0 + ingiP->tiledim : ingiP->width) - 1;
+  v1 = (ingiP->height - v0 > ingiP->tiledim ? v0 + ingiP->tiledim : ingiP->height) - 1;
+  xa = mP[0] * (u0 - offu) + mP[2] * (v0 - offv);
+  ya = mP[1] * (u0 - offu) + mP[3] * (v0 - offv);
+  xb = mP[0] * (u1 - offu) + mP[2] * (v1 - offv);
+  yb = mP[1] * (u1 - offu) + mP[3] * (v1 - offv);
+  sx0 = (xa < xb ? xa : xb);
+  sy0 = (ya < yb ? ya : yb);
+  sw = (xa < xb ? xb - xa : xa - xb) + 1;
+  sh = (ya < yb ? yb - ya : ya - yb) + 1;
+
+  /* one source pixel to the right moves a in u and c in v */
+  step = mP[0] * (long)pixbytes + mP[2] * (long)tilerowbytes;
+
+  for (j = 0; j < sh && status == 0; j++) {
+    rowP = imageRowP(loP->srcP, sx0, sy0 + j, sw, loP->scratchP);
+    if (rowP == NULL) {
+      status = -1;
+    } else {
+      dstP = outTileP +
+        (mP[0] * sx0 + mP[1] * (sy0 + j) + offu - u0) * (long)pixbytes +
+        (mP[2] * sx0 + mP[3] * (sy0 + j) + offv - v0) * (long)tilerowbytes;
+      for (i = 0; i < sw; i++) {
+        memcpy(dstP, rowP, pixbytes);
+        rowP += pixbytes;
+        dstP += step;
+      }
+    }
+  }
+  return(status);
+}
+
+
+/*********************/
+/* lazyOrientClose() */
+/*********************/
+/* gImage tileclose callback of orientLazy() */
+static void
+lazyOrientClose(
+ void *inCtxP)
+{
+struct lazyorient_struct *loP = inCtxP;
+
+  freeImage(loP->srcP);
+  free(loP->scratchP);
+  free(loP);
+}
+
+
+/* PUBLIC FUNCTIONS */
+
+/**********************/
+/* newOrientedImage() */
+/**********************/
+gImage*
+newOrientedImage(
+ unsigned int inGitype,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ unsigned int inOrientation)
+{
+gImage *rgiP = NULL;
+
+  if (inOrientation >= 5) {
+    rgiP = newLargeImage(inGitype, inHeight, inWidth);
+  } else {
+    rgiP = newLargeImage(inGitype, inWidth, inHeight);
+  }
+  return(rgiP);
+}
+
+
+/*******************/
+/* orientPutRows() */
+/*******************/
+/* orientations 2 to 4 mirror whole rows */
+/* orientations 5 to 8 make each source column part of a */
+/*  destination row; columns are taken ORIENT_ROWS at a time, so */
+/*  the block of source pixels being read stays in cache */
+int
+orientPutRows(
+ gImage *indstP,
+ unsigned int inOrientation,
+ unsigned int inWidth,
+ unsigned int inHeight,
+ unsigned int inY,
+ unsigned int inNrows,
+ unsigned char **inRowsP)
+{
+int status = 0;
+unsigned char *segP = NULL;
+size_t pixbytes;
+unsigned int x0;
+unsigned int bw;
+unsigned int i;
+unsigned int j;
+unsigned int x;
+unsigned int y;
+unsigned int seglen;
+
+  pixbytes = imageRowBytes(indstP->gitype, 1);
+  seglen = (inOrientation >= 5 ? inNrows : inWidth);
+  segP = malloc(pixbytes * seglen);
+  if (segP == NULL) {
+    fprintf(stderr, "rotate: malloc error\n");
+    status = -1;
+
+  } else if (inOrientation <= 4) {
+    for (j = 0; j < inNrows; j++) {
+      y = (inOrientation <= 2 ? inY + j : inHeight - 1 - inY - j);
+      if (inOrientation == 2 || inOrientation == 3) {
+        for (x = 0; x < inWidth; x++) {
+          copyPix(segP + (size_t)x * pixbytes,
+            inRowsP[j] + (size_t)(inWidth - 1 - x) * pixbytes, pixbytes);
+        }
+        imagePutRow(indstP, y, segP);
+      } else {
+        imagePutRow(indstP, y, inRowsP[j]);
+      }
+    }
+
+  } else {
+    for (x0 = 0; x0 < inWidth; x0 += ORIENT_ROWS) {
+      bw = (inWidth - x0 < ORIENT_ROWS ? inWidth - x0 : ORIENT_ROWS);
+      for (i = 0; i < bw; i++) {
+        x = x0 + i;
+        /* column x becomes row x (5, 6) or row w - 1 - x (7, 8) */
+        y = (inOrientation <= 6 ? x : inWidth - 1 - x);
+        /* row y becomes column y (5, 8) or column h - 1 - y (6, 7) */
+        if (inOrientation == 5 || inOrientation == 8) {
+          for (j = 0; j < inNrows; j++) {
+            copyPix(segP + j * pixbytes, inRowsP[j] + (size_t)x * pixbytes,
+              pixbytes);
+          }
+          imagePutPixels(indstP, inY, y, inNrows, segP);
+        } else {
+          for (j = 0; j < inNrows; j++) {
+            copyPix(segP + (inNrows - 1 - j) * pixbytes,
+              inRowsP[j] + (size_t)x * pixbytes, pixbytes);
+          }
+          imagePutPixels(indstP, inHeight - inY - inNrows, y, inNrows, segP);
+        }
+      }
+    }
+  }
+
+  free(segP);
+  return(status);
+}
+
+
+/************/
+/* orient() */
+/************/
+gImage*
+orient(
+ gImage *ingimageP,
+ unsigned int inOrientation,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+
+  if (inOrientation <= 1 || inOrientation > 8) {
+    return(ingimageP);
+  }
+
+  if (inVerbose != 0) {
+    printf(" Orientation %u to upright\n", inOrientation);
+  }
+
+  if (BITMAPP(ingimageP)) {
+    if (inOrientation <= 4) {
+      rgiP = bitMirror(ingimageP, inOrientation);
+    } else {
+      rgiP = bitTranspose(ingimageP, inOrientation);
+    }
+  } else if (RGB24P(ingimageP) || RGB48P(ingimageP) || RGBF32P(ingimageP)) {
+    rgiP = rgbOrient(ingimageP, inOrientation);
+  } else {
+    fprintf(stderr, "rotate error invalid image type\n");
+  }
+
+  /* on failure the image is left as it was */
+  if (rgiP == NULL) {
+    rgiP = ingimageP;
+  } else {
+    copyImageInfo(rgiP, ingimageP);
+  }
+
+  return(rgiP);
+}
+
+
+/****************/
+/* orientLazy() */
+/****************/
+gImage*
+orientLazy(
+ gImage *ingimageP,
+ unsigned int inOrientation,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+struct lazyorient_struct *loP = NULL;
+unsigned int across;
+unsigned int down;
+
+  if (inOrientation <= 1 || inOrientation > 8) {
+    return(ingimageP);
+  }
+  /* images that fit in memory are quicker done at once */
+  if (!TILEDP(ingimageP)) {
+    rgiP = orient(ingimageP, inOrientation, inVerbose);
+    if (rgiP != ingimageP) {
+      freeImage(ingimageP);
+    }
+    return(rgiP);
+  }
+
+  if (inVerbose != 0) {
+    printf(" Orientation %u to upright, as shown\n", inOrientation);
+  }
+
+  loP = malloc(sizeof(struct lazyorient_struct));
+  if (loP != NULL) {
+    loP->srcP = ingimageP;
+    loP->orientation = inOrientation;
+    loP->scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+  }
+  if (loP == NULL || loP->scratchP == NULL) {
+    fprintf(stderr, "rotate error: malloc\n");
+  } else if (inOrientation >= 5) {
+    rgiP = newTiledImage(ingimageP->gitype, ingimageP->height,
+      ingimageP->width, ingimageP->tiledim);
+  } else {
+    rgiP = newTiledImage(ingimageP->gitype, ingimageP->width,
+      ingimageP->height, ingimageP->tiledim);
+  }
+
+  if (rgiP != NULL) {
+    across = (rgiP->width  - 1) / rgiP->tiledim + 1;
+    down   = (rgiP->height - 1) / rgiP->tiledim + 1;
+    rgiP->tilestate = calloc((size_t)across * down, 1);
+    if (rgiP->tilestate == NULL) {
+      fprintf(stderr, "rotate error: malloc\n");
+      freeImage(rgiP);
+      rgiP = NULL;
+    }
+  }
+
+  /* on failure the image is left as it was */
+  if (rgiP == NULL) {
+    if (loP != NULL) {
+      free(loP->scratchP);
+      free(loP);
+    }
+    rgiP = ingimageP;
+  } else {
+    rgiP->tileread  = lazyOrientRead;
+    rgiP->tileclose = lazyOrientClose;
+    rgiP->tilectx   = loP;
+    copyImageInfo(rgiP, ingimageP);
+  }
+
+  return(rgiP);
+}
+
+
+/*******************/
+/* orientCompose() */
+/*******************/
+unsigned int
+orientCompose(
+ unsigned int inFirst,
+ unsigned int inThen)
+{
+const int *fP = NULL;
+const int *tP = NULL;
+int m[4];
+unsigned int o;
+unsigned int ro = 1;
+
+  if (inFirst < 1 || inFirst > 8) {
+    inFirst = 1;
+  }
+  if (inThen < 1 || inThen > 8) {
+    inThen = 1;
+  }
+  fP = orientMatrix[inFirst];
+  tP = orientMatrix[inThen];
+  /* then x first */
+  m[0] = tP[0] * fP[0] + tP[1] * fP[2];
+  m[1] = tP[0] * fP[1] + tP[1] * fP[3];
+  m[2] = tP[2] * fP[0] + tP[3] * fP[2];
+  m[3] = tP[2] * fP[1] + tP[3] * fP[3];
+  for (o = 1; o <= 8; o++) {
+    if (orientMatrix[o][0] == m[0] && orientMatrix[o][1] == m[1] &&
+        orientMatrix[o][2] == m[2] && orientMatrix[o][3] == m[3]) {
+      ro = o;
+      break;
+    }
+  }
+  return(ro);
+}
+
+
+/***********************/
+/* rotateOrientation() */
+/***********************/
+unsigned int
+rotateOrientation(
+ unsigned int inDegrees)
+{
+unsigned int ro = 0;
+
+  switch (inDegrees % 360) {
+   case 0:   ro = 1; break;
+   case 90:  ro = 6; break;
+   case 180: ro = 3; break;
+   case 270: ro = 8; break;
+   default:  ro = 0;
+  }
+  return(ro);
+}
+
+
+/*********************/
+/* flipOrientation() */
+/*********************/
+unsigned int
+flipOrientation(
+ unsigned int inDirection)
+{
+  return(inDirection == FLIP_HORIZONTAL ? 2 : 4);
+}
+
+
 /************/
 /* rotate() */
 /************/
@@ -26,9 +737,40 @@ rotate(
  unsigned int inDegrees,
  unsigned int inVerbose)
 {
-  if (inVerbose != 0) {
-    fprintf(stderr, "rotate() called\n");
+gImage *rgiP = ingimageP;
+
+  inDegrees %= 360;
+  if (inDegrees != 0 && inVerbose != 0) {
+    printf(" Rotate by %u degrees\n", inDegrees);
+  }
+
+  if (rotateOrientation(inDegrees) == 0) {
+    fprintf(stderr, "rotate: %u is not a multiple of 90 degrees\n", inDegrees);
+  } else {
+    rgiP = orient(ingimageP, rotateOrientation(inDegrees), 0);
   }
-  return(ingimageP);
+
+  return(rgiP);
 }
 
+
+/**********/
+/* flip() */
+/**********/
+gImage*
+flip(
+ gImage *ingimageP,
+ unsigned int inDirection,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+
+  if (inVerbose != 0) {
+    printf(" Flip %s\n",
+      (inDirection == FLIP_HORIZONTAL ? "horizontally" : "vertically"));
+  }
+
+  rgiP = orient(ingimageP, flipOrientation(inDirection), 0);
+
+  return(rgiP);
+}
@@ -20,15 +20,124 @@
 
 #include "../gimage.h" /* 'gImage' struct */
 
+/* flip directions */
+#define FLIP_HORIZONTAL (0) /* mirror left to right */
+#define FLIP_VERTICAL   (1) /* mirror top to bottom */
+
+/* orientation is the EXIF / TIFF Orientation tag, 1 to 8 */
+/*  1 upright, 2 mirrored left to right, 3 turned 180, */
+/*  4 mirrored top to bottom, 5 transposed, 6 needs 90 clockwise, */
+/*  7 transverse, 8 needs 270 clockwise */
+/*  5 to 8 swap width and height */
+
+/* source rows per orientPutRows() call that keep 5 to 8 in cache */
+#define ORIENT_ROWS (64)
+
 /** rotate
  * @ingroup rotate
  * @param[in] gimageP gImage to rotate
- * @param[in] degrees 
+ * @param[in] degrees clockwise, a multiple of 90
  * @param[in] verbose flag for verbose output
- * @return new gImage that was rotate'd
+ * @return new gImage that was rotate'd,
+ *  or gimageP itself if degrees is 0 or rotating failed
  * 
  */
 gImage* rotate(gImage *gimageP, unsigned int degrees, unsigned int verbose);
 
+
+/** flip
+ * @ingroup rotate
+ * @param[in] gimageP gImage to flip
+ * @param[in] direction FLIP_HORIZONTAL or FLIP_VERTICAL
+ * @param[in] verbose flag for verbose output
+ * @return new gImage that was flip'd, or gimageP itself if flipping failed
+ * 
+ */
+gImage* flip(gImage *gimageP, unsigned int direction, unsigned int verbose);
+
+
+/** orient
+ * @ingroup rotate
+ * @param[in] gimageP gImage as stored
+ * @param[in] orientation 1 to 8
+ * @param[in] verbose flag for verbose output
+ * @return new upright gImage, or gimageP itself if orientation is 1,
+ *  out of range, or orienting failed
+ * 
+ */
+gImage* orient(gImage *gimageP, unsigned int orientation, unsigned int verbose);
+
+
+/** orientLazy
+ * @ingroup rotate
+ * @param[in] gimageP gImage as stored
+ * @param[in] orientation 1 to 8
+ * @param[in] verbose flag for verbose output
+ * @return new upright gImage, which takes over gimageP,
+ *  or gimageP itself as orient()
+ *
+ * for tiled images each tile is made from gimageP the first time it
+ * is read, so only what is shown is ever computed, and gimageP is
+ * freed with the result.  other images are done now by orient(),
+ * and gimageP is freed at once.
+ */
+gImage* orientLazy(gImage *gimageP, unsigned int orientation, unsigned int verbose);
+
+
+/** orientCompose
+ * @ingroup rotate
+ * @param[in] first orientation applied first, 1 to 8
+ * @param[in] then orientation applied to that result, 1 to 8
+ * @return the one orientation that does both
+ *
+ * orient(orient(g, first), then) is the same as orient(g, result)
+ */
+unsigned int orientCompose(unsigned int first, unsigned int then);
+
+
+/** rotateOrientation
+ * @ingroup rotate
+ * @param[in] degrees clockwise
+ * @return orientation that rotates by degrees, 0 if not a multiple of 90
+ */
+unsigned int rotateOrientation(unsigned int degrees);
+
+
+/** flipOrientation
+ * @ingroup rotate
+ * @param[in] direction FLIP_HORIZONTAL or FLIP_VERTICAL
+ * @return orientation that flips that way
+ */
+unsigned int flipOrientation(unsigned int direction);
+
+
+/** newOrientedImage
+ * @ingroup rotate
+ * @param[in] gitype IRGB24 or IRGB48
+ * @param[in] width stored width
+ * @param[in] height stored height
+ * @param[in] orientation 1 to 8
+ * @return new gImage of the upright size, for orientPutRows(),
+ *  data contents undefined
+ */
+gImage* newOrientedImage(unsigned int gitype, unsigned int width, unsigned int height, unsigned int orientation);
+
+
+/** orientPutRows
+ * @ingroup rotate
+ * @param[in,out] dstP from newOrientedImage()
+ * @param[in] orientation 1 to 8
+ * @param[in] width stored width
+ * @param[in] height stored height
+ * @param[in] y first stored row
+ * @param[in] nrows number of rows, at most ORIENT_ROWS for speed
+ * @param[in] rowsP the stored rows, pixels as in dstP
+ * @return 0 ok, -1 error
+ *
+ * lets a loader write decoded rows straight to their upright place,
+ *  with no separate pass over the whole image
+ */
+int orientPutRows(gImage *dstP, unsigned int orientation, unsigned int width, unsigned int height, unsigned int y, unsigned int nrows, unsigned char **rowsP);
+
 #endif
 
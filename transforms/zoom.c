@@ -11,8 +11,10 @@
 /* C System */
 #include <stdlib.h>    /* malloc */
 #include <stdio.h>     /* fprintf, printf */
+#include <string.h>    /* memcpy */
 #include <math.h>      /* rint, powl */
-#include <stdint.h>
+#include <stdint.h>    /* uint16_t, SIZE_MAX */
+#include <limits.h>    /* UINT_MAX */
 
 /* code base */
 #include "../gimage.h" /* 'gImage' struct */
@@ -26,17 +28,21 @@
 
 /* INTERNAL */
 /* structures */
-struct rgb24_struct {
- unsigned char  red;
- unsigned char  green;
- unsigned char  blue;
+/* source for downscaleRows(), one linearized row at a time */
+struct linsrc_struct {
+ gImage        *gimageP;   /* IRGB24, IRGB48 or IRGBF32 source */
+ unsigned char *scratchP;  /* one row of source, if tiled */
+ float         *rowP;      /* one row, linear float */
+ const float   *cachedP;   /* row cachedy, rowP or an IRGBF32 source row */
+ unsigned int   cachedy;   /* row in cachedP, UINT_MAX if none */
 };
 
-
-struct rgb48_struct {
- unsigned char red[2];
- unsigned char green[2];
- unsigned char blue[2];
+/* tilectx of a zoomLazy() image */
+struct lazyzoom_struct {
+ gImage        *srcP;      /* not owned, must outlive the zoomed image */
+ unsigned int  *xmap;      /* dst x to src x */
+ unsigned int  *ymap;      /* dst y to src y */
+ unsigned char *scratchP;  /* one source row */
 };
 
 
@@ -60,6 +66,59 @@ double lin;
 }
 
 
+/****************/
+/* zoomLength() */
+/****************/
+/* zoomed length of inLength pixels at inPercent */
+/*  inPercent of 0 means unchanged */
+/*  computed in double so (length * percent) cannot overflow */
+/*  returns 0 if the result does not fit in unsigned int */
+static unsigned int
+zoomLength(
+ unsigned int inPercent,
+ unsigned int inLength)
+{
+double dlen;
+unsigned int len;
+
+  if (inPercent == 0) {
+    len = inLength;
+  } else {
+    dlen = ((double)inLength * inPercent) * 0.01;
+    if (dlen > (double)UINT_MAX) {
+      fprintf(stderr, "zoom: zoomed size too large\n");
+      len = 0;
+    } else {
+      len = dlen;
+    }
+  }
+  return(len);
+}
+
+
+/*******************/
+/* floatRGBBytes() */
+/*******************/
+/* bytes for a 3 sample float copy of a width x height image */
+/*  returns 0 on size_t overflow */
+static size_t
+floatRGBBytes(
+ unsigned int inWidth,
+ unsigned int inHeight)
+{
+size_t nbytes = 0;
+size_t npix;
+
+  npix = (size_t)inWidth * inHeight;
+  if (inHeight == 0 || npix / inHeight == inWidth) {
+    if (npix <= SIZE_MAX / (sizeof(float) * 3)) {
+      nbytes = npix * sizeof(float) * 3;
+    }
+  }
+  return(nbytes);
+}
+
+
 /*************/
 /* makemap() */
 /*************/
@@ -76,15 +135,18 @@ unsigned int len;
 unsigned int *mapP = NULL;
 unsigned int i;
 
+  len = zoomLength(inPercent, inLength);
   if (inPercent == 0) {
-    len = inLength;
     ratio = 1.0;
   } else {
-    len = (inLength * inPercent) * 0.01;
     ratio = 100.0 / inPercent;
   }
 
-  mapP = malloc(sizeof(unsigned int) * len);
+  if (len == 0) {
+    mapP = NULL;
+  } else {
+    mapP = malloc(sizeof(unsigned int) * (size_t)len);
+  }
   if (mapP == NULL) {
     fprintf(stderr, "zoom makemap malloc error\n");
     *ioMapLen = 0;
@@ -99,9 +161,132 @@ unsigned int i;
 }
 
 
+/*****************/
+/* intFactorOf() */
+/*****************/
+/* whole number factor k if map is x / k for every x, else 0 */
+/*  checked against the map itself, so a fast path gives the same */
+/*  result as the map */
+static unsigned int
+intFactorOf(
+ unsigned int inPercent,
+ const unsigned int *inMapP,
+ unsigned int inMapLen)
+{
+unsigned int k = 0;
+unsigned int x;
+
+  if (inPercent >= 200 && inPercent % 100 == 0) {
+    k = inPercent / 100;
+    for (x = 0; x < inMapLen; x++) {
+      if (inMapP[x] != x / k) {
+        k = 0;
+        break;
+      }
+    }
+  }
+  return(k);
+}
+
+
+/****************/
+/* bitExpandK() */
+/****************/
+/* table of inK bytes per source byte, each source bit inK times */
+/*  note carefully: malloc's on heap, caller's responsibility to free() */
+static unsigned char*
+bitExpandK(
+ unsigned int inK)
+{
+unsigned char *tableP = NULL;
+unsigned char *entryP = NULL;
+unsigned int b;
+unsigned int bit;
+unsigned int out;
+
+  tableP = calloc(256, inK);
+  if (tableP != NULL) {
+    for (b = 0; b < 256; b++) {
+      entryP = tableP + (size_t)b * inK;
+      for (bit = 0; bit < 8; bit++) {
+        if (b & (0x01 << bit)) {
+          for (out = bit * inK; out < (bit + 1) * inK; out++) {
+            entryP[out / 8] |= 0x01 << (out % 8);
+          }
+        }
+      }
+    }
+  }
+  return(tableP);
+}
+
+
+/*****************/
+/* zoombitgray() */
+/*****************/
+/* reduce a bitmap to an IRGB24 gray image of the fraction of */
+/*  each output pixel's area covered by set (black) bits */
+/*  coverage is linear light, encoded to sRGB like zoomdownRGB(), */
+/*  so later reductions of the result stay consistent */
+static gImage*
+zoombitgray(
+ gImage *ingimageP,
+ unsigned int inXlen,
+ unsigned int inYlen)
+{
+gImage *rgiP = NULL;
+float *coverP = NULL;
+unsigned char *dstP = NULL;
+unsigned char v;
+size_t i;
+size_t npix;
+int status = 0;
+
+  /* one float per pixel is less than floatRGBBytes(), so no overflow */
+  npix = (size_t)inXlen * inYlen;
+  if (floatRGBBytes(inXlen, inYlen) != 0) {
+    coverP = malloc(sizeof(float) * npix);
+  }
+  if (coverP == NULL) {
+    fprintf(stderr, "zoom: malloc error\n");
+  } else {
+    status = bitdownscalecover(ingimageP->data,
+      ingimageP->width, ingimageP->height, coverP, inXlen, inYlen);
+    if (status != 0) {
+      fprintf(stderr, "zoombit bitscaledown error\n");
+    } else {
+      rgiP = newRGB24ImageUninit(inXlen, inYlen);
+    }
+  }
+  if (rgiP != NULL) {
+    dstP = rgiP->data;
+    for (i = 0; i < npix; i++) {
+      /* documents are mostly all white or all black areas */
+      if (coverP[i] == 0.0f) {
+        v = 255;
+      } else if (coverP[i] == 1.0f) {
+        v = 0;
+      } else {
+        v = rint(255.0 * lin2sRGB(1.0 - coverP[i]));
+      }
+      *dstP++ = v;
+      *dstP++ = v;
+      *dstP++ = v;
+    }
+  }
+
+  free(coverP);
+  return(rgiP);
+}
+
+
 /*************/
 /* zoombit() */
 /*************/
+/* reductions are gray (IRGB24) unless the bitmap has its own */
+/*  foreground or background color, then they stay bitmaps */
+/* whole number width factors expand a byte at a time from a table, */
+/*  others a bit at a time; repeated rows are copied */
 static gImage*
 zoombit(
  gImage *ingimageP,
@@ -111,21 +296,26 @@ zoombit(
 gImage *rgiP = NULL;
 unsigned int *xmap = NULL;
 unsigned int *ymap = NULL;
+unsigned char *expandP = NULL;
 unsigned char *srclineP = NULL;
 unsigned char *dstlineP = NULL;
 unsigned char *srcP = NULL;
 unsigned char *dstP = NULL;
-unsigned int srclinelen;
-unsigned int dstlinelen;
+size_t srclinelen;
+size_t dstlinelen;
+size_t n;
+size_t left;
 unsigned int xlen;
 unsigned int ylen;
 unsigned int x;
 unsigned int xsrc;
 unsigned int y;
 unsigned int ysrc;
+unsigned int k = 0;
 unsigned char srcmask;
 unsigned char dstmask;
 unsigned char bit;
+unsigned char lastmask;
 int status = 0;
 
   if (inXzoom == 0 && inYzoom == 0) {
@@ -133,207 +323,325 @@ int status = 0;
 
   } else if (inXzoom < 100 && inYzoom < 100) {
 
-    xlen = (inXzoom == 0 ? ingimageP->width  : (ingimageP->width  * inXzoom) * 0.01);
-    ylen = (inYzoom == 0 ? ingimageP->height : (ingimageP->height * inYzoom) * 0.01);
-    rgiP = newBitImage(xlen, ylen);
+    xlen = zoomLength(inXzoom, ingimageP->width);
+    ylen = zoomLength(inYzoom, ingimageP->height);
+    if (ingimageP->foreground[0] == '\0' && ingimageP->background[0] == '\0') {
+      rgiP = zoombitgray(ingimageP, xlen, ylen);
+    } else {
+      rgiP = newBitImage(xlen, ylen);
+    }
 
-    status = bitdownscale(ingimageP->data, ingimageP->width, ingimageP->height,
-      rgiP->data, xlen, ylen);
-    if (status != 0) {
-      fprintf(stderr, "zoombit bitscaledown error\n");
+    if (rgiP != NULL && BITMAPP(rgiP)) {
+      status = bitdownscale(ingimageP->data, ingimageP->width, ingimageP->height,
+        rgiP->data, xlen, ylen);
+      if (status != 0) {
+        fprintf(stderr, "zoombit bitscaledown error\n");
+      }
     }
 
   } else {
 
     xmap = makemap(inXzoom, ingimageP->width, &xlen);
-    ymap = makemap(inXzoom, ingimageP->height, &ylen);
+    ymap = makemap(inYzoom, ingimageP->height, &ylen);
     rgiP = newBitImage(xlen, ylen);
 
-    srclinelen = (ingimageP->width + 7) / 8;
-    dstlinelen = (xlen + 7) / 8;
-
-    srclineP = ingimageP->data;
-    dstlineP = rgiP->data;
+    if (xmap != NULL && xlen == (size_t)ingimageP->width * (inXzoom / 100)) {
+      k = intFactorOf(inXzoom, xmap, xlen);
+      if (k != 0) {
+        expandP = bitExpandK(k);
+        if (expandP == NULL) {
+          k = 0;
+        }
+      }
+    }
 
-    for (y = 0, ysrc = *(ymap + y); y < ylen; y++) {
-      while (ysrc != *(ymap + y)) {
-        ysrc++;
-        srclineP += srclinelen;
+    if (xmap == NULL || ymap == NULL || rgiP == NULL) {
+      freeImage(rgiP);
+      rgiP = NULL;
+    } else {
+      srclinelen = (ingimageP->width + 7) / 8;
+      dstlinelen = (xlen + 7) / 8;
+      /* padding bits of the last source byte are not expanded */
+      lastmask = 0xff;
+      if (ingimageP->width % 8 != 0) {
+        lastmask = (0x01 << (ingimageP->width % 8)) - 1;
       }
-      srcP = srclineP;
-      dstP = dstlineP;
-      srcmask = 0x01;
-      dstmask = 0x01;
-      bit = srcmask & (*srcP);
-      for (x = 0, xsrc = *(xmap + x); x < xlen; x++) {
-        if (xsrc != *(xmap + x) ) {
-          do {
-            xsrc++;
-            if (srcmask == 0x80) {
-              srcP++;
-              srcmask = 0x01;
-            } else {
-              srcmask <<= 0x01;
-            }
-          } while (xsrc != *(xmap + x));
-          bit = srcmask & *srcP;
-        }
-        if (bit != 0) {
-          *dstP |= dstmask;
+
+      srclineP = ingimageP->data;
+      dstlineP = rgiP->data;
+
+      for (y = 0, ysrc = *(ymap + y); y < ylen; y++) {
+        while (ysrc != *(ymap + y)) {
+          ysrc++;
+          srclineP += srclinelen;
         }
-        if (dstmask == 0x80) {
-          dstP++;
-          dstmask = 0x01;
+
+        if (y > 0 && *(ymap + y) == *(ymap + y - 1)) {
+          /* same source row as the last output row */
+          memcpy(dstlineP, dstlineP - dstlinelen, dstlinelen);
+
+        } else if (k != 0) {
+          for (n = 0; n < srclinelen; n++) {
+            bit = srclineP[n];
+            if (n + 1 == srclinelen) {
+              bit &= lastmask;
+            }
+            /* the last source byte may need fewer than k bytes */
+            left = dstlinelen - n * k;
+            memcpy(dstlineP + n * k, expandP + (size_t)bit * k,
+              left < k ? left : k);
+          }
+
         } else {
-          dstmask <<= 0x01;
+          srcP = srclineP;
+          dstP = dstlineP;
+          srcmask = 0x01;
+          dstmask = 0x01;
+          bit = srcmask & (*srcP);
+          for (x = 0, xsrc = *(xmap + x); x < xlen; x++) {
+            if (xsrc != *(xmap + x) ) {
+              do {
+                xsrc++;
+                if (srcmask == 0x80) {
+                  srcP++;
+                  srcmask = 0x01;
+                } else {
+                  srcmask <<= 0x01;
+                }
+              } while (xsrc != *(xmap + x));
+              bit = srcmask & *srcP;
+            }
+            if (bit != 0) {
+              *dstP |= dstmask;
+            }
+            if (dstmask == 0x80) {
+              dstP++;
+              dstmask = 0x01;
+            } else {
+              dstmask <<= 0x01;
+            }
+          }
         }
+        dstlineP += dstlinelen;
       }
-      dstlineP += dstlinelen;
     }
 
     free(xmap);
     free(ymap);
+    free(expandP);
   }
 
   return(rgiP);
 }
 
 
-/************/
-/* zoom24() */
-/************/
-gImage*
-zoom24(
+/**************/
+/* linRowFn() */
+/**************/
+/* downscaleRowFn for IRGB24, IRGB48 and IRGBF32 sources */
+/*  reads one row (from data or tiles) and linearizes it to float, */
+/*  IRGBF32 rows are already linear and are used as read */
+/*  the last row is cached, downscaleRows() asks for boundary rows twice */
+static const float*
+linRowFn(
+ void *inCtx,
+ unsigned int inY)
+{
+struct linsrc_struct *linP = inCtx;
+unsigned char *byteP = NULL;
+uint16_t *u16P = NULL;
+float *floatP = NULL;
+size_t i;
+size_t len;
+const float *rowP = NULL;
+
+  if (linP->cachedy == inY) {
+    rowP = linP->cachedP;
+  } else {
+    byteP = imageRowP(linP->gimageP, 0, inY, linP->gimageP->width,
+      linP->scratchP);
+    if (byteP != NULL && RGBF32P(linP->gimageP)) {
+      linP->cachedy = inY;
+      linP->cachedP = (const float *)byteP;
+      rowP = linP->cachedP;
+    } else if (byteP != NULL) {
+      floatP = linP->rowP;
+      len = (size_t)linP->gimageP->width * 3;
+      if (RGB24P(linP->gimageP)) {
+        for (i = 0; i < len; i++) {
+          /* gImage is in encoded (gamma) sRGB, so need to linearize */
+          /* sRGB linearization is same for red, green, and blue */
+          /* gImage.data is integer=byte, so can use as index to sRGBlin array */
+          *floatP++ = sRGBlin[*byteP++];
+          /* sRGBlin double -to-> float */
+        }
+      } else {
+        u16P = (uint16_t*) byteP;
+        for (i = 0; i < len; i++) {
+          *floatP++ = sRGB2lin( (*u16P++) / 65535.0 );
+        }
+      }
+      linP->cachedy = inY;
+      linP->cachedP = linP->rowP;
+      rowP = linP->cachedP;
+    }
+  }
+  return(rowP);
+}
+
+
+/*****************/
+/* zoomdownRGB() */
+/*****************/
+/* downscale IRGB24, IRGB48 or IRGBF32, gamma correct */
+/*  source rows are linearized one at a time, so memory use is */
+/*  one source row plus the float result, not a float copy of the source */
+/*  the result is inType: encoded to sRGB, or IRGBF32 left linear */
+static gImage*
+zoomdownRGB(
  gImage *ingimageP,
  unsigned int inXzoom,
- unsigned int inYzoom)
+ unsigned int inYzoom,
+ unsigned int inType)
 {
 gImage *rgiP = NULL;
-unsigned int *xmap = NULL;
-unsigned int *ymap = NULL;
-unsigned char *srclineP = NULL;
-unsigned char *srcP = NULL;
-unsigned char *dstP = NULL;
-unsigned char *byteP = NULL;
-float *inrgbP = NULL;
+struct linsrc_struct linsrc;
 float *downrgbP = NULL;
 float *floatP = NULL;
+unsigned char *dstscratchP = NULL;
+unsigned char *dstP = NULL;
+uint16_t *u16P = NULL;
 int status = 0;
-unsigned int i;
-unsigned int len;
+size_t downbytes = 0;
+size_t i;
+size_t len;
 unsigned int xlen;
 unsigned int ylen;
-unsigned int srclinelen;
-unsigned int x;
 unsigned int y;
-unsigned int xsrc;
-unsigned int ysrc;
 double tempd;
-struct rgb24_struct rgb24;
 
-  if (inXzoom == 0 && inYzoom == 0) {
+  xlen = zoomLength(inXzoom, ingimageP->width);
+  ylen = zoomLength(inYzoom, ingimageP->height);
+
+  linsrc.gimageP = ingimageP;
+  linsrc.cachedy = UINT_MAX;
+  linsrc.cachedP = NULL;
+  linsrc.rowP = NULL;
+  linsrc.scratchP = NULL;
+
+  /* sizes in size_t, 0 on overflow */
+  downbytes = floatRGBBytes(xlen, ylen);
+  if (downbytes != 0) {
+    downrgbP = malloc(downbytes);
+    linsrc.rowP = malloc(floatRGBBytes(ingimageP->width, 1));
+    linsrc.scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+    dstscratchP = malloc(imageRowBytes(inType, xlen));
+  }
+  if (downrgbP == NULL || linsrc.rowP == NULL || linsrc.scratchP == NULL ||
+      dstscratchP == NULL) {
+    fprintf(stderr, "zoom: malloc error\n");
     rgiP = NULL;
+  } else {
 
-  } else if (inXzoom < 100 && inYzoom < 100) {
-    /* downscale */
-
-    xlen = (inXzoom == 0 ? ingimageP->width  : (ingimageP->width  * inXzoom) * 0.01);
-    ylen = (inYzoom == 0 ? ingimageP->height : (ingimageP->height * inYzoom) * 0.01);
-
-    inrgbP = malloc(sizeof(float) * 3 * ingimageP->width * ingimageP->height);
-    downrgbP = malloc(sizeof(float) * 3 * xlen * ylen);
-    if (inrgbP == NULL || downrgbP == NULL) {
-      fprintf(stderr, "zoom24: malloc error\n");
-      if (inrgbP != NULL) free(inrgbP);
-      if (downrgbP != NULL) free(downrgbP);
+    /* downscale, linear, float -to-> float */
+    status = downscaleRows(3, linRowFn, &linsrc,
+      ingimageP->width, ingimageP->height, downrgbP, xlen, ylen);
+    if (status != 0) {
+      fprintf(stderr, "zoom: downscale error\n");
       rgiP = NULL;
-    } else {
-
-      /* convert original to linearized float */
-      byteP = ingimageP->data;
-      floatP = inrgbP;
-      len = ingimageP->width * ingimageP->height * 3;
-      for (i = 0; i < len; i++) {
-        /* gImage is in encoded (gamma) sRGB, so need to linearize */
-        /* sRGB linearization is same for red, green, and blue */
-        /* gImage.data is integer=byte, so can use as index to sRGBlin array */
-        *floatP++ = sRGBlin[*byteP++];
-        /* sRGBlin double -to-> float */
-      }
 
-      /* downscale, in float */
-      status = downscale(3, inrgbP, ingimageP->width, ingimageP->height,
-        downrgbP, xlen, ylen);
-      free(inrgbP);
-      if (status != 0) {
-        fprintf(stderr, "zoom24: downscale error\n");
-        rgiP = NULL;
-
-      } else {
-        /* output: return linear to sRGB encoded (gamma), 8bit per RGB */
-        rgiP = newRGB24Image(xlen, ylen);
-        byteP = rgiP->data;
-        floatP = downrgbP;
-        len = xlen * ylen * 3;
-        for (i = 0; i < len; i++) {
-          tempd = *floatP++; /* downrgbP float -to-> tempd double */
-          *byteP++ = rint(255.0 * lin2sRGB(tempd));
+    } else {
+      /* output: return linear to sRGB encoded (gamma) */
+      rgiP = newLargeImage(inType, xlen, ylen);
+    }
+    if (rgiP != NULL) {
+      floatP = downrgbP;
+      len = (size_t)xlen * 3;
+      for (y = 0; y < ylen; y++) {
+        /* tiled output is built in scratch, then stored */
+        if (TILEDP(rgiP)) {
+          dstP = dstscratchP;
+        } else {
+          dstP = imageRowP(rgiP, 0, y, xlen, dstscratchP);
+        }
+        if (RGBF32P(rgiP)) {
+          memcpy(dstP, floatP, len * sizeof(float));
+          floatP += len;
+        } else if (RGB24P(rgiP)) {
+          for (i = 0; i < len; i++) {
+            tempd = *floatP++; /* downrgbP float -to-> tempd double */
+            dstP[i] = rint(255.0 * lin2sRGB(tempd));
+          }
+        } else {
+          u16P = (uint16_t*) dstP;
+          for (i = 0; i < len; i++) {
+            tempd = *floatP++; /* downrgbP float -to-> tempd double */
+            u16P[i] = rint(65535.0 * lin2sRGB(tempd));
+          }
         }
+        imagePutRow(rgiP, y, dstP);
       }
-      free(downrgbP);
     }
+  }
 
-  } else {
-    /* at least one (x,y) expansion */
-
-    srclinelen = (ingimageP->width * 3);
+  free(downrgbP);
+  free(linsrc.rowP);
+  free(linsrc.scratchP);
+  free(dstscratchP);
 
-    xmap = makemap(inXzoom, ingimageP->width, &xlen);
-    ymap = makemap(inYzoom, ingimageP->height, &ylen);
+  return(rgiP);
+}
 
-    rgiP = newRGB24Image(xlen, ylen);
 
-    srclineP = ingimageP->data; /* initialized, but will be changed */
-    dstP = rgiP->data; /* initialized, but will be changed */
-    for (y = 0, ysrc = *(ymap + y); y < ylen; y++) {
+/****************/
+/* replicateK() */
+/****************/
+/* each inPixBytes pixel of a row written inK times */
+/*  sizes are constants in each case, so the copies compile */
+/*  to plain loads and stores */
+static void
+replicateK(
+ unsigned char *dstP,
+ const unsigned char *srcP,
+ unsigned int inWidth,
+ size_t inPixBytes,
+ unsigned int inK)
+{
+unsigned int x;
+unsigned int j;
 
-      while (ysrc != *(ymap + y)) {
-        ysrc++;
-        srclineP += srclinelen;
+  if (inPixBytes == 3) {
+    for (x = 0; x < inWidth; x++, srcP += 3) {
+      for (j = 0; j < inK; j++, dstP += 3) {
+        memcpy(dstP, srcP, 3);
       }
-
-      srcP = srclineP;
-      rgb24 = *((struct rgb24_struct *) srcP);
-      for (x = 0, xsrc = *(xmap + x); x < xlen; x++) {
-
-        if (xsrc != *(xmap + x)) {
-          do {
-            xsrc++;
-            srcP += 3;
-          } while (xsrc != *(xmap + x));
-          rgb24 = *((struct rgb24_struct *) srcP);
-        }
-        *(dstP)   = rgb24.red;
-        *(dstP+1) = rgb24.green;
-        *(dstP+2) = rgb24.blue;
-        dstP += 3;
+    }
+  } else if (inPixBytes == 6) {
+    for (x = 0; x < inWidth; x++, srcP += 6) {
+      for (j = 0; j < inK; j++, dstP += 6) {
+        memcpy(dstP, srcP, 6);
+      }
+    }
+  } else {
+    for (x = 0; x < inWidth; x++, srcP += 12) {
+      for (j = 0; j < inK; j++, dstP += 12) {
+        memcpy(dstP, srcP, 12);
       }
-
     }
-
-    free(xmap);
-    free(ymap);
   }
-
-  return(rgiP);
 }
 
 
-/************/
-/* zoom48() */
-/************/
-gImage*
-zoom48(
+/***************/
+/* zoomupRGB() */
+/***************/
+/* at least one (x,y) expansion of IRGB24, IRGB48 or IRGBF32 */
+/*  nearest neighbour, works row by row so tiled images are fine */
+/*  2x, 3x and 4x widths replicate pixels directly, others use a */
+/*  byte offset map; a row that repeats the previous source row */
+/*  is copied, not computed again */
+static gImage*
+zoomupRGB(
  gImage *ingimageP,
  unsigned int inXzoom,
  unsigned int inYzoom)
@@ -341,120 +649,238 @@ zoom48(
 gImage *rgiP = NULL;
 unsigned int *xmap = NULL;
 unsigned int *ymap = NULL;
+size_t *xoff = NULL;
+unsigned char *srcscratchP = NULL;
+unsigned char *dstscratchP = NULL;
+unsigned char *srclineP = NULL;
+unsigned char *dstP = NULL;
+unsigned char *prevP = NULL;
+size_t pixbytes;
+size_t dstlinelen;
 unsigned int xlen;
 unsigned int ylen;
-unsigned int i;
-unsigned int len;
-uint16_t *u16P = NULL;
-int status = 0;
-float *inrgbP = NULL;
-float *downrgbP = NULL;
-float *floatP = NULL;
-double tempd;
-unsigned int srclinelen;
-unsigned int ysrc;
-unsigned int xsrc;
-unsigned char *srclineP = NULL;
-unsigned char *srcP = NULL;
-unsigned int y;
 unsigned int x;
-unsigned char *dstP = NULL;
-struct rgb48_struct rgb48;
+unsigned int y;
+unsigned int ysrc;
+unsigned int k;
 
-  if (inXzoom == 0 && inYzoom == 0) {
-    rgiP = NULL;
+  pixbytes = imageRowBytes(ingimageP->gitype, 1);
 
-  } else if (inXzoom < 100 && inYzoom < 100) {
-    /* downscale */
+  xmap = makemap(inXzoom, ingimageP->width, &xlen);
+  ymap = makemap(inYzoom, ingimageP->height, &ylen);
 
-    xlen = (inXzoom == 0 ? ingimageP->width  : (ingimageP->width  * inXzoom) * 0.01);
-    ylen = (inYzoom == 0 ? ingimageP->height : (ingimageP->height * inYzoom) * 0.01);
+  if (xmap != NULL && ymap != NULL) {
+    rgiP = newLargeImage(ingimageP->gitype, xlen, ylen);
+    xoff = malloc(sizeof(size_t) * (size_t)xlen);
+    srcscratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+    dstscratchP = malloc(imageRowBytes(ingimageP->gitype, xlen));
+  }
 
-    inrgbP = malloc(sizeof(float) * 3 * ingimageP->width * ingimageP->height);
-    downrgbP = malloc(sizeof(float) * 3 * xlen * ylen);
-    if (inrgbP == NULL || downrgbP == NULL) {
-      fprintf(stderr, "zoom48: malloc error\n");
-      if (inrgbP != NULL) free(inrgbP);
-      if (downrgbP != NULL) free(downrgbP);
-      rgiP = NULL;
-    } else {
+  if (xmap == NULL || ymap == NULL || rgiP == NULL || xoff == NULL ||
+      srcscratchP == NULL || dstscratchP == NULL) {
+    freeImage(rgiP);
+    rgiP = NULL;
+  } else {
+    dstlinelen = imageRowBytes(rgiP->gitype, xlen);
+    k = 0;
+    if (xlen == (size_t)ingimageP->width * (inXzoom / 100)) {
+      k = intFactorOf(inXzoom, xmap, xlen);
+    }
+    for (x = 0; x < xlen; x++) {
+      xoff[x] = (size_t)xmap[x] * pixbytes;
+    }
+
+    ysrc = UINT_MAX;
+    for (y = 0; y < ylen; y++) {
 
-      /* convert original uint16_t sRGB gamma coded to linearized float */
-      u16P = (uint16_t*) ingimageP->data;
-      floatP = inrgbP;
-      len = ingimageP->width * ingimageP->height * 3;
-      for (i = 0; i < len; i++) {
-        /* gImage is in encoded (gamma) sRGB, so need to linearize */
-        /* sRGB linearization is same for red, green, and blue */
-        *floatP++ = sRGB2lin( (*u16P++) / 65535.0 );
+      /* tiled output is built in scratch, then stored */
+      if (TILEDP(rgiP)) {
+        dstP = dstscratchP;
+      } else {
+        dstP = imageRowP(rgiP, 0, y, xlen, dstscratchP);
       }
 
-      /* downscale, linear, float -to-> float */
-      status = downscale(3, inrgbP, ingimageP->width, ingimageP->height,
-        downrgbP, xlen, ylen);
-      free(inrgbP);
-      if (status != 0) {
-        fprintf(stderr, "zoom48: downscale error\n");
+      if (ysrc == ymap[y]) {
+        /* same source row as the last output row */
+        /*  tiled: scratch still holds it */
+        if (dstP != prevP) {
+          memcpy(dstP, prevP, dstlinelen);
+        }
+        imagePutRow(rgiP, y, dstP);
+        continue;
+      }
+
+      ysrc = ymap[y];
+      srclineP = imageRowP(ingimageP, 0, ysrc, ingimageP->width, srcscratchP);
+      if (srclineP == NULL) {
+        fprintf(stderr, "zoom: source row %u unreadable\n", ysrc);
+        freeImage(rgiP);
         rgiP = NULL;
+        break;
+      }
 
+      if (k != 0) {
+        replicateK(dstP, srclineP, ingimageP->width, pixbytes, k);
+      } else if (pixbytes == 3) {
+        for (x = 0; x < xlen; x++) {
+          memcpy(dstP + (size_t)x * 3, srclineP + xoff[x], 3);
+        }
+      } else if (pixbytes == 6) {
+        for (x = 0; x < xlen; x++) {
+          memcpy(dstP + (size_t)x * 6, srclineP + xoff[x], 6);
+        }
       } else {
-        /* output: return linear to sRGB encoded (gamma), 8bit per RGB */
-        rgiP = newRGB48Image(xlen, ylen);
-        u16P = (uint16_t*) rgiP->data;
-        floatP = downrgbP;
-        len = xlen * ylen * 3;
-        for (i = 0; i < len; i++) {
-          tempd = *floatP++; /* downrgbP float -to-> tempd double */
-          *u16P++ = rint(65535.0 * lin2sRGB(tempd));
+        for (x = 0; x < xlen; x++) {
+          memcpy(dstP + (size_t)x * 12, srclineP + xoff[x], 12);
         }
       }
-      free(downrgbP);
+      imagePutRow(rgiP, y, dstP);
+      prevP = dstP;
     }
+  }
 
-  } else {
-    /* at least one (x,y) expansion */
+  free(xmap);
+  free(ymap);
+  free(xoff);
+  free(srcscratchP);
+  free(dstscratchP);
 
-    srclinelen = (ingimageP->width * 3 * 2);
+  return(rgiP);
+}
 
-    xmap = makemap(inXzoom, ingimageP->width, &xlen);
-    ymap = makemap(inYzoom, ingimageP->height, &ylen);
 
-    rgiP = newRGB48Image(xlen, ylen);
+/******************/
+/* lazyZoomRead() */
+/******************/
+/* gImage tileread callback of zoomLazy(), same pixels as zoomupRGB() */
+static int
+lazyZoomRead(
+ gImage *ingiP,
+ unsigned int inTx,
+ unsigned int inTy,
+ unsigned char *outTileP)
+{
+struct lazyzoom_struct *lzP = ingiP->tilectx;
+int status = 0;
+unsigned char *srclineP = NULL;
+unsigned char *dstP = NULL;
+size_t pixbytes;
+size_t tilerowbytes;
+unsigned int x0, x1, y0, y1;
+unsigned int sx0;
+unsigned int x;
+unsigned int y;
 
-    srclineP = ingimageP->data;
-    dstP = rgiP->data;
+  pixbytes = imageRowBytes(ingiP->gitype, 1);
+  tilerowbytes = imageRowBytes(ingiP->gitype, ingiP->tiledim);
+  x0 = inTx * ingiP->tiledim;
+  y0 = inTy * ingiP->tiledim;
+  x1 = (ingiP->width - x0 > ingiP->tiledim ? x0 + ingiP->tiledim : ingiP->width);
+  y1 = (ingiP->height - y0 > ingiP->tiledim ? y0 + ingiP->tiledim : ingiP->height);
+  sx0 = lzP->xmap[x0];
+
+  for (y = y0; y < y1 && status == 0; y++) {
+    dstP = outTileP + (size_t)(y - y0) * tilerowbytes;
+    if (y > y0 && lzP->ymap[y] == lzP->ymap[y - 1]) {
+      memcpy(dstP, dstP - tilerowbytes, (size_t)(x1 - x0) * pixbytes);
+      continue;
+    }
+    srclineP = imageRowP(lzP->srcP, sx0, lzP->ymap[y],
+      lzP->xmap[x1 - 1] - sx0 + 1, lzP->scratchP);
+    if (srclineP == NULL) {
+      status = -1;
+    } else {
+      for (x = x0; x < x1; x++) {
+        memcpy(dstP, srclineP + (size_t)(lzP->xmap[x] - sx0) * pixbytes,
+          pixbytes);
+        dstP += pixbytes;
+      }
+    }
+  }
+  return(status);
+}
 
-    for (y = 0, ysrc = *(ymap + y); y < ylen; y++) {
 
-      while (ysrc != *(ymap + y)) {
-        ysrc++;
-        srclineP += srclinelen;
-      }
+/*******************/
+/* lazyZoomClose() */
+/*******************/
+/* gImage tileclose callback of zoomLazy() */
+static void
+lazyZoomClose(
+ void *inCtxP)
+{
+struct lazyzoom_struct *lzP = inCtxP;
 
-      srcP = srclineP;
-      rgb48 = *((struct rgb48_struct *) srcP);
-      for (x = 0, xsrc = *(xmap + x); x < xlen; x++) {
+  free(lzP->xmap);
+  free(lzP->ymap);
+  free(lzP->scratchP);
+  free(lzP);
+}
 
-        if (xsrc != *(xmap + x)) {
-          do {
-            xsrc++;
-            srcP += 6;
-          } while (xsrc != *(xmap + x));
 
-          rgb48 = *((struct rgb48_struct *) srcP);
-        }
-        *(dstP)     = rgb48.red[0];
-        *(dstP + 1) = rgb48.red[1];
-        *(dstP + 2) = rgb48.green[0];
-        *(dstP + 3) = rgb48.green[1];
-        *(dstP + 4) = rgb48.blue[0];
-        *(dstP + 5) = rgb48.blue[1];
-        dstP += 6;
-      }
-    } 
+/************/
+/* zoom24() */
+/************/
+gImage*
+zoom24(
+ gImage *ingimageP,
+ unsigned int inXzoom,
+ unsigned int inYzoom)
+{
+gImage *rgiP = NULL;
 
-    free(xmap);
-    free(ymap);
+  if (inXzoom == 0 && inYzoom == 0) {
+    rgiP = NULL;
+  } else if (inXzoom < 100 && inYzoom < 100) {
+    rgiP = zoomdownRGB(ingimageP, inXzoom, inYzoom, IRGB24);
+  } else {
+    rgiP = zoomupRGB(ingimageP, inXzoom, inYzoom);
+  }
+
+  return(rgiP);
+}
+
+
+/************/
+/* zoom48() */
+/************/
+gImage*
+zoom48(
+ gImage *ingimageP,
+ unsigned int inXzoom,
+ unsigned int inYzoom)
+{
+gImage *rgiP = NULL;
+
+  if (inXzoom == 0 && inYzoom == 0) {
+    rgiP = NULL;
+  } else if (inXzoom < 100 && inYzoom < 100) {
+    rgiP = zoomdownRGB(ingimageP, inXzoom, inYzoom, IRGB48);
+  } else {
+    rgiP = zoomupRGB(ingimageP, inXzoom, inYzoom);
+  }
+
+  return(rgiP);
+}
+
+
+/*************/
+/* zoomF32() */
+/*************/
+gImage*
+zoomF32(
+ gImage *ingimageP,
+ unsigned int inXzoom,
+ unsigned int inYzoom)
+{
+gImage *rgiP = NULL;
+
+  if (inXzoom == 0 && inYzoom == 0) {
+    rgiP = NULL;
+  } else if (inXzoom < 100 && inYzoom < 100) {
+    rgiP = zoomdownRGB(ingimageP, inXzoom, inYzoom, IRGBF32);
+  } else {
+    rgiP = zoomupRGB(ingimageP, inXzoom, inYzoom);
   }
 
   return(rgiP);
@@ -501,6 +927,9 @@ gImage *rgiP = NULL;
    case IRGB48:
     rgiP = zoom48(ingimageP, inXzoom, inYzoom);
     break;
+   case IRGBF32:
+    rgiP = zoomF32(ingimageP, inXzoom, inYzoom);
+    break;
    default:
     fprintf(stderr, "zoom error invalid image type\n");
   }
@@ -508,3 +937,101 @@ gImage *rgiP = NULL;
   return(rgiP);
 }
 
+
+/**************/
+/* zoomLazy() */
+/**************/
+gImage*
+zoomLazy(
+ gImage *ingimageP,
+ unsigned int inXzoom,
+ unsigned int inYzoom,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+struct lazyzoom_struct *lzP = NULL;
+unsigned int xlen = 0;
+unsigned int ylen = 0;
+unsigned int across;
+unsigned int down;
+
+  /* reductions need whole areas of the source, done now */
+  if ((!RGB24P(ingimageP) && !RGB48P(ingimageP) && !RGBF32P(ingimageP)) ||
+      (inXzoom == 0 && inYzoom == 0) ||
+      (inXzoom < 100 && inYzoom < 100) ||
+      (!TILEDP(ingimageP) &&
+       imageWantsTiles(ingimageP->gitype,
+         zoomLength(inXzoom, ingimageP->width),
+         zoomLength(inYzoom, ingimageP->height)) == 0)) {
+    return(zoom(ingimageP, inXzoom, inYzoom, inVerbose));
+  }
+
+  if (inVerbose != 0) {
+    printf(" Zoom X by %d%% and Y by %d%%, as shown\n", inXzoom, inYzoom);
+  }
+
+  lzP = calloc(1, sizeof(struct lazyzoom_struct));
+  if (lzP != NULL) {
+    lzP->srcP = ingimageP;
+    lzP->xmap = makemap(inXzoom, ingimageP->width, &xlen);
+    lzP->ymap = makemap(inYzoom, ingimageP->height, &ylen);
+    lzP->scratchP = malloc(imageRowBytes(ingimageP->gitype, ingimageP->width));
+  }
+  if (lzP == NULL || lzP->xmap == NULL || lzP->ymap == NULL ||
+      lzP->scratchP == NULL) {
+    fprintf(stderr, "zoom error: malloc\n");
+  } else {
+    rgiP = newTiledImage(ingimageP->gitype, xlen, ylen, 0);
+  }
+
+  if (rgiP != NULL) {
+    across = (xlen - 1) / rgiP->tiledim + 1;
+    down   = (ylen - 1) / rgiP->tiledim + 1;
+    rgiP->tilestate = calloc((size_t)across * down, 1);
+    if (rgiP->tilestate == NULL) {
+      fprintf(stderr, "zoom error: malloc\n");
+      freeImage(rgiP);
+      rgiP = NULL;
+    }
+  }
+
+  if (rgiP == NULL) {
+    if (lzP != NULL) {
+      lazyZoomClose(lzP);
+    }
+  } else {
+    rgiP->tileread  = lazyZoomRead;
+    rgiP->tileclose = lazyZoomClose;
+    rgiP->tilectx   = lzP;
+    rgiP->gamma = ingimageP->gamma;
+    memcpy(rgiP->title, ingimageP->title, sizeof(rgiP->title));
+  }
+
+  return(rgiP);
+}
+
+
+/****************/
+/* zoomLinear() */
+/****************/
+gImage*
+zoomLinear(
+ gImage *ingimageP,
+ unsigned int inXzoom,
+ unsigned int inYzoom,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+
+  if ((RGB24P(ingimageP) || RGB48P(ingimageP)) &&
+      inXzoom != 0 && inXzoom < 100 && inYzoom != 0 && inYzoom < 100) {
+    if (inVerbose != 0) {
+      printf(" Zoom X by %d%% and Y by %d%%, linear\n", inXzoom, inYzoom);
+    }
+    rgiP = zoomdownRGB(ingimageP, inXzoom, inYzoom, IRGBF32);
+  } else {
+    rgiP = zoom(ingimageP, inXzoom, inYzoom, inVerbose);
+  }
+
+  return(rgiP);
+}
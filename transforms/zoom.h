@@ -31,5 +31,35 @@
  */
 gImage* zoom(gImage *ingimageP, unsigned int xzoom, unsigned int yzoom, unsigned int verbose);
 
+
+/** zoomLazy
+ * @ingroup zoom
+ * @param[in] ingimageP gImage to zoom, must outlive the result
+ * @param[in] xzoom  percentage
+ * @param[in] yzoom  percentage
+ * @param[in] verbose flag for verbose output
+ * @return new gImage, as zoom()
+ *
+ * enlargements that need tiles are not computed now: each tile is
+ * made from ingimageP the first time it is read, so only what is
+ * shown is ever computed.  other zooms are done now by zoom().
+ */
+gImage* zoomLazy(gImage *ingimageP, unsigned int xzoom, unsigned int yzoom, unsigned int verbose);
+
+
+/** zoomLinear
+ * @ingroup zoom
+ * @param[in] ingimageP gImage to zoom
+ * @param[in] xzoom  percentage
+ * @param[in] yzoom  percentage
+ * @param[in] verbose flag for verbose output
+ * @return new gImage, as zoom()
+ *
+ * reductions of IRGB24 and IRGB48 are returned as IRGBF32, linear
+ * and not rounded, for the next step of a chain of transforms.
+ * other zooms are done by zoom(), which keeps the type.
+ */
+gImage* zoomLinear(gImage *ingimageP, unsigned int xzoom, unsigned int yzoom, unsigned int verbose);
+
 #endif
 
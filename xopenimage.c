@@ -8,13 +8,21 @@
 /* xopenimage project under the "ISC license" */
 /*  see LICENSE.txt */ 
 
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
 /* C standard library */
 #include <stdlib.h>
 #include <stdio.h>       /* printf, fprintf */
-#include <string.h>      /* strcmp() */
+#include <string.h>      /* strcmp(), strrchr(), memcpy(), memset() */
+#include <stdint.h>      /* uint16_t */
+#include <errno.h>       /* errno, EEXIST */
 #include <signal.h>      /* signal() */
+#include <limits.h>      /* UINT_MAX */
+#include <math.h>        /* rint */
 /* POSIX Issue 1 */
-#include <unistd.h>      /* fork() */
+#include <unistd.h>      /* fork(), sysconf() */
+#include <sys/stat.h>    /* mkdir() */
+#include <pthread.h>
 /* POSIX Issue 4 */
 #include <strings.h>     /* bcopy() */
 
@@ -24,12 +32,14 @@
 #include "fileformats.h" /* loadImage */
 #include "error.h"       /* internalError */
 #include "usageHelp.h"   /* usageHelp */
+#include "thumbcache.h"  /* setCacheLimit */
+#include "profile.h"     /* profileOpen, traceOpen, profileBegin, profileEnd */
 
 /* transforms */
 #include "transforms/zoom.h"
-/* not yet working */
-#include "transforms/gamma.h"
+#include "transforms/pyramid.h"
 #include "transforms/rotate.h"
+#include "transforms/gamma.h"   /* gammacorrect */
 
 
 /* interface to display */
@@ -42,17 +52,88 @@
 char *ProgramName = "xopenimage";
 
 
+/* full size sources with more data than */
+/*  imageMemoryLimit() / SOURCE_SHARE are freed while zoomed out */
+#define SOURCE_SHARE (4)
+
+
+/* everything needed to load and process an image again */
+struct reload_struct {
+ OptionSet    *global_options;
+ OptionSet    *optset;
+ char         *name;
+ unsigned int  verbose;
+};
+
+
+/* what the options do to an image, gathered from the option lists */
+/*  so every pixel stage runs once, however many options feed it */
+struct plan_struct {
+ unsigned int orientation; /* flips and rotations, one orient() pass */
+ float        gamma;       /* applied while drawing, see gdsetgamma() */
+ double       zoomx;       /* percent, views are made from full size */
+ double       zoomy;       /*  by viewImage() */
+};
+
+
+/* contact sheet, see contactSheet() */
+#define CONTACT_GAP  (8)    /* pixels between thumbnails */
+#define CONTACT_GRAY (0x30) /* sheet background */
+
+/* thumbnails decoded by workers, put on the sheet by the main thread */
+struct contact_struct {
+ OptionSet      *global_options;
+ OptionSet     **sets;      /* the named images, in order */
+ gImage        **thumbs;    /* decoded, not yet on the sheet */
+ unsigned char  *state;     /* CONTACT_WAITING, _DECODED, _SHOWN */
+ unsigned int    n;         /* number of images */
+ unsigned int    next;      /* next image to decode */
+ unsigned int    nshown;    /* on the sheet, or failed */
+ pthread_mutex_t lock;      /* protects next, thumbs and state */
+ gImage         *sheetP;
+ unsigned int    cell;      /* -contact, largest thumbnail side */
+ unsigned int    cols;
+ unsigned int    verbose;
+};
+#define CONTACT_WAITING (0)
+#define CONTACT_DECODED (1)
+#define CONTACT_SHOWN   (2)
+
+
+/* images written without a display, see batchConvert() */
+struct batch_struct {
+ OptionSet      *global_options;
+ OptionSet      *next;      /* next image to take, protected by lock */
+ pthread_mutex_t lock;
+ const char     *dir;       /* -output */
+ const char     *format;    /* -outformat */
+ unsigned int    verbose;
+ int             failed;    /* -1 (true) if any image was not written */
+};
+
+/* an image and the file it is written to, see batchDuplicates() */
+struct batch_out {
+ char           *path;
+ const char     *name;
+ unsigned int    index;     /* order on the command line */
+};
+
+
+static gImage* processImage(gImage *ingiP, OptionSet *global_options,
+ OptionSet *image_options);
+
+
 /* Internal (static) functions */
 
 /**********************/
 /* doProcessOnImage() */
 /**********************/
-/* this may modify ingiP */
+/* options that only change gImage information */
+/*  options that change pixels are in the plan, see makePlan() */
 static gImage*
 doProcessOnImage(
  gImage* ingiP,
- Option* inOption,
- unsigned int inVerbose)
+ Option* inOption)
 {
 gImage* rgiP = ingiP;
 
@@ -74,39 +155,236 @@ gImage* rgiP = ingiP;
     }
     break;
 
-   case GAMMA:
-    gammacorrect(rgiP, inOption->info.gamma, inVerbose);
+   case TITLE:
+    /* overwrite */
+    strncpy(rgiP->title, inOption->info.title, 255);
+    rgiP->title[255] = '\0';
+    break;
+
+   default:
+    break;
+  }
+
+  return(rgiP);
+}
+
+
+/****************/
+/* planOption() */
+/****************/
+/* add one option to the plan, if it changes pixels */
+static void
+planOption(
+ struct plan_struct *ioPlanP,
+ Option *inOption)
+{
+unsigned int o;
+
+  switch (inOption->type) {
+
+   case FLIP:
+    ioPlanP->orientation = orientCompose(ioPlanP->orientation,
+      flipOrientation(inOption->info.flip));
     break;
 
    case ROTATE:
-    rgiP = rotate(ingiP, inOption->info.rotate, inVerbose);
+    o = rotateOrientation(inOption->info.rotate);
+    if (o == 0) {
+      fprintf(stderr, "rotate: %u is not a multiple of 90 degrees\n",
+        inOption->info.rotate);
+    } else {
+      ioPlanP->orientation = orientCompose(ioPlanP->orientation, o);
+    }
     break;
 
-   case TITLE:
-    /* overwrite */
-    strncpy(rgiP->title, inOption->info.title, 255);
-    rgiP->title[255] = '\0';
+   case GAMMA:
+    if (inOption->info.gamma > 0.0) {
+      ioPlanP->gamma *= inOption->info.gamma;
+    }
     break;
 
    case ZOOM:
-    rgiP = zoom(ingiP, inOption->info.zoom.x,
-                inOption->info.zoom.y, inVerbose);
-    /* this function is called by processImage() */
-    /*  if rgiP is not same as ingiP, processImage() frees old one */ 
+    /* 0 means that axis is unchanged */
+    if (inOption->info.zoom.x != 0) {
+      ioPlanP->zoomx *= inOption->info.zoom.x / 100.0;
+    }
+    if (inOption->info.zoom.y != 0) {
+      ioPlanP->zoomy *= inOption->info.zoom.y / 100.0;
+    }
     break;
 
    default:
     break;
   }
+}
+
 
+/**************/
+/* makePlan() */
+/**************/
+/* gather the options that change pixels */
+/*  same precedence as processImage(): a global option is ignored */
+/*  if the image has a local one of the same type */
+static void
+makePlan(
+ OptionSet *global_options,
+ OptionSet *image_options,
+ struct plan_struct *outPlanP)
+{
+Option *opt = NULL;
+
+  outPlanP->orientation = 1;
+  outPlanP->gamma = 1.0;
+  outPlanP->zoomx = 100.0;
+  outPlanP->zoomy = 100.0;
+
+  for (opt = global_options->options; opt != NULL; opt = opt->next) {
+    if (getOption(image_options, opt->type) == NULL) {
+      planOption(outPlanP, opt);
+    }
+  }
+  for (opt = image_options->options; opt != NULL; opt = opt->next) {
+    planOption(outPlanP, opt);
+  }
+}
+
+
+/***************/
+/* viewImage() */
+/***************/
+/* image to display, inXzoom x inYzoom percent of the full size source */
+/*  always made from the source or an exact reduction of it: */
+/*  reductions from the nearest pyramid level at least as large, */
+/*  enlargements from the source */
+/*  sets *outOwnedP to -1 (true) if the caller must free the result, */
+/*  0 if it belongs to the pyramid */
+/*  returns NULL if that size is not possible */
+static gImage*
+viewImage(
+ pyramid inPyrP,
+ double inXzoom,
+ double inYzoom,
+ int *outOwnedP,
+ unsigned int inVerbose)
+{
+gImage *rgiP = NULL;
+gImage *levelP = NULL;
+unsigned int k = 0;
+unsigned int nlevels;
+double xz;
+double yz;
+double scale = 1.0;
+ProfileSpan span;
+
+  *outOwnedP = 0;
+  nlevels = pyrLevels(inPyrP);
+
+  /* smaller on both axes: start from a reduction */
+  while (inXzoom * scale * 2.0 <= 100.0 + 1e-9 &&
+         inYzoom * scale * 2.0 <= 100.0 + 1e-9 && k + 1 < nlevels) {
+    k++;
+    scale *= 2.0;
+  }
+
+  xz = rint(inXzoom * scale);
+  yz = rint(inYzoom * scale);
+  if (xz < 1.0 || yz < 1.0 || xz > UINT_MAX || yz > UINT_MAX) {
+    fprintf(stderr, "zoom %.1f%% x %.1f%% not possible\n", inXzoom, inYzoom);
+  } else {
+    profileBegin(&span);
+    levelP = pyrLevel(inPyrP, k);
+    if (levelP != NULL && xz == 100.0 && yz == 100.0) {
+      rgiP = levelP;
+    } else if (levelP != NULL) {
+      /* enlargements of large images compute only the tiles shown */
+      rgiP = zoomLazy(levelP, xz, yz, inVerbose);
+      if (rgiP == levelP) {
+        rgiP = NULL;
+      }
+      if (rgiP != NULL) {
+        *outOwnedP = -1;
+      }
+    }
+    profileEnd(&span, "view", (rgiP != NULL ? rgiP->title : NULL));
+  }
   return(rgiP);
 }
 
 
+/******************/
+/* reloadSource() */
+/******************/
+/* pyramid reload function, see struct reload_struct */
+static gImage*
+reloadSource(
+ void *inCtxP)
+{
+struct reload_struct *reloadP = inCtxP;
+gImage *rgiP = NULL;
+
+  if (reloadP->verbose) {
+    printf("reloading %s\n", reloadP->name);
+  }
+  rgiP = loadImage(reloadP->global_options, reloadP->optset,
+    reloadP->name, reloadP->verbose);
+  if (rgiP != NULL) {
+    rgiP = processImage(rgiP, reloadP->global_options, reloadP->optset);
+  }
+  return(rgiP);
+}
+
+
+/*****************/
+/* evictSource() */
+/*****************/
+/* free a large full size source while a smaller view is shown */
+/*  it is loaded again when needed */
+static void
+evictSource(
+ pyramid inPyrP,
+ gImage *indispP,
+ unsigned int inVerbose)
+{
+size_t nbytes;
+
+  /* a view with tiles still to compute may read the source, */
+  /*  see zoomLazy(); an evicted source stays evicted */
+  if (indispP->tilestate == NULL) {
+    nbytes = pyrEvict(inPyrP, indispP, imageMemoryLimit() / SOURCE_SHARE);
+    if (nbytes > 0 && inVerbose) {
+      printf("full size image freed, %zu bytes\n", nbytes);
+    }
+  }
+}
+
+
+/*******************/
+/* releaseImage() */
+/*******************/
+/* free the displayed image and its pyramid */
+static void
+releaseImage(
+ pyramid *ioPyrP,
+ gImage **ioDispP,
+ int *ioOwnedP)
+{
+  if (*ioOwnedP) {
+    freeImage(*ioDispP);
+  }
+  pyrFree(*ioPyrP);
+  *ioPyrP = NULL;
+  *ioDispP = NULL;
+  *ioOwnedP = 0;
+}
+
+
 /******************/
 /* processImage() */
 /******************/
 /* process a list of options on an image */
+/*  flips and rotations are one orient() pass, see makePlan() */
+/*  zoom is kept separately so views come from full size, */
+/*  and gamma is done while drawing, see gdsetgamma() */
 static gImage*
 processImage(
  gImage *ingiP,
@@ -117,6 +395,9 @@ Option*       opt = NULL;
 gImage*       rgiP = NULL;
 gImage*       tmpgimageP = NULL;
 unsigned int  verbose;
+struct plan_struct plan;
+const char   *name = NULL;
+ProfileSpan   span;
 
   rgiP = ingiP;
 
@@ -129,7 +410,7 @@ unsigned int  verbose;
     if (getOption(image_options, opt->type)) {
       continue;
     }  
-    tmpgimageP = doProcessOnImage(rgiP, opt, verbose);
+    tmpgimageP = doProcessOnImage(rgiP, opt);
     if (tmpgimageP != rgiP) {
       freeImage(rgiP);
       rgiP = tmpgimageP;
@@ -138,18 +419,658 @@ unsigned int  verbose;
 
   /* go through local options */
   for (opt = image_options->options; opt != NULL; opt = opt->next) {
-    tmpgimageP = doProcessOnImage(rgiP, opt, verbose);
+    tmpgimageP = doProcessOnImage(rgiP, opt);
     if (tmpgimageP != rgiP) {
       freeImage(rgiP);
       rgiP = tmpgimageP;
     }
   }
 
+  /* pixel stages */
+  makePlan(global_options, image_options, &plan);
+  opt = getOption(image_options, NAME);
+  name = (opt != NULL ? opt->info.name : NULL);
+  profileBegin(&span);
+  /* a tiled image is oriented a tile at a time, as it is shown */
+  rgiP = orientLazy(rgiP, plan.orientation, verbose);
+  profileEnd(&span, "orient", name);
+
   return(rgiP);
 }
 
 
 
+/*****************/
+/* workerCount() */
+/*****************/
+/* threads for inNimages images: one per processor, no more than */
+/*  there are images */
+static unsigned int
+workerCount(
+ unsigned int inNimages)
+{
+long ncpu;
+unsigned int njobs;
+
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  njobs = (ncpu > 0 ? (unsigned int)ncpu : 1);
+  if (njobs > inNimages) {
+    njobs = inNimages;
+  }
+  return(njobs);
+}
+
+
+/***************/
+/* batchPath() */
+/***************/
+/* output file for an image: the directory, the file name without */
+/*  its extension, and the extension of the output format */
+/*  returns malloc'd path, NULL if out of memory */
+static char*
+batchPath(
+ const char *inDir,
+ const char *inName,
+ const char *inFormat)
+{
+char *rpathP = NULL;
+const char *baseP = NULL;
+const char *dotP = NULL;
+const char *extP = NULL;
+size_t baselen;
+size_t len;
+
+  baseP = strrchr(inName, '/');
+  baseP = (baseP != NULL ? baseP + 1 : inName);
+  dotP = strrchr(baseP, '.');
+  baselen = (dotP != NULL && dotP != baseP ? (size_t)(dotP - baseP)
+                                           : strlen(baseP));
+  extP = outputExtension(inFormat);
+
+  len = strlen(inDir) + 1 + baselen + 1 + strlen(extP) + 1;
+  rpathP = malloc(len);
+  if (rpathP != NULL) {
+    snprintf(rpathP, len, "%s/%.*s.%s", inDir, (int)baselen, baseP, extP);
+  }
+  return(rpathP);
+}
+
+
+/*********************/
+/* batchOutCompare() */
+/*********************/
+/* qsort, by output path, then in command line order */
+static int
+batchOutCompare(
+ const void *inAP,
+ const void *inBP)
+{
+const struct batch_out *aP = inAP;
+const struct batch_out *bP = inBP;
+int ret;
+
+  ret = strcmp(aP->path, bP->path);
+  if (ret == 0) {
+    ret = (aP->index < bP->index ? -1 : aP->index > bP->index);
+  }
+  return(ret);
+}
+
+
+/*********************/
+/* batchDuplicates() */
+/*********************/
+/* images that would be written to the same file, such as a/x.jpg */
+/*  and b/x.png, are reported before any is converted, since the */
+/*  workers would overwrite each other's output */
+/*  returns 0, or -1 if there are any or out of memory */
+static int
+batchDuplicates(
+ struct batch_struct *inBatchP,
+ OptionSet *image_options,
+ unsigned int nimages)
+{
+struct batch_out *outsP = NULL;
+OptionSet *optset = NULL;
+Option *opt = NULL;
+unsigned int n = 0;
+unsigned int first;
+unsigned int i;
+int status = 0;
+
+  if (nimages > 1) {
+    outsP = malloc(nimages * sizeof(struct batch_out));
+  }
+  if (nimages > 1 && outsP == NULL) {
+    fprintf(stderr, "batch: malloc error\n");
+    status = (-1);
+  }
+  for (optset = image_options; outsP != NULL && optset != NULL;
+       optset = optset->next) {
+    opt = getOption(optset, NAME);
+    if (opt != NULL && n < nimages) {
+      outsP[n].name = opt->info.name;
+      outsP[n].index = n;
+      outsP[n].path = batchPath(inBatchP->dir, opt->info.name,
+        inBatchP->format);
+      if (outsP[n].path == NULL) {
+        fprintf(stderr, "%s: malloc error\n", opt->info.name);
+        status = (-1);
+        break;
+      }
+      n++;
+    }
+  }
+
+  if (status == 0 && outsP != NULL) {
+    qsort(outsP, n, sizeof(struct batch_out), batchOutCompare);
+    /* each one is reported against the first to use the path */
+    first = 0;
+    for (i = 1; i < n; i++) {
+      if (strcmp(outsP[first].path, outsP[i].path) != 0) {
+        first = i;
+      } else {
+        fprintf(stderr, "%s and %s would both be written to %s\n",
+          outsP[first].name, outsP[i].name, outsP[i].path);
+        status = (-1);
+      }
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    free(outsP[i].path);
+  }
+  free(outsP);
+  return(status);
+}
+
+
+/**************/
+/* batchOne() */
+/**************/
+/* load, process and write one image */
+/*  the plan is applied to pixels, there is no display to do it */
+/*  returns 0, or -1 if the image was not written */
+static int
+batchOne(
+ struct batch_struct *inBatchP,
+ OptionSet *optset)
+{
+gImage *gimageP = NULL;
+gImage *tmpgimageP = NULL;
+Option *opt = NULL;
+char *pathP = NULL;
+struct plan_struct plan;
+double xz;
+double yz;
+int status = (-1);
+ProfileSpan span;
+
+  opt = getOption(optset, NAME);
+  gimageP = loadImage(inBatchP->global_options, optset, opt->info.name,
+    inBatchP->verbose);
+
+  if (gimageP != NULL) {
+    gimageP = processImage(gimageP, inBatchP->global_options, optset);
+
+    makePlan(inBatchP->global_options, optset, &plan);
+    xz = rint(plan.zoomx);
+    yz = rint(plan.zoomy);
+    if (xz < 1.0 || yz < 1.0 || xz > UINT_MAX || yz > UINT_MAX) {
+      fprintf(stderr, "%s: zoom %.1f%% x %.1f%% not possible\n",
+        opt->info.name, plan.zoomx, plan.zoomy);
+    } else {
+      status = 0;
+      if (xz != 100.0 || yz != 100.0) {
+        profileBegin(&span);
+        tmpgimageP = zoom(gimageP, xz, yz, inBatchP->verbose);
+        profileEnd(&span, "zoom", opt->info.name);
+        if (tmpgimageP == NULL) {
+          status = (-1);
+        } else if (tmpgimageP != gimageP) {
+          freeImage(gimageP);
+          gimageP = tmpgimageP;
+        }
+      }
+    }
+
+    if (status == 0) {
+      profileBegin(&span);
+      gammacorrect(gimageP, plan.gamma, inBatchP->verbose);
+      profileEnd(&span, "gamma", opt->info.name);
+      pathP = batchPath(inBatchP->dir, opt->info.name, inBatchP->format);
+      if (pathP == NULL) {
+        fprintf(stderr, "%s: malloc error\n", opt->info.name);
+        status = (-1);
+      } else {
+        status = saveImage(gimageP, pathP, inBatchP->format,
+          inBatchP->verbose);
+      }
+      free(pathP);
+    }
+    freeImage(gimageP);
+  }
+
+  return(status);
+}
+
+
+/*****************/
+/* batchWorker() */
+/*****************/
+/* thread: convert images until none are left */
+static void*
+batchWorker(
+ void *inArgP)
+{
+struct batch_struct *batchP = inArgP;
+OptionSet *optset = NULL;
+
+  profileThreadName("batch worker");
+  for (;;) {
+    pthread_mutex_lock(&batchP->lock);
+    optset = batchP->next;
+    while (optset != NULL && getOption(optset, NAME) == NULL) {
+      optset = optset->next;
+    }
+    batchP->next = (optset != NULL ? optset->next : NULL);
+    pthread_mutex_unlock(&batchP->lock);
+
+    if (optset == NULL) {
+      break;
+    }
+    if (batchOne(batchP, optset) != 0) {
+      pthread_mutex_lock(&batchP->lock);
+      batchP->failed = -1;
+      pthread_mutex_unlock(&batchP->lock);
+    }
+  }
+  return(NULL);
+}
+
+
+/******************/
+/* batchConvert() */
+/******************/
+/* -output: write every image to a directory instead of displaying */
+/*  one worker per processor, no more than there are images */
+/*  the memory limit is shared among the workers, so larger images */
+/*  go to tiles in temporary files, see newLargeImage() */
+/*  returns EXIT_SUCCESS, or EXIT_FAILURE if any image failed */
+static int
+batchConvert(
+ OptionSet *global_options,
+ OptionSet *image_options,
+ unsigned int verbose)
+{
+struct batch_struct batch;
+OptionSet *optset = NULL;
+Option *opt = NULL;
+pthread_t *threadsP = NULL;
+unsigned int nimages = 0;
+unsigned int njobs;
+unsigned int nstarted = 0;
+unsigned int i;
+
+  batch.global_options = global_options;
+  batch.next = image_options;
+  batch.dir = getOption(global_options, OUTPUT)->info.output;
+  opt = getOption(global_options, OUTFORMAT);
+  batch.format = (opt != NULL ? opt->info.outformat : "ppm");
+  batch.verbose = verbose;
+  batch.failed = 0;
+  pthread_mutex_init(&batch.lock, NULL);
+
+  for (optset = image_options; optset != NULL; optset = optset->next) {
+    if (getOption(optset, NAME) != NULL) {
+      nimages++;
+    }
+  }
+
+  if (batchDuplicates(&batch, image_options, nimages) != 0) {
+    batch.failed = -1;
+  } else if (mkdir(batch.dir, 0777) != 0 && errno != EEXIST) {
+    perror(batch.dir);
+    batch.failed = -1;
+  }
+
+  njobs = workerCount(nimages);
+
+  if (batch.failed == 0 && njobs > 0) {
+    setImageMemoryLimit(imageMemoryLimit() / njobs);
+    if (verbose) {
+      printf("converting %u images, %u at a time, to %s\n",
+        nimages, njobs, batch.dir);
+    }
+
+    threadsP = malloc(njobs * sizeof(pthread_t));
+    for (i = 0; threadsP != NULL && i < njobs; i++) {
+      if (pthread_create(&threadsP[i], NULL, batchWorker, &batch) != 0) {
+        break;
+      }
+      nstarted++;
+    }
+    if (nstarted == 0) {
+      /* no threads, convert here */
+      batchWorker(&batch);
+    }
+    for (i = 0; i < nstarted; i++) {
+      pthread_join(threadsP[i], NULL);
+    }
+    free(threadsP);
+  }
+
+  pthread_mutex_destroy(&batch.lock);
+
+  return(batch.failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+/******************/
+/* contactThumb() */
+/******************/
+/* thumbnail of one image, with its flips and rotations */
+/*  NULL if it cannot be loaded */
+static gImage*
+contactThumb(
+ struct contact_struct *inContactP,
+ OptionSet *optset)
+{
+gImage *thumbP = NULL;
+
+  thumbP = loadThumbnail(inContactP->global_options, optset,
+    getOption(optset, NAME)->info.name, inContactP->cell,
+    inContactP->verbose);
+  if (thumbP != NULL) {
+    thumbP = processImage(thumbP, inContactP->global_options, optset);
+  }
+  return(thumbP);
+}
+
+
+/*******************/
+/* contactWorker() */
+/*******************/
+/* thread: decode thumbnails until none are left */
+static void*
+contactWorker(
+ void *inArgP)
+{
+struct contact_struct *contactP = inArgP;
+gImage *thumbP = NULL;
+unsigned int i;
+
+  profileThreadName("contact worker");
+  for (;;) {
+    pthread_mutex_lock(&contactP->lock);
+    i = contactP->next;
+    if (i < contactP->n) {
+      contactP->next++;
+    }
+    pthread_mutex_unlock(&contactP->lock);
+
+    if (i >= contactP->n) {
+      break;
+    }
+    thumbP = contactThumb(contactP, contactP->sets[i]);
+
+    pthread_mutex_lock(&contactP->lock);
+    contactP->thumbs[i] = thumbP;
+    contactP->state[i] = CONTACT_DECODED;
+    pthread_mutex_unlock(&contactP->lock);
+  }
+  return(NULL);
+}
+
+
+/******************/
+/* contactPaste() */
+/******************/
+/* put a thumbnail on the sheet, centered in cell inI */
+/*  bitmaps are black on white, 16 bit samples are shortened */
+static void
+contactPaste(
+ struct contact_struct *inContactP,
+ unsigned int inI,
+ gImage *inThumbP)
+{
+unsigned char *scratchP = NULL;
+unsigned char *rowP = NULL;
+unsigned char *outP = NULL;
+uint16_t *u16P = NULL;
+unsigned int pitch;
+unsigned int w;
+unsigned int h;
+unsigned int x0;
+unsigned int y0;
+unsigned int x;
+unsigned int y;
+
+  pitch = inContactP->cell + CONTACT_GAP;
+  w = (inThumbP->width < inContactP->cell ? inThumbP->width : inContactP->cell);
+  h = (inThumbP->height < inContactP->cell ? inThumbP->height : inContactP->cell);
+  x0 = (inI % inContactP->cols) * pitch + CONTACT_GAP / 2 +
+       (inContactP->cell - w) / 2;
+  y0 = (inI / inContactP->cols) * pitch + CONTACT_GAP / 2 +
+       (inContactP->cell - h) / 2;
+
+  scratchP = malloc(imageRowBytes(inThumbP->gitype, w));
+  outP = malloc(imageRowBytes(IRGB24, w));
+  for (y = 0; scratchP != NULL && outP != NULL && y < h; y++) {
+    rowP = imageRowP(inThumbP, 0, y, w, scratchP);
+    if (rowP == NULL) {
+      break;
+    }
+    if (BITMAPP(inThumbP)) {
+      for (x = 0; x < w; x++) {
+        outP[x * 3] = (rowP[x / 8] & (0x01 << (x % 8)) ? 0 : 255);
+        outP[x * 3 + 1] = outP[x * 3];
+        outP[x * 3 + 2] = outP[x * 3];
+      }
+    } else if (RGB48P(inThumbP)) {
+      u16P = (uint16_t *)rowP;
+      for (x = 0; x < w * 3; x++) {
+        outP[x] = u16P[x] / 256;
+      }
+    } else if (RGB24P(inThumbP)) {
+      memcpy(outP, rowP, imageRowBytes(IRGB24, w));
+    } else {
+      break;
+    }
+    imagePutPixels(inContactP->sheetP, x0, y0 + y, w, outP);
+  }
+  free(scratchP);
+  free(outP);
+}
+
+
+/********************/
+/* contactChanged() */
+/********************/
+/* gdsetsheet() callback, in the main thread */
+/*  puts finished thumbnails on the sheet */
+static int
+contactChanged(
+ void *inCtxP)
+{
+struct contact_struct *contactP = inCtxP;
+gImage *thumbP = NULL;
+unsigned int i;
+int changed = 0;
+
+  pthread_mutex_lock(&contactP->lock);
+  for (i = 0; i < contactP->n; i++) {
+    if (contactP->state[i] != CONTACT_DECODED) {
+      continue;
+    }
+    thumbP = contactP->thumbs[i];
+    contactP->thumbs[i] = NULL;
+    contactP->state[i] = CONTACT_SHOWN;
+    contactP->nshown++;
+    pthread_mutex_unlock(&contactP->lock);
+
+    if (thumbP != NULL) {
+      contactPaste(contactP, i, thumbP);
+      freeImage(thumbP);
+      changed = 1;
+    }
+
+    pthread_mutex_lock(&contactP->lock);
+  }
+  if (contactP->nshown == contactP->n) {
+    changed = -1;
+  }
+  pthread_mutex_unlock(&contactP->lock);
+
+  return(changed);
+}
+
+
+/******************/
+/* contactSheet() */
+/******************/
+/* -contact: thumbnails of every image in one grid, as wide as the */
+/*  screen, decoded at reduced size by worker threads and shown as */
+/*  they arrive.  a click on a thumbnail returns its option set, */
+/*  to be shown from there as usual.  NULL to quit. */
+static OptionSet*
+contactSheet(
+ gdisplay ingdP,
+ OptionSet *global_options,
+ OptionSet *image_options,
+ unsigned int inCell,
+ int argc,
+ char *argv[],
+ unsigned int verbose)
+{
+struct contact_struct contact;
+OptionSet *optset = NULL;
+OptionSet *rsetP = NULL;
+pthread_t *threadsP = NULL;
+unsigned char *grayP = NULL;
+size_t memlimit;
+unsigned int pitch;
+unsigned int rows;
+unsigned int njobs;
+unsigned int nstarted = 0;
+unsigned int x;
+unsigned int y;
+unsigned int i;
+char r = '\0';
+
+  memset(&contact, 0, sizeof(contact));
+  contact.global_options = global_options;
+  contact.cell = inCell;
+  contact.verbose = verbose;
+  pthread_mutex_init(&contact.lock, NULL);
+
+  for (optset = image_options; optset != NULL; optset = optset->next) {
+    if (getOption(optset, NAME) != NULL) {
+      contact.n++;
+    }
+  }
+  contact.sets = calloc(contact.n, sizeof(OptionSet *));
+  contact.thumbs = calloc(contact.n, sizeof(gImage *));
+  contact.state = calloc(contact.n, 1);
+  if (contact.n == 0 || contact.sets == NULL || contact.thumbs == NULL ||
+      contact.state == NULL) {
+    fprintf(stderr, "contact sheet: malloc error\n");
+    contact.n = 0;
+  }
+  i = 0;
+  for (optset = image_options; contact.n != 0 && optset != NULL;
+       optset = optset->next) {
+    if (getOption(optset, NAME) != NULL) {
+      contact.sets[i++] = optset;
+    }
+  }
+
+  /* as many columns as fit on the screen */
+  pitch = inCell + CONTACT_GAP;
+  contact.cols = gdwidth(ingdP) / pitch;
+  if (contact.cols == 0) {
+    contact.cols = 1;
+  }
+  if (contact.cols > contact.n) {
+    contact.cols = contact.n;
+  }
+  if (contact.n != 0) {
+    rows = (contact.n - 1) / contact.cols + 1;
+    contact.sheetP = newLargeImage(IRGB24, contact.cols * pitch, rows * pitch);
+    grayP = malloc(imageRowBytes(IRGB24, contact.cols * pitch));
+  }
+  if (contact.sheetP != NULL && grayP != NULL) {
+    contact.sheetP->gamma = 2.2;
+    strcpy(contact.sheetP->title, "contact sheet");
+    memset(grayP, CONTACT_GRAY, imageRowBytes(IRGB24, contact.cols * pitch));
+    for (y = 0; y < contact.sheetP->height; y++) {
+      imagePutRow(contact.sheetP, y, grayP);
+    }
+  }
+  free(grayP);
+
+  if (contact.sheetP != NULL) {
+    /* each worker may decode a full size image, see batchConvert() */
+    njobs = workerCount(contact.n);
+    memlimit = imageMemoryLimit();
+    setImageMemoryLimit(memlimit / njobs);
+    if (verbose) {
+      printf("contact sheet of %u images, %u at a time\n", contact.n, njobs);
+    }
+    threadsP = malloc(njobs * sizeof(pthread_t));
+    for (i = 0; threadsP != NULL && i < njobs; i++) {
+      if (pthread_create(&threadsP[i], NULL, contactWorker, &contact) != 0) {
+        break;
+      }
+      nstarted++;
+    }
+    if (nstarted == 0) {
+      /* no threads, decode everything before showing it */
+      contactWorker(&contact);
+    }
+
+    gdsetsheet(ingdP, contactChanged, &contact);
+    gdsetgamma(ingdP, 1.0);
+    do {
+      r = gdImageInWindow(ingdP, contact.sheetP, global_options,
+            image_options, argc, argv, verbose);
+      if (r == 'c') {
+        gdclick(ingdP, &x, &y);
+        i = (y / pitch) * contact.cols + x / pitch;
+        if (x / pitch < contact.cols && i < contact.n) {
+          rsetP = contact.sets[i];
+        }
+      }
+    } while (r != 'q' && r != '\003' && r != '\0' && rsetP == NULL);
+    gdsetsheet(ingdP, NULL, NULL);
+
+    /* stop the workers after the images they have started */
+    pthread_mutex_lock(&contact.lock);
+    contact.next = contact.n;
+    pthread_mutex_unlock(&contact.lock);
+    for (i = 0; i < nstarted; i++) {
+      pthread_join(threadsP[i], NULL);
+    }
+    free(threadsP);
+    setImageMemoryLimit(memlimit);
+
+    for (i = 0; i < contact.n; i++) {
+      if (contact.thumbs[i] != NULL) {
+        freeImage(contact.thumbs[i]);
+      }
+    }
+    freeImage(contact.sheetP);
+  }
+
+  free(contact.sets);
+  free(contact.thumbs);
+  free(contact.state);
+  pthread_mutex_destroy(&contact.lock);
+
+  return(rsetP);
+}
+
+
 /**********/
 /* main() */
 /**********/
@@ -162,10 +1083,12 @@ main(
 gImage       *dispgimageP = NULL;
 gImage       *newgimageP = NULL;
 gImage       *tmpgimageP = NULL;
+pyramid       pyrP = NULL;
 OptionSet    *global_options = NULL;
 OptionSet    *image_options = NULL;
 OptionSet    *optset = NULL;
 OptionSet    *tmpset = NULL;
+OptionSet    *startset = NULL;
 Option       *opt = NULL;
 gdisplay      gdP;
 /* standard types */
@@ -179,6 +1102,12 @@ unsigned int  winheight = 0;
 /* unsigned int  fullscreen;*/  /* flag(bool) for fullscreen */
 unsigned int  shrinktofit; /* flag(bool) for fit in screen */
 unsigned int  verbose;     /* flag(bool) for verbose reporting */
+struct reload_struct reload;
+struct plan_struct plan;
+double        zoomx = 100.0; /* display size, percent of processed image */
+double        zoomy = 100.0;
+int           dispowned = 0; /* -1 (true) if dispgimageP is not in pyrP */
+int           tmpowned = 0;
 int i;
 
   /* set up internal error handlers */
@@ -210,6 +1139,29 @@ int i;
     /* NOTREACHED */
   }
 
+  opt = getOption(global_options, MEMLIMIT);
+  if (opt != NULL) {
+    setImageMemoryLimit((size_t)opt->info.memlimit * 1024 * 1024);
+  }
+  opt = getOption(global_options, CACHELIMIT);
+  if (opt != NULL) {
+    setCacheLimit((size_t)opt->info.cachelimit * 1024 * 1024);
+  }
+  opt = getOption(global_options, PROFILE);
+  if (opt != NULL && profileOpen(opt->info.profile) != 0) {
+    exit(EXIT_FAILURE);
+  }
+  opt = getOption(global_options, TRACE);
+  if (opt != NULL && traceOpen(opt->info.trace) != 0) {
+    exit(EXIT_FAILURE);
+  }
+  profileThreadName("main");
+
+  /* write images instead of displaying them */
+  if (getOption(global_options, OUTPUT) != NULL) {
+    exit(batchConvert(global_options, image_options, verbose));
+  }
+
   opt = getOption(global_options, DISPLAY);
   dname = (opt != NULL ? opt->info.display : NULL);
   gdP = gdinit(dname);
@@ -249,8 +1201,20 @@ int i;
     winheight = 0;
   }
 
+  /* a contact sheet first, showing from the image clicked on */
+  startset = image_options;
+  opt = getOption(global_options, CONTACT);
+  if (opt != NULL) {
+    startset = contactSheet(gdP, global_options, image_options,
+      opt->info.contact, argc, argv, verbose);
+    if (startset == NULL) {
+      gdfinish(gdP);
+      exit(EXIT_SUCCESS);
+    }
+  }
+
   /* load in each named image */
-  for (optset = image_options; optset != NULL; optset = optset->next) {
+  for (optset = startset; optset != NULL; optset = optset->next) {
 
 get_another_image:
 
@@ -297,10 +1261,31 @@ get_another_image:
 
     newgimageP = processImage(newgimageP, global_options, optset);
 
-    dispgimageP = newgimageP;
+    /* reductions for zoom out are built in the background */
+    reload.global_options = global_options;
+    reload.optset = optset;
+    reload.name = getOption(optset, NAME)->info.name;
+    reload.verbose = verbose;
+    pyrP = pyrNew(newgimageP, reloadSource, &reload);
+    if (pyrP == NULL) {
+      freeImage(newgimageP);
+      continue;
+    }
+
+    makePlan(global_options, optset, &plan);
+    zoomx = plan.zoomx;
+    zoomy = plan.zoomy;
+    dispgimageP = viewImage(pyrP, zoomx, zoomy, &dispowned, verbose);
+    if (dispgimageP == NULL) {
+      releaseImage(&pyrP, &dispgimageP, &dispowned);
+      continue;
+    }
 
 redisplay_in_window:
 
+    evictSource(pyrP, dispgimageP, verbose);
+
+    gdsetgamma(gdP, plan.gamma);
     gdret = gdImageInWindow(gdP, dispgimageP, global_options,
            optset, argc, argv, verbose);
 
@@ -332,8 +1317,7 @@ redisplay_in_window:
           if ((opt = getOption(tmpset, NAME)) &&
               !strcmp(tag, opt->info.name)) {
             optset = tmpset;
-            freeImage(dispgimageP);
-            dispgimageP = NULL;
+            releaseImage(&pyrP, &dispgimageP, &dispowned);
             goto get_another_image; /* goto ick */
           }
         }
@@ -355,6 +1339,7 @@ redisplay_in_window:
         goto redisplay_in_window; /* goto ick */
       }
       optset = tmpset;
+      releaseImage(&pyrP, &dispgimageP, &dispowned);
 
       goto get_another_image; /* goto ick */
       /* does not fall through, because 'goto' */
@@ -362,22 +1347,29 @@ redisplay_in_window:
      case '<':
       /* < for smaller */
 
-      opt = getOption(optset, ZOOM);
-      if (opt == NULL) {
-        opt = newOption(ZOOM);
-        opt->info.zoom.x = opt->info.zoom.y = 50.0;
-        addOption(optset, opt);
-      } else {
-        opt->info.zoom.x = opt->info.zoom.x ? opt->info.zoom.x * 0.5 : 50;
-        opt->info.zoom.y = opt->info.zoom.y ? opt->info.zoom.y * 0.5 : 50;
-      }
-
-      tmpgimageP = dispgimageP;
-      dispgimageP = zoom(dispgimageP, 50, 50, verbose);
-      if (tmpgimageP != dispgimageP) {
-        freeImage(tmpgimageP);
-        tmpgimageP = NULL;
+      /* half size, from the full size image or a pyramid level */
+      tmpgimageP = viewImage(pyrP, zoomx * 0.5, zoomy * 0.5, &tmpowned, verbose);
+      if (tmpgimageP != NULL) {
+        if (dispowned) {
+          freeImage(dispgimageP);
+        }
+        dispgimageP = tmpgimageP;
+        dispowned = tmpowned;
+        zoomx *= 0.5;
+        zoomy *= 0.5;
+
+        /* remembered if this image is shown again */
+        opt = getOption(optset, ZOOM);
+        if (opt == NULL) {
+          opt = newOption(ZOOM);
+          opt->info.zoom.x = opt->info.zoom.y = 50.0;
+          addOption(optset, opt);
+        } else {
+          opt->info.zoom.x = opt->info.zoom.x ? opt->info.zoom.x * 0.5 : 50;
+          opt->info.zoom.y = opt->info.zoom.y ? opt->info.zoom.y * 0.5 : 50;
+        }
       }
+      tmpgimageP = NULL;
 
       goto redisplay_in_window; /* goto ick */
       /* does not fall through, because 'goto' */
@@ -385,22 +1377,29 @@ redisplay_in_window:
      case '>':
       /* > for bigger */
 
-      opt = getOption(optset, ZOOM);
-      if (opt == NULL) {
-        opt = newOption(ZOOM);
-        opt->info.zoom.x = opt->info.zoom.y = 200.0;
-        addOption(optset, opt);
-      } else {
-        opt->info.zoom.x = opt->info.zoom.x ? opt->info.zoom.x * 2.0 : 200;
-        opt->info.zoom.y = opt->info.zoom.y ? opt->info.zoom.y * 2.0 : 200;
-      }
-
-      tmpgimageP = dispgimageP;
-      dispgimageP = zoom(dispgimageP, 200, 200, verbose);
-      if (tmpgimageP != dispgimageP) {
-        freeImage(tmpgimageP);
-        tmpgimageP = NULL;
+      /* double size, from the full size image or a pyramid level */
+      tmpgimageP = viewImage(pyrP, zoomx * 2.0, zoomy * 2.0, &tmpowned, verbose);
+      if (tmpgimageP != NULL) {
+        if (dispowned) {
+          freeImage(dispgimageP);
+        }
+        dispgimageP = tmpgimageP;
+        dispowned = tmpowned;
+        zoomx *= 2.0;
+        zoomy *= 2.0;
+
+        /* remembered if this image is shown again */
+        opt = getOption(optset, ZOOM);
+        if (opt == NULL) {
+          opt = newOption(ZOOM);
+          opt->info.zoom.x = opt->info.zoom.y = 200.0;
+          addOption(optset, opt);
+        } else {
+          opt->info.zoom.x = opt->info.zoom.x ? opt->info.zoom.x * 2.0 : 200;
+          opt->info.zoom.y = opt->info.zoom.y ? opt->info.zoom.y * 2.0 : 200;
+        }
       }
+      tmpgimageP = NULL;
       goto redisplay_in_window; /* goto ick */
       /* does not fall through, because 'goto' */
 
@@ -409,10 +1408,7 @@ redisplay_in_window:
 
     } /* end switch on return from gdImageInWindow() */
 
-/*
-    freeImage(dispgimageP);
-    dispgimageP = NULL;
-*/
+    releaseImage(&pyrP, &dispgimageP, &dispowned);
 /* need to understand relationship newgimageP, dispgimageP, tempgimageP */
 
   } /* end of for loop of options */